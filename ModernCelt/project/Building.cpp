@@ -7,6 +7,9 @@
 #include <iostream>
 #include <glm/gtc/type_ptr.hpp>
 #include <render/shader.h>
+#include "render/GLState.h"
+#include "render/GpuProfiler.h"
+#include "render/TextureLoader.h"
 
 // Vertex data for a cube structure
 const GLfloat Building::vertex_buffer_data[72] = {
@@ -149,57 +152,30 @@ const GLfloat Building::normal_buffer_data[72] = {
 };
 
 // Constructor initializes member variables
-Building::Building() : vertexArrayID(0), vertexBufferID(0), indexBufferID(0), colorBufferID(0),
-                       uvBufferID(0), textureID(0), mvpMatrixID(0), textureSamplerID(0), programID(0) {}
+Building::Building() : textureID(0), mvpMatrixID(0), textureSamplerID(0), programID(0), depthProgramID(0) {}
 
 // Destructor cleans up resources
 Building::~Building() {
     cleanup();
 }
 
+// Interleave the static cube arrays into a single vertex buffer
+void Building::createMesh(float vTiling) {
+    BoxVertex vertices[24];
+    for (int i = 0; i < 24; ++i) {
+        vertices[i].position = glm::vec3(vertex_buffer_data[3 * i], vertex_buffer_data[3 * i + 1], vertex_buffer_data[3 * i + 2]);
+        vertices[i].color = glm::vec3(1.0f); // White default
+        vertices[i].uv = glm::vec2(uv_buffer_data[2 * i], uv_buffer_data[2 * i + 1] * vTiling);
+        vertices[i].normal = glm::vec3(normal_buffer_data[3 * i], normal_buffer_data[3 * i + 1], normal_buffer_data[3 * i + 2]);
+    }
+    mesh.initialize(vertices, 24, index_buffer_data, 36);
+}
+
 // Initialize building resources
-void Building::initialize(glm::vec3 position, glm::vec3 scale, GLuint textureID) {
-    this->position = position;
-    this->scale = scale;
+void Building::initialize(GLuint textureID) {
     this->textureID = textureID;
 
-    // Create and bind vertex array
-    glGenVertexArrays(1, &vertexArrayID);
-    glBindVertexArray(vertexArrayID);
-
-    // Create and populate vertex buffer
-    glGenBuffers(1, &vertexBufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_buffer_data), vertex_buffer_data, GL_STATIC_DRAW);
-
-    // Create and populate color buffer (white default)
-    GLfloat temp_color_buffer[72];
-    for (int i = 0; i < 72; i++) temp_color_buffer[i] = 1.0f;
-    glGenBuffers(1, &colorBufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(temp_color_buffer), temp_color_buffer, GL_STATIC_DRAW);
-
-    // Create and modify UV buffer for tiling
-    GLfloat temp_uv_buffer[48];
-    memcpy(temp_uv_buffer, uv_buffer_data, sizeof(uv_buffer_data));
-    for (int i = 0; i < 24; ++i) temp_uv_buffer[2 * i + 1] *= 5.0f; // Vertical tiling
-    glGenBuffers(1, &uvBufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(temp_uv_buffer), temp_uv_buffer, GL_STATIC_DRAW);
-
-    // Create and populate index buffer
-    glGenBuffers(1, &indexBufferID);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index_buffer_data), index_buffer_data, GL_STATIC_DRAW);
-
-    // Create and populate normal buffer
-    glGenBuffers(1, &normalBufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, normalBufferID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(normal_buffer_data), normal_buffer_data, GL_STATIC_DRAW);
-
-    // Enable normal attribute
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    createMesh(5.0f); // Vertical tiling
 
     // Load shaders
     programID = LoadShadersFromFile("../project/box.vert", "../project/box.frag");
@@ -215,115 +191,67 @@ void Building::initialize(glm::vec3 position, glm::vec3 scale, GLuint textureID)
     modelID = glGetUniformLocation(programID, "model");
     lightSpaceMatrixID = glGetUniformLocation(programID, "lightSpaceMatrix");
     shadowMapID = glGetUniformLocation(programID, "shadowMap");
-    depthModelID = glGetUniformLocation(programID, "model");
-    depthLightSpaceMatrixID = glGetUniformLocation(programID, "lightSpaceMatrix");
+
+    // Sampler units are program state, so they only need to be set once
+    glState().useProgram(programID);
+    glUniform1i(textureSamplerID, 0);
+    glUniform1i(shadowMapID, 1);
 }
 
 // Render the building
-void Building::render(const glm::mat4& cameraMatrix, const glm::vec3& lightPos, const glm::vec3& lightInt, const glm::mat4& lightSpaceMatrix) {
-    glUseProgram(programID);
-    glBindVertexArray(vertexArrayID);
-
-    // Set vertex attributes
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-    glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-    glEnableVertexAttribArray(3);
-    glBindBuffer(GL_ARRAY_BUFFER, normalBufferID);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+void Building::render(const glm::mat4& cameraMatrix, const glm::mat4& modelMatrix, const glm::vec3& lightPos, const glm::vec3& lightInt, const glm::mat4& lightSpaceMatrix) {
+    GPU_SCOPE("Building");
+    glState().useProgram(programID);
+    mesh.bind();
 
     // Set shader uniforms
     glUniformMatrix4fv(lightSpaceMatrixID, 1, GL_FALSE, glm::value_ptr(lightSpaceMatrix));
-    glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), position);
-    modelMatrix = glm::scale(modelMatrix, scale);
     glm::mat4 mvp = cameraMatrix * modelMatrix;
     glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
     glUniformMatrix4fv(modelID, 1, GL_FALSE, glm::value_ptr(modelMatrix));
     glUniform3fv(lightPositionID, 1, &lightPos[0]);
     glUniform3fv(lightIntensityID, 1, &lightInt[0]);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glUniform1i(textureSamplerID, 0);
-
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, shadowMapID);
-    glUniform1i(glGetUniformLocation(programID, "shadowMap"), 1);
+    // The shadow map stays bound on unit 1 for the whole main pass
+    glState().bindTexture(0, GL_TEXTURE_2D, textureID);
 
     // Draw elements
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0);
+}
 
-    // Cleanup
-    glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
-    glDisableVertexAttribArray(2);
-    glDisableVertexAttribArray(3);
-    glBindVertexArray(0);
+// The depth uniforms live in the depth program, not in box.vert
+void Building::setDepthProgram(GLuint program) {
+    depthProgramID = program;
+    depthModelID = glGetUniformLocation(program, "model");
+    depthLightSpaceMatrixID = glGetUniformLocation(program, "lightSpaceMatrix");
 }
 
 // Render the building depth map
-void Building::renderDepth(const glm::mat4& lightSpaceMatrix) {
-    glBindVertexArray(vertexArrayID);
-
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+void Building::renderDepth(const glm::mat4& lightSpaceMatrix, const glm::mat4& modelMatrix) {
+    GPU_SCOPE("Building");
+    glState().useProgram(depthProgramID);
+    mesh.bind();
 
-    glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), position);
-    modelMatrix = glm::scale(modelMatrix, scale);
     glUniformMatrix4fv(depthModelID, 1, GL_FALSE, glm::value_ptr(modelMatrix));
     glUniformMatrix4fv(depthLightSpaceMatrixID, 1, GL_FALSE, glm::value_ptr(lightSpaceMatrix));
 
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-    glDisableVertexAttribArray(0);
-    glBindVertexArray(0);
+    glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0);
 }
 
 // Cleanup resources
 void Building::cleanup() {
-    if (vertexArrayID) glDeleteVertexArrays(1, &vertexArrayID);
-    if (vertexBufferID) glDeleteBuffers(1, &vertexBufferID);
-    if (colorBufferID) glDeleteBuffers(1, &colorBufferID);
-    if (uvBufferID) glDeleteBuffers(1, &uvBufferID);
-    if (indexBufferID) glDeleteBuffers(1, &indexBufferID);
+    mesh.cleanup();
     if (programID) glDeleteProgram(programID);
-    if (normalBufferID) glDeleteBuffers(1, &normalBufferID);
+    programID = 0;
 }
 
-//Load textures onto buildings
-GLuint LoadTextureTileBox(const char *texture_file_path) {
-    int w, h, channels;
-    uint8_t *img = stbi_load(texture_file_path, &w, &h, &channels, 3);
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+void Building::requestTextureDetail(float screenPixels) const {
+    textureLoader().requestDetail(textureID, screenPixels);
+}
 
-    if (img) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, img);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
-        std::cerr << "Failed to load texture " << texture_file_path << std::endl;
-    }
-    stbi_image_free(img);
-    return texture;
+//Load textures onto buildings; decoded in the background, a placeholder until then
+GLuint LoadTextureTileBox(const char *texture_file_path) {
+    return textureLoader().load(texture_file_path);
 }
 
 
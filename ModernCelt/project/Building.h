@@ -3,20 +3,47 @@
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <cstdint>
 #include <vector>
+#include "render/VertexFormat.h"
+#include "scene/Bounds.h"
+
+// Interleaved vertex used by the textured boxes (buildings and pub)
+struct BoxVertex {
+    glm::vec3 position;
+    glm::vec3 color;
+    glm::vec2 uv;
+    glm::vec3 normal;
+};
+
+template <> struct VertexLayout<BoxVertex> {
+    static constexpr std::array<VertexAttribute, 4> attributes = {{
+        VERTEX_ATTRIBUTE(BoxVertex, position, 0),
+        VERTEX_ATTRIBUTE(BoxVertex, color, 1),
+        VERTEX_ATTRIBUTE(BoxVertex, uv, 2),
+        VERTEX_ATTRIBUTE(BoxVertex, normal, 3),
+    }};
+};
 
 class Building {
 public:
-    glm::vec3 position;      // Position of the building
-    glm::vec3 scale;         // Scale of the building
-
     Building();              // Constructor
     ~Building();             // Destructor
 
-    void initialize(glm::vec3 position, glm::vec3 scale, GLuint textureID);
-    void render(const glm::mat4& cameraMatrix, const glm::vec3& lightPos, const glm::vec3& lightInt, const glm::mat4& lightSpaceMatrix);
+    // Placement comes from the owning entity; modelMatrix maps the unit cube into the world
+    void initialize(GLuint textureID);
+    void render(const glm::mat4& cameraMatrix, const glm::mat4& modelMatrix, const glm::vec3& lightPos, const glm::vec3& lightInt, const glm::mat4& lightSpaceMatrix);
     void cleanup();
-    void renderDepth(const glm::mat4& lightSpaceMatrix);
+    void renderDepth(const glm::mat4& lightSpaceMatrix, const glm::mat4& modelMatrix);
+
+    // Program used by renderDepth(); shared by all shadow casters
+    void setDepthProgram(GLuint program);
+
+    // Tell the texture streamer how many pixels across this building appears
+    void requestTextureDetail(float screenPixels) const;
+
+    // Model-space bounds of the cube mesh
+    static AABB localBounds() { return AABB(glm::vec3(-1.0f), glm::vec3(1.0f)); }
 
     // Static data for the building's geometry
     static const GLfloat vertex_buffer_data[72];
@@ -25,13 +52,11 @@ public:
     static const GLfloat uv_buffer_data[48];
     static const GLfloat normal_buffer_data[72];
 
-    // OpenGL resource IDs
-    GLuint vertexArrayID;
-    GLuint vertexBufferID;
-    GLuint indexBufferID;
-    GLuint colorBufferID;
-    GLuint uvBufferID;
-    GLuint normalBufferID;
+    // Build the interleaved cube mesh (white colour, UVs tiled vertically by vTiling)
+    void createMesh(float vTiling);
+
+    // OpenGL resources
+    InterleavedMesh<BoxVertex> mesh;
     GLuint textureID;
     GLuint lightPositionID;
     GLuint lightIntensityID;
@@ -43,10 +68,10 @@ public:
     GLuint mvpMatrixID;
     GLuint textureSamplerID;
     GLuint programID;
+    GLuint depthProgramID;
     GLuint depthModelID;
     GLuint depthLightSpaceMatrixID;
 
-    glm::mat4 modelMatrix;
     glm::mat4 lightSpaceMatrix;
 };
 
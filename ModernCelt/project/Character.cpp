@@ -9,129 +9,94 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <tiny_gltf.h>
 #include <render/shader.h>
+#include "render/GLState.h"
+#include "render/GpuProfiler.h"
+#include "render/TextureLoader.h"
+#include "render/VertexQuantization.h"
+#include "render/MeshOptimizer.h"
+#include "core/CpuProfiler.h"
+#include "core/FrameArena.h"
+#include <algorithm>
 #include <vector>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <iomanip>
 
 
 
-GLuint MyBot::loadTexture(const tinygltf::Image& image) {
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
-    GLenum format = GL_RGBA;
-    if (image.component == 3) {
-        format = GL_RGB;
-    }
-
-
-
-
-    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, &image.image[0]);
-
-    // Set texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    return textureID;
+// The glTF images are still encoded (see loadModel); the loader decodes them on a
+// worker and shares them between every bot using the same file
+GLuint MyBot::loadTexture(const tinygltf::Image& image, const glm::u8vec4& placeholder, bool normalMap) {
+    TextureLoader::Params params;
+    params.channels = 4;
+    params.normalMap = normalMap;
+    params.placeholder = placeholder;
+    std::string key = assetPath + "/" + (image.uri.empty() ? image.name : image.uri);
+    return textureLoader().loadEncoded(key, image.image.data(), image.image.size(), params);
 }
 
-void MyBot::loadMaterialTextures(const tinygltf::Model& model, const tinygltf::Material& material) {
+MyBot::MaterialObject MyBot::loadMaterialTextures(const tinygltf::Model& model, const tinygltf::Material& material) {
+    MaterialObject materialObject;
+
     // Load diffuse/base color texture
     if (material.values.find("baseColorTexture") != material.values.end()) {
         int textureIndex = material.values.at("baseColorTexture").TextureIndex();
         const tinygltf::Texture& texture = model.textures[textureIndex];
-        const tinygltf::Image& image = model.images[texture.source];
-
-        TextureObject texObj;
-        texObj.id = loadTexture(image);
-        texObj.width = image.width;
-        texObj.height = image.height;
-        texObj.channels = image.component;
-        texObj.type = "diffuse";
-        textureObjects.push_back(texObj);
+        materialObject.diffuse = loadTexture(model.images[texture.source], glm::u8vec4(128, 128, 128, 255));
     }
 
     // Load normal texture
     if (material.normalTexture.index >= 0) {
         const tinygltf::Texture& texture = model.textures[material.normalTexture.index];
-        const tinygltf::Image& image = model.images[texture.source];
-
-        TextureObject texObj;
-        texObj.id = loadTexture(image);
-        texObj.width = image.width;
-        texObj.height = image.height;
-        texObj.channels = image.component;
-        texObj.type = "normal";
-        textureObjects.push_back(texObj);
+        materialObject.normal = loadTexture(model.images[texture.source], glm::u8vec4(128, 128, 255, 255), true);   // Flat normal
     }
 
     // Load ambient occlusion texture
     if (material.occlusionTexture.index >= 0) {
         const tinygltf::Texture& texture = model.textures[material.occlusionTexture.index];
-        const tinygltf::Image& image = model.images[texture.source];
-
-        TextureObject texObj;
-        texObj.id = loadTexture(image);
-        texObj.width = image.width;
-        texObj.height = image.height;
-        texObj.channels = image.component;
-        texObj.type = "ao";
-        textureObjects.push_back(texObj);
+        materialObject.ao = loadTexture(model.images[texture.source], glm::u8vec4(255, 255, 255, 255));   // Unoccluded
     }
+    return materialObject;
 }
 
-glm::mat4 MyBot::getNodeTransform(const tinygltf::Node& node) {
-    glm::mat4 transform(1.0f);
-    if (node.matrix.size() == 16) {
-        transform = glm::make_mat4(node.matrix.data());
-    } else {
+Skeleton MyBot::prepareSkeleton(const tinygltf::Model& model, std::vector<int>& nodeToSkeleton) {
+    Skeleton skeleton;
+    nodeToSkeleton.assign(model.nodes.size(), -1);
+    if (model.skins.empty() || model.skins[0].joints.empty()) return skeleton;
+
+    // Breadth-first from the skin's root, so every parent is added before its children
+    std::vector<int> order(1, model.skins[0].joints[0]);
+    std::vector<int> parents(1, -1);
+    for (size_t i = 0; i < order.size(); ++i) {
+        const tinygltf::Node& node = model.nodes[order[i]];
+        nodeToSkeleton[order[i]] = static_cast<int>(i);
+
+        glm::vec3 translation(0.0f);
+        glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+        glm::vec3 scale(1.0f);
         if (node.translation.size() == 3) {
-            transform = glm::translate(transform, glm::vec3(node.translation[0], node.translation[1], node.translation[2]));
+            translation = glm::vec3(node.translation[0], node.translation[1], node.translation[2]);
         }
         if (node.rotation.size() == 4) {
-            glm::quat q(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
-            transform *= glm::mat4_cast(q);
+            rotation = glm::quat(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
         }
         if (node.scale.size() == 3) {
-            transform = glm::scale(transform, glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
+            scale = glm::vec3(node.scale[0], node.scale[1], node.scale[2]);
         }
-    }
-    return transform;
-}
-
-void MyBot::computeLocalNodeTransform(const tinygltf::Model& model, int nodeIndex, std::vector<glm::mat4>& localTransforms) {
-    const tinygltf::Node& node = model.nodes[nodeIndex];
-
-    // Compute the local transformation using the provided helper function.
-    localTransforms[nodeIndex] = getNodeTransform(node);
-
-    // Recursively compute the local transform for each child node.
-    for (int childIndex : node.children) {
-        computeLocalNodeTransform(model, childIndex, localTransforms);
-    }
-}
+        skeleton.addJoint(parents[i], translation, rotation, scale);
 
-void MyBot::computeGlobalNodeTransform(const tinygltf::Model& model, const std::vector<glm::mat4>& localTransforms, int nodeIndex, const glm::mat4& parentTransform, std::vector<glm::mat4>& globalTransforms) {
-    // Combine the parent's transform with the node's local transform.
-    globalTransforms[nodeIndex] = parentTransform * localTransforms[nodeIndex];
-
-    const tinygltf::Node& node = model.nodes[nodeIndex];
-
-    // Recursively compute the global transforms for child nodes.
-    for (int childIndex : node.children) {
-        computeGlobalNodeTransform(model, localTransforms, childIndex, globalTransforms[nodeIndex], globalTransforms);
+        for (int child : node.children) {
+            order.push_back(child);
+            parents.push_back(static_cast<int>(i));
+        }
     }
+    return skeleton;
 }
 
-std::vector<MyBot::SkinObject> MyBot::prepareSkinning(const tinygltf::Model& model) {
+std::vector<MyBot::SkinObject> MyBot::prepareSkinning(const tinygltf::Model& model, const std::vector<int>& nodeToSkeleton) {
     std::vector<SkinObject> skinObjects;
     for (size_t i = 0; i < model.skins.size(); i++) {
         SkinObject skinObject;
@@ -156,55 +121,41 @@ std::vector<MyBot::SkinObject> MyBot::prepareSkinning(const tinygltf::Model& mod
 
         assert(skin.joints.size() == accessor.count);
 
-        skinObject.globalJointTransforms.resize(skin.joints.size());
-        skinObject.jointMatrices.resize(skin.joints.size());
-
-        // Prepare to compute node transforms
-        std::vector<glm::mat4> localTransforms(model.nodes.size(), glm::mat4(1.0f));
-        std::vector<glm::mat4> globalTransforms(model.nodes.size(), glm::mat4(1.0f));
-
-        // Compute transforms starting from the root node of the skeleton
-        int rootNodeIndex = skin.joints[0];
-        computeLocalNodeTransform(model, rootNodeIndex, localTransforms);
-        // Compute global transforms starting from root nodes
-        computeGlobalNodeTransform(model, localTransforms,rootNodeIndex, glm::mat4(1.0f), globalTransforms);
-        // Step 3: Compute joint matrices
-        for (size_t j = 0; j < skin.joints.size(); j++) {
-            int jointIndex = skin.joints[j];
-            skinObject.jointMatrices[j] = globalTransforms[jointIndex] * skinObject.inverseBindMatrices[j];
+        // Joints outside the skeleton (another skin's hierarchy) stay at the root
+        for (int joint : skin.joints) {
+            if (nodeToSkeleton[joint] < 0) {
+                std::cerr << "Skin " << i << " joint " << joint << " is not under the skeleton root" << std::endl;
+            }
+            skinObject.joints.push_back(std::max(0, nodeToSkeleton[joint]));
         }
 
+        // Rest pose palette until the first update()
+        ArenaScope scope;
+        LocalPose pose = allocatePose(threadArena(), skeleton.jointCount());
+        skeleton.copyRestPose(pose);
+        glm::mat4* localTransforms = threadArena().allocateArray<glm::mat4>(skeleton.jointCount());
+        glm::mat4* modelTransforms = threadArena().allocateArray<glm::mat4>(skeleton.jointCount());
+        localMatrices(pose, localTransforms);
+        modelMatrices(skeleton, localTransforms, modelTransforms);
+        skinObject.jointMatrices.resize(skin.joints.size());
+        skinningPalette(modelTransforms, skinObject.joints.data(), skinObject.inverseBindMatrices.data(),
+                        static_cast<int>(skin.joints.size()), skinObject.jointMatrices.data());
+
         skinObjects.push_back(skinObject);
     }
     return skinObjects;
 }
 
-int MyBot::findKeyframeIndex(const std::vector<float>& times, float animationTime) {
-    int left = 0;
-    int right = times.size() - 1;
-
-    while (left <= right) {
-        int mid = (left + right) / 2;
-
-        if (mid + 1 < times.size() && times[mid] <= animationTime && animationTime < times[mid + 1]) {
-            return mid;
-        }
-        else if (times[mid] > animationTime) {
-            right = mid - 1;
-        }
-        else { // animationTime >= times[mid + 1]
-            left = mid + 1;
-        }
-    }
-
-    // Target not found
-    return times.size() - 2;
-}
+std::vector<AnimationClip> MyBot::prepareAnimation(const tinygltf::Model& model, const std::vector<int>& nodeToSkeleton) {
+    // Keyframes as read from the file, one per glTF sampler
+    struct SamplerObject {
+        std::vector<float> input;
+        std::vector<glm::vec4> output;
+    };
 
-std::vector<MyBot::AnimationObject> MyBot::prepareAnimation(const tinygltf::Model& model) {
-    std::vector<AnimationObject> animationObjects;
+    std::vector<AnimationClip> clips;
 		for (const auto &anim : model.animations) {
-			AnimationObject animationObject;
+			std::vector<SamplerObject> samplers;
 
 			for (const auto &sampler : anim.samplers) {
 				SamplerObject samplerObject;
@@ -254,160 +205,312 @@ std::vector<MyBot::AnimationObject> MyBot::prepareAnimation(const tinygltf::Mode
 
 				}
 
-				animationObject.samplers.push_back(samplerObject);
+				samplers.push_back(samplerObject);
 			}
 
-			animationObjects.push_back(animationObject);
+			// One track per channel, its target resolved once; channels on nodes outside
+			// the skeleton cannot move a joint
+			AnimationClip clip;
+			for (const auto &channel : anim.channels) {
+				RawTrack track;
+				track.joint = channel.target_node >= 0 ? nodeToSkeleton[channel.target_node] : -1;
+				if (channel.target_path == "translation") track.kind = TrackKind::Translation;
+				else if (channel.target_path == "rotation") track.kind = TrackKind::Rotation;
+				else if (channel.target_path == "scale") track.kind = TrackKind::Scale;
+				else continue;
+				if (track.joint < 0) continue;
+				track.times = samplers[channel.sampler].input;
+				track.values = samplers[channel.sampler].output;
+				clip.addTrack(std::move(track));
+			}
+
+			clips.push_back(std::move(clip));
 		}
-    return animationObjects;
+    return clips;
 }
 
-void MyBot::updateAnimation(const tinygltf::Model& model, const tinygltf::Animation& anim, const AnimationObject& animationObject, float time, std::vector<glm::mat4>& nodeTransforms) {
-    // For each node, store separate components
-    struct TransformComponents {
-        glm::vec3 translation = glm::vec3(0.0f);
-        glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
-        glm::vec3 scale = glm::vec3(1.0f);
-    };
+namespace {
 
-    std::vector<TransformComponents> nodeComponents(model.nodes.size());
+// value with a fixed number of decimals, for the load reports
+std::string fixed(double value, int decimals) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(decimals) << value;
+    return out.str();
+}
 
-    // Initialize with initial node transforms
-    for (size_t i = 0; i < model.nodes.size(); ++i) {
-        const tinygltf::Node &node = model.nodes[i];
+std::string readText(const char* path) {
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
 
-        if (node.translation.size() == 3) {
-            nodeComponents[i].translation = glm::vec3(
-                node.translation[0], node.translation[1], node.translation[2]);
-        }
-        if (node.rotation.size() == 4) {
-            nodeComponents[i].rotation = glm::quat(
-                node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
-        }
-        if (node.scale.size() == 3) {
-            nodeComponents[i].scale = glm::vec3(
-                node.scale[0], node.scale[1], node.scale[2]);
-        }
+// A bot program; with floatVertices its vertex shader reads FloatSkinnedVertex,
+// through FLOAT_VERTICES defined right after the #version line
+GLuint loadBotShaders(const char* vertexPath, const char* fragmentPath, bool floatVertices) {
+    if (!floatVertices) return LoadShadersFromFile(vertexPath, fragmentPath);
+    std::string vertexCode = readText(vertexPath);
+    std::string fragmentCode = readText(fragmentPath);
+    size_t version = vertexCode.find('\n');
+    if (version == std::string::npos || fragmentCode.empty()) {
+        std::cerr << "Failed to read " << vertexPath << " or " << fragmentPath << std::endl;
+        return 0;
     }
+    vertexCode.insert(version + 1, "#define FLOAT_VERTICES\n");
+    return LoadShadersFromString(vertexCode, fragmentCode);
+}
 
-    // Apply animation data
-    for (const auto &channel : anim.channels) {
-        int targetNodeIndex = channel.target_node;
-        const auto &sampler = anim.samplers[channel.sampler];
+// Joint name without a namespace prefix such as "mixamorig:"
+std::string baseName(const std::string& name) {
+    size_t colon = name.rfind(':');
+    return colon == std::string::npos ? name : name.substr(colon + 1);
+}
 
-        // Calculate current animation time (wrap if necessary)
-        const std::vector<float> &times = animationObject.samplers[channel.sampler].input;
-        float animationTime = fmod(time, times.back());
+// Skeleton-space rotation of every joint; parents precede children
+void globalRotations(const Skeleton& skeleton, const LocalPose& pose, std::vector<glm::quat>& global) {
+    global.resize(skeleton.jointCount());
+    for (int i = 0; i < skeleton.jointCount(); ++i) {
+        int parent = skeleton.parents[i];
+        global[i] = parent < 0 ? pose.rotation(i) : global[parent] * pose.rotation(i);
+    }
+}
 
-        // Find keyframes
-        int keyframeIndex = findKeyframeIndex(times, animationTime);
-        int nextKeyframeIndex = (keyframeIndex + 1) % times.size();
+} // namespace
 
-        // Calculate interpolation factor
-        float t0 = times[keyframeIndex];
-        float t1 = times[nextKeyframeIndex];
-        float factor = (animationTime - t0) / (t1 - t0);
+std::vector<AnimationClip> MyBot::importClips(const char* path, const std::vector<std::string>& jointNames) {
+    std::vector<AnimationClip> imported;
+    tinygltf::Model source;
+    if (!loadModel(source, path)) {
+        return imported;
+    }
+    std::vector<int> sourceNodeToSkeleton;
+    Skeleton sourceSkeleton = prepareSkeleton(source, sourceNodeToSkeleton);
+    std::vector<AnimationClip> sourceClips = prepareAnimation(source, sourceNodeToSkeleton);
 
-        // Get output data
-        const std::vector<glm::vec4> &outputs = animationObject.samplers[channel.sampler].output;
+    std::map<std::string, int> sourceJoints;
+    for (size_t node = 0; node < source.nodes.size(); ++node) {
+        if (sourceNodeToSkeleton[node] >= 0) sourceJoints[baseName(source.nodes[node].name)] = sourceNodeToSkeleton[node];
+    }
+    std::vector<int> match(skeleton.jointCount(), -1);
+    int matched = 0;
+    for (int joint = 0; joint < skeleton.jointCount(); ++joint) {
+        auto found = sourceJoints.find(baseName(jointNames[joint]));
+        if (found == sourceJoints.end()) continue;
+        match[joint] = found->second;
+        ++matched;
+    }
+    if (skeleton.jointCount() == 0 || match[0] < 0) {
+        std::cerr << "Cannot retarget " << path << ": its skeleton root has no counterpart" << std::endl;
+        return imported;
+    }
 
-        if (channel.target_path == "translation") {
-            glm::vec3 translation0 = glm::vec3(outputs[keyframeIndex]);
-            glm::vec3 translation1 = glm::vec3(outputs[nextKeyframeIndex]);
+    LocalPose targetRest = skeleton.restPose();
+    LocalPose sourceRestPose = sourceSkeleton.restPose();
+    std::vector<glm::quat> sourceRest, targetRestGlobal, sourceGlobal, targetGlobal(skeleton.jointCount());
+    globalRotations(sourceSkeleton, sourceRestPose, sourceRest);
+    globalRotations(skeleton, targetRest, targetRestGlobal);
+
+    int sourceRoot = match[0];
+    ArenaScope scope;
+    LocalPose sourcePose = allocatePose(threadArena(), sourceSkeleton.jointCount());
+    const float sampleRate = 30.0f;
+    for (const AnimationClip& sourceClip : sourceClips) {
+        // Resampled at a fixed rate; compression drops the keys that add nothing
+        int samples = std::max(2, static_cast<int>(std::ceil(sourceClip.duration() * sampleRate)) + 1);
+        std::vector<RawTrack> rotations;
+        std::vector<int> trackOf(skeleton.jointCount(), -1);
+        for (int joint = 0; joint < skeleton.jointCount(); ++joint) {
+            if (match[joint] < 0) continue;
+            trackOf[joint] = static_cast<int>(rotations.size());
+            rotations.push_back(RawTrack{ joint, TrackKind::Rotation, {}, {} });
+        }
+        RawTrack rootTranslation{ 0, TrackKind::Translation, {}, {} };
+
+        for (int sample = 0; sample < samples; ++sample) {
+            // Sampling wraps at the duration, so the last sample sits just before it
+            float time = sourceClip.duration() * sample / (samples - 1);
+            if (sample == samples - 1) time = std::nextafter(time, 0.0f);
+            sourceSkeleton.copyRestPose(sourcePose);
+            sourceClip.sample(time, sourcePose);
+            globalRotations(sourceSkeleton, sourcePose, sourceGlobal);
+
+            // Turning about the vertical is left out; so is travel, bar bobbing
+            glm::quat rootDelta = sourceGlobal[sourceRoot] * glm::inverse(sourceRest[sourceRoot]);
+            glm::quat heading(rootDelta.w, 0.0f, rootDelta.y, 0.0f);
+            float headingLength = glm::length(heading);
+            heading = headingLength > 1e-6f ? heading / headingLength : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+            glm::quat unturn = glm::inverse(heading);
+
+            for (int joint = 0; joint < skeleton.jointCount(); ++joint) {
+                int parent = skeleton.parents[joint];
+                glm::quat parentGlobal = parent < 0 ? glm::quat(1.0f, 0.0f, 0.0f, 0.0f) : targetGlobal[parent];
+                int from = match[joint];
+                if (from < 0) {
+                    targetGlobal[joint] = parentGlobal * targetRest.rotation(joint);
+                    continue;
+                }
+                targetGlobal[joint] = glm::normalize(unturn * sourceGlobal[from] * glm::inverse(sourceRest[from]) * targetRestGlobal[joint]);
+                glm::quat local = glm::inverse(parentGlobal) * targetGlobal[joint];
+                RawTrack& track = rotations[trackOf[joint]];
+                track.times.push_back(time);
+                track.values.push_back(glm::vec4(local.x, local.y, local.z, local.w));
+            }
 
-            // Linearly interpolate
-            glm::vec3 translation = glm::mix(translation0, translation1, factor);
-            nodeComponents[targetNodeIndex].translation = translation;
+            rootTranslation.times.push_back(time);
+            rootTranslation.values.push_back(glm::vec4(0.0f, sourcePose.translation(sourceRoot).y, 0.0f, 0.0f));
+        }
 
-        } else if (channel.target_path == "rotation") {
-            glm::quat rotation0(outputs[keyframeIndex].w, outputs[keyframeIndex].x,
-                                outputs[keyframeIndex].y, outputs[keyframeIndex].z);
-            glm::quat rotation1(outputs[nextKeyframeIndex].w, outputs[nextKeyframeIndex].x,
-                                outputs[nextKeyframeIndex].y, outputs[nextKeyframeIndex].z);
+        // The hips bob about the clip's mean height, scaled to ours; exporters disagree
+        // on units, so the source rest height is no reference
+        float meanHeight = 0.0f;
+        for (const glm::vec4& value : rootTranslation.values) meanHeight += value.y / samples;
+        float targetHeight = targetRest.translation(0).y;
+        float heightScale = std::abs(meanHeight) > 1e-6f ? targetHeight / meanHeight : 1.0f;
+        for (glm::vec4& value : rootTranslation.values) {
+            value = glm::vec4(targetRest.translation(0) + glm::vec3(0.0f, (value.y - meanHeight) * heightScale, 0.0f), 0.0f);
+        }
 
-            // Spherical linear interpolation
-        	glm::quat rotation = glm::slerp(rotation0, rotation1, factor);
-        	if (glm::dot(rotation0, rotation1) < 0.0f) {
-        		rotation0 = -rotation0;
-        	}
-            nodeComponents[targetNodeIndex].rotation = rotation;
+        AnimationClip clip;
+        for (RawTrack& track : rotations) clip.addTrack(std::move(track));
+        clip.addTrack(std::move(rootTranslation));
+        imported.push_back(std::move(clip));
+    }
+    std::cout << "Retargeted " << imported.size() << " clips from " << path << " onto " << matched << " of "
+              << skeleton.jointCount() << " joints" << std::endl;
+    return imported;
+}
 
-        } else if (channel.target_path == "scale") {
-            glm::vec3 scale0 = glm::vec3(outputs[keyframeIndex]);
-            glm::vec3 scale1 = glm::vec3(outputs[nextKeyframeIndex]);
+void MyBot::updateAnimation(const AnimationClip& clip, float time, LocalPose& pose) {
+    // Start from the rest pose; the clip replaces the components it animates
+    skeleton.copyRestPose(pose);
+    clip.sample(time, pose);
+}
 
-            // Linearly interpolate
-            glm::vec3 scale = glm::mix(scale0, scale1, factor);
-            nodeComponents[targetNodeIndex].scale = scale;
+std::vector<AABB> MyBot::computeClipBounds(const std::vector<AnimationClip>& animations) {
+    std::vector<AABB> result;
+    if (skinObjects.empty()) return result;
+    const SkinObject& skin = skinObjects[0];
+    ArenaScope scope;
+    LocalPose pose = allocatePose(threadArena(), skeleton.jointCount());
+    glm::mat4* localTransforms = threadArena().allocateArray<glm::mat4>(skeleton.jointCount());
+    glm::mat4* modelTransforms = threadArena().allocateArray<glm::mat4>(skeleton.jointCount());
+
+    // Sample each clip densely enough that joints cannot stray far between samples
+    const float sampleStep = 1.0f / 30.0f;
+    for (const AnimationClip& animation : animations) {
+        float duration = animation.duration();
+
+        AABB clip;
+        for (float time = 0.0f;; time = glm::min(time + sampleStep, duration)) {
+            updateAnimation(animation, time, pose);
+            localMatrices(pose, localTransforms);
+            modelMatrices(skeleton, localTransforms, modelTransforms);
+            for (int joint : skin.joints) {
+                clip.expand(glm::vec3(modelTransforms[joint][3]));
+            }
+            if (time >= duration) break;
         }
+
+        // Joints sit inside the mesh, so pad their box to cover the skin around them
+        glm::vec3 size = clip.max - clip.min;
+        glm::vec3 padding(0.25f * glm::max(size.x, glm::max(size.y, size.z)));
+        result.push_back(AABB(clip.min - padding, clip.max + padding));
     }
+    return result;
+}
 
-    // Reconstruct node transforms
-    for (size_t i = 0; i < model.nodes.size(); ++i) {
-        nodeTransforms[i] = glm::translate(glm::mat4(1.0f), nodeComponents[i].translation) *
-                            glm::mat4_cast(nodeComponents[i].rotation) *
-                            glm::scale(glm::mat4(1.0f), nodeComponents[i].scale);
+float MyBot::clipTime(float time) const {
+    if (!useLooping) {
+        // Default behavior - use full animation duration
+        return time;
+    }
+    // If current time is before loop start, reset to loop start
+    if (time < loopStartTime) {
+        return loopStartTime;
     }
+    // If current time is past loop end, wrap back to loop start
+    if (time > loopEndTime) {
+        return loopStartTime + fmod(time - loopEndTime, loopEndTime - loopStartTime);
+    }
+    // Otherwise, use the current time
+    return time;
 }
 
-void MyBot::updateSkinning(const tinygltf::Skin& skin, const std::vector<glm::mat4>& nodeTransforms) {
-    for (SkinObject &skinObject : skinObjects) {
-        // Loop through each joint in the skin
-        for (size_t i = 0; i < skinObject.jointMatrices.size(); ++i) {
-            int jointIndex = skin.joints[i];
-            // Compute the joint matrix: Global transform * Inverse bind matrix
-            skinObject.jointMatrices[i] = nodeTransforms[jointIndex] * skinObject.inverseBindMatrices[i];
-        }
+void MyBot::samplePose(float time, LocalPose& pose) {
+    if (player.layerCount() == 1) {
+        updateAnimation(clips[player.layer(0).clip], clipTime(player.clipTime(0, time)), pose);
+        return;
+    }
+
+    // Every layer samples into scratch and adds its share; the SoA streams blend
+    // four joints per step, so a second layer costs little beyond its sampling
+    float weights[AnimationPlayer::MAX_LAYERS];
+    player.weights(time, weights);
+    ArenaScope scope;
+    LocalPose layerPose = allocatePose(threadArena(), skeleton.jointCount());
+    clearPose(pose);
+    float totalWeight = 0.0f;
+    for (int i = 0; i < player.layerCount(); ++i) {
+        if (weights[i] <= 0.0f) continue;
+        updateAnimation(clips[player.layer(i).clip], clipTime(player.clipTime(i, time)), layerPose);
+        accumulatePose(layerPose, weights[i], pose);
+        totalWeight += weights[i];
     }
+    normalizePose(pose, totalWeight);
 }
 
-void MyBot::update(float time) {
-     if (model.animations.size() > 0) {
-            const tinygltf::Animation &animation = model.animations[0];
-            const AnimationObject &animationObject = animationObjects[0];
-
-            const tinygltf::Skin &skin = model.skins[0];
-            std::vector<glm::mat4> localTransforms(model.nodes.size(), glm::mat4(1.0f));
-            int rootNodeIndex = skin.joints[0];
-
-            // Initialize localTransforms with initial node transforms
-            computeLocalNodeTransform(model, rootNodeIndex, localTransforms);
-
-            // Determine the animation time
-            float animationTime;
-            if (useLooping) {
-                // Calculate total animation duration from input times
-                float totalDuration = animationObject.samplers[0].input.back();
-
-                // If current time is before loop start, reset to loop start
-                if (time < loopStartTime) {
-                    animationTime = loopStartTime;
-                }
-                // If current time is past loop end, wrap back to loop start
-                else if (time > loopEndTime) {
-                    // Adjust time to loop segment
-                    animationTime = loopStartTime +
-                        fmod(time - loopEndTime, loopEndTime - loopStartTime);
-                }
-                // Otherwise, use the current time
-                else {
-                    animationTime = time;
-                }
-            } else {
-                // Default behavior - use full animation duration
-                animationTime = time;
-            }
+void MyBot::buildPalette(const LocalPose& pose, const SkinObject& skin, glm::mat4* palette) {
+    // Scratch transforms for this call only; the arena hands them out without touching the heap
+    ArenaScope scope;
+    glm::mat4* localTransforms = threadArena().allocateArray<glm::mat4>(skeleton.jointCount());
+    glm::mat4* modelTransforms = threadArena().allocateArray<glm::mat4>(skeleton.jointCount());
+
+    // Local matrices four joints at a time, then one pass down the hierarchy
+    localMatrices(pose, localTransforms);
+    modelMatrices(skeleton, localTransforms, modelTransforms);
 
-            // Update local transforms with animation data
-            updateAnimation(model, animation, animationObject, animationTime, localTransforms);
+    // Joint matrix: model-space transform * inverse bind matrix
+    skinningPalette(modelTransforms, skin.joints.data(), skin.inverseBindMatrices.data(),
+                    static_cast<int>(skin.jointMatrices.size()), palette);
+}
 
-            // Recompute global transforms
-            std::vector<glm::mat4> globalTransforms(model.nodes.size(), glm::mat4(1.0f));
-            computeGlobalNodeTransform(model, localTransforms, rootNodeIndex, glm::mat4(1.0f), globalTransforms);
+void MyBot::play(int clip, float time) {
+    if (clips.empty()) return;
+    clip %= static_cast<int>(clips.size());
+    if (clip == player.currentClip()) return;
+    // The first play() has nothing to fade from and keeps update()'s original timing
+    if (player.layerCount() == 0) player.play(clip, 0.0f, 0.0f);
+    else player.play(clip, time, crossfadeSeconds, useLooping ? loopStartTime : 0.0f);
+}
 
-            // Update skinning
-            updateSkinning(model.skins[0], globalTransforms);
-        }
+void MyBot::update(float time) {
+    CPU_SCOPE("Character update");
+    if (clips.empty() || skinObjects.empty()) return;
+    if (player.layerCount() == 0) play(0, time);
+    player.update(time);
+
+    // One clip at full weight is a pose other characters may be in too. Only the
+    // first skin is drawn, so only single-skin characters share palettes.
+    sharedPalette = nullptr;
+    if (player.layerCount() == 1 && poseCache().enabled() && skinObjects.size() == 1) {
+        const SkinObject& skin = skinObjects[0];
+        const AnimationClip& clip = clips[player.layer(0).clip];
+        PoseCache::Key key = poseCache().makeKey(poseFingerprint, player.layer(0).clip, clipTime(player.clipTime(0, time)));
+        sharedPalette = poseCache().palette(key, static_cast<int>(skin.jointMatrices.size()), [&](glm::mat4* palette) {
+            ArenaScope scope;
+            LocalPose pose = allocatePose(threadArena(), skeleton.jointCount());
+            updateAnimation(clip, poseCache().keyTime(key), pose);
+            buildPalette(pose, skin, palette);
+        });
+        if (sharedPalette) return;
+    }
+
+    ArenaScope scope;
+    LocalPose pose = allocatePose(threadArena(), skeleton.jointCount());
+    samplePose(time, pose);
+    for (SkinObject& skinObject : skinObjects) {
+        buildPalette(pose, skinObject, skinObject.jointMatrices.data());
+    }
 }
 
 bool MyBot::loadModel(tinygltf::Model& model, const char* filename) {
@@ -415,6 +518,8 @@ bool MyBot::loadModel(tinygltf::Model& model, const char* filename) {
     std::string err;
     std::string warn;
 
+    // Keep images encoded; initialize() hands them to the texture loader to decode in parallel
+    loader.SetImagesAsIs(true);
     bool res = loader.LoadASCIIFromFile(&model, &err, &warn, filename);
     if (!warn.empty()) {
         std::cout << "WARN: " << warn << std::endl;
@@ -433,23 +538,80 @@ bool MyBot::loadModel(tinygltf::Model& model, const char* filename) {
 
 }
 
-void MyBot::initialize() {
+bool MyBot::loadAsset() {
     // Modify your path if needed
-    if (!loadModel(model, "../project/models/bot/praying .gltf")) {
+    assetPath = "../project/models/bot/praying .gltf";
+    if (!loadModel(model, assetPath.c_str())) {
+        return false;
+    }
+
+    // Flatten the skeleton, then prepare joint matrices
+    std::vector<int> nodeToSkeleton;
+    skeleton = prepareSkeleton(model, nodeToSkeleton);
+    skinObjects = prepareSkinning(model, nodeToSkeleton);
+
+    // Prepare animation data
+    clips = prepareAnimation(model, nodeToSkeleton);
+    clipLibrary = { "../project/models/bot/bot.gltf" };
+    std::vector<std::string> jointNames(skeleton.jointCount());
+    for (size_t node = 0; node < model.nodes.size(); ++node) {
+        if (nodeToSkeleton[node] >= 0) jointNames[nodeToSkeleton[node]] = model.nodes[node].name;
+    }
+    for (const std::string& path : clipLibrary) {
+        std::vector<AnimationClip> imported = importClips(path.c_str(), jointNames);
+        for (AnimationClip& clip : imported) clips.push_back(std::move(clip));
+    }
+    if (compressAnimation) {
+        size_t rawBytes = 0, compressedBytes = 0;
+        int rawKeys = 0, compressedKeys = 0;
+        for (AnimationClip& clip : clips) {
+            rawBytes += clip.byteSize();
+            rawKeys += clip.keyCount();
+            clip.compress(animationTolerance, skeleton);
+            compressedBytes += clip.byteSize();
+            compressedKeys += clip.keyCount();
+        }
+        std::cout << "Animation compressed from " << fixed(rawBytes / 1024.0, 1) << " KB to "
+                  << fixed(compressedBytes / 1024.0, 1) << " KB (" << compressedKeys << " of " << rawKeys
+                  << " keyframes kept)" << std::endl;
+    }
+    // Bounds come from the clips as they will play, compressed or not
+    clipBounds = computeClipBounds(clips);
+
+    // Everything a palette depends on: hierarchy, rest pose, skin, keyframe data, the
+    // clip library and how it was all compressed
+    poseFingerprint = hashBytes(skeleton.parents.data(), skeleton.parents.size() * sizeof(int));
+    poseFingerprint = hashBytes(skeleton.rest.data(), skeleton.rest.size() * sizeof(float), poseFingerprint);
+    for (const SkinObject& skin : skinObjects) {
+        poseFingerprint = hashBytes(skin.joints.data(), skin.joints.size() * sizeof(int), poseFingerprint);
+        poseFingerprint = hashBytes(skin.inverseBindMatrices.data(), skin.inverseBindMatrices.size() * sizeof(glm::mat4), poseFingerprint);
+    }
+    for (const tinygltf::Buffer& buffer : model.buffers) {
+        poseFingerprint = hashBytes(buffer.data.data(), buffer.data.size(), poseFingerprint);
+    }
+    for (const std::string& path : clipLibrary) {
+        poseFingerprint = hashBytes(path.data(), path.size(), poseFingerprint);
+    }
+    poseFingerprint = hashBytes(&compressAnimation, sizeof(compressAnimation), poseFingerprint);
+    poseFingerprint = hashBytes(&animationTolerance, sizeof(animationTolerance), poseFingerprint);
+    assetLoaded = true;
+    return true;
+}
+
+void MyBot::initialize() {
+    if (!assetLoaded && !loadAsset()) {
         return;
     }
 
     // Prepare buffers for rendering
-    primitiveObjects = bindModel(model);
+    bindModel(model);
 
-    // Prepare joint matrices
-    skinObjects = prepareSkinning(model);
-
-    // Prepare animation data
-    animationObjects = prepareAnimation(model);
+    // Everything drawing and animation need has been copied out; the texture loader
+    // keeps its own copy of the encoded images
+    model = tinygltf::Model();
 
     // Create and compile our GLSL program from the shaders
-    programID = LoadShadersFromFile("../project/bot.vert", "../project/bot.frag");
+    programID = loadBotShaders("../project/bot.vert", "../project/bot.frag", !quantizeVertices);
     if (programID == 0)
     {
         std::cerr << "Failed to load shaders." << std::endl;
@@ -463,168 +625,336 @@ void MyBot::initialize() {
     diffuseMapID = glGetUniformLocation(programID, "diffuseMap");
     normalMapID = glGetUniformLocation(programID, "normalMap");
     aoMapID = glGetUniformLocation(programID, "aoMap");
+    positionOriginID = glGetUniformLocation(programID, "positionOrigin");
+    positionExtentID = glGetUniformLocation(programID, "positionExtent");
+
+    depthProgramID = loadBotShaders("../project/bot_depth.vert", "../project/depth.frag", !quantizeVertices);
+    depthMvpMatrixID = glGetUniformLocation(depthProgramID, "MVP");
+    depthJointMatricesID = glGetUniformLocation(depthProgramID, "jointMatrices");
+    depthPositionOriginID = glGetUniformLocation(depthProgramID, "positionOrigin");
+    depthPositionExtentID = glGetUniformLocation(depthProgramID, "positionExtent");
+
+    // Texture units are fixed per map type; maps no material has keep sampling unit 0
+    glState().useProgram(programID);
+    for (const MaterialObject& material : materials) {
+        if (material.diffuse) glUniform1i(diffuseMapID, 0);
+        if (material.normal) glUniform1i(normalMapID, 1);
+        if (material.ao) glUniform1i(aoMapID, 2);
+    }
     std::cout << "Skin objects count: " << skinObjects.size() << std::endl;
-    std::cout << "Animation objects count: " << animationObjects.size() << std::endl;
+    std::cout << "Animation clips count: " << clips.size() << std::endl;
 }
 
-void MyBot::bindMesh(std::vector<PrimitiveObject>& primitiveObjects, tinygltf::Model& model, tinygltf::Mesh& mesh) {
-   std::map<int, GLuint> vbos;
-    for (size_t i = 0; i < model.bufferViews.size(); ++i) {
-        const tinygltf::BufferView &bufferView = model.bufferViews[i];
-
-        int target = bufferView.target;
+namespace {
+
+// Every element of an accessor as floats. Normalized integers map to [0, 1] or
+// [-1, 1], other integers keep their value; missing components are zero.
+void readAccessor(const tinygltf::Model& model, int accessorIndex, std::vector<glm::vec4>& out) {
+    const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+    out.assign(accessor.count, glm::vec4(0.0f));
+    if (accessor.bufferView < 0) return;
+    const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+    const unsigned char* data = model.buffers[view.buffer].data.data() + view.byteOffset + accessor.byteOffset;
+    int stride = accessor.ByteStride(view);
+    int components = std::min(tinygltf::GetNumComponentsInType(accessor.type), 4);
+    if (stride <= 0) return;
+
+    for (size_t i = 0; i < accessor.count; ++i) {
+        const unsigned char* element = data + i * stride;
+        for (int c = 0; c < components; ++c) {
+            float value = 0.0f;
+            switch (accessor.componentType) {
+            case TINYGLTF_COMPONENT_TYPE_FLOAT:
+                memcpy(&value, element + c * sizeof(float), sizeof(float));
+                break;
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                value = accessor.normalized ? element[c] / 255.0f : element[c];
+                break;
+            case TINYGLTF_COMPONENT_TYPE_BYTE: {
+                int8_t v = static_cast<int8_t>(element[c]);
+                value = accessor.normalized ? std::max(v / 127.0f, -1.0f) : v;
+                break;
+            }
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+                uint16_t v;
+                memcpy(&v, element + c * sizeof(v), sizeof(v));
+                value = accessor.normalized ? v / 65535.0f : v;
+                break;
+            }
+            case TINYGLTF_COMPONENT_TYPE_SHORT: {
+                int16_t v;
+                memcpy(&v, element + c * sizeof(v), sizeof(v));
+                value = accessor.normalized ? std::max(v / 32767.0f, -1.0f) : v;
+                break;
+            }
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+                uint32_t v;
+                memcpy(&v, element + c * sizeof(v), sizeof(v));
+                value = static_cast<float>(v);
+                break;
+            }
+            }
+            out[i][c] = value;
+        }
+    }
+}
 
-        if (bufferView.target == 0) {
-            continue;
+// A primitive's indices, or 0 to vertexCount - 1 when it has none
+void readIndices(const tinygltf::Model& model, const tinygltf::Primitive& primitive, size_t vertexCount,
+                 std::vector<uint32_t>& out) {
+    if (primitive.indices < 0) {
+        out.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i) out[i] = static_cast<uint32_t>(i);
+        return;
+    }
+    const tinygltf::Accessor& accessor = model.accessors[primitive.indices];
+    const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+    const unsigned char* data = model.buffers[view.buffer].data.data() + view.byteOffset + accessor.byteOffset;
+    int stride = accessor.ByteStride(view);
+    out.resize(accessor.count);
+    for (size_t i = 0; i < accessor.count; ++i) {
+        const unsigned char* element = data + i * stride;
+        if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+            out[i] = element[0];
+        } else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+            uint16_t index;
+            memcpy(&index, element, sizeof(index));
+            out[i] = index;
+        } else {
+            memcpy(&out[i], element, sizeof(uint32_t));
         }
+        // An out-of-range index would read past the vertex buffer
+        if (out[i] >= vertexCount) out[i] = 0;
+    }
+}
 
-        const tinygltf::Buffer &buffer = model.buffers[bufferView.buffer];
-        GLuint vbo;
-        glGenBuffers(1, &vbo);
-        glBindBuffer(target, vbo);
-        glBufferData(target, bufferView.byteLength,
-                     &buffer.data.at(0) + bufferView.byteOffset, GL_STATIC_DRAW);
+// Bytes one vertex of the accessor takes in the file
+int elementBytes(const tinygltf::Accessor& accessor) {
+    return tinygltf::GetComponentSizeInBytes(accessor.componentType) * tinygltf::GetNumComponentsInType(accessor.type);
+}
 
-        vbos[i] = vbo;
-    }
+} // namespace
 
-    for (size_t i = 0; i < mesh.primitives.size(); ++i) {
-        tinygltf::Primitive primitive = mesh.primitives[i];
+void MyBot::bindModel(const tinygltf::Model& model) {
+    // Gather the scene's meshes without recursion; the bot draws them untransformed
+    std::vector<int> meshes;
+    std::vector<int> pending;
+    if (!model.scenes.empty()) {
+        const tinygltf::Scene &scene = model.scenes[std::max(0, model.defaultScene)];
+        pending.assign(scene.nodes.rbegin(), scene.nodes.rend());
+    }
+    while (!pending.empty()) {
+        const tinygltf::Node &node = model.nodes[pending.back()];
+        pending.pop_back();
+        if (node.mesh >= 0 && node.mesh < static_cast<int>(model.meshes.size())) meshes.push_back(node.mesh);
+        pending.insert(pending.end(), node.children.rbegin(), node.children.rend());
+    }
 
-        // Add this section to load material textures
-        if (primitive.material >= 0) {
-            const tinygltf::Material& material = model.materials[primitive.material];
-            loadMaterialTextures(model, material);
+    // One box for every primitive, so the shaders decode positions with one pair of uniforms
+    std::vector<glm::vec4> positions, normals, texCoords, joints, weights;
+    AABB box;
+    for (int meshIndex : meshes) {
+        for (const tinygltf::Primitive &primitive : model.meshes[meshIndex].primitives) {
+            auto position = primitive.attributes.find("POSITION");
+            if (position == primitive.attributes.end()) continue;
+            readAccessor(model, position->second, positions);
+            for (const glm::vec4& p : positions) box.expand(glm::vec3(p));
         }
+    }
+    if (box.isEmpty()) box = AABB(glm::vec3(0.0f), glm::vec3(0.0f));
+    positionOrigin = box.min;
+    positionExtent = box.max - box.min;
+
+    // Materials are loaded once each, whichever primitives share them
+    materials.resize(model.materials.size());
+    std::vector<bool> materialLoaded(model.materials.size(), false);
+
+    size_t vertexCount = 0, sourceBytes = 0;
+    float positionError = 0.0f, normalError = 0.0f;
+    std::vector<SkinnedVertex> vertices;
+    std::vector<FloatSkinnedVertex> floatVertices;
+    std::vector<uint32_t> indices, remap;
+    std::vector<uint16_t> shortIndices;
+    std::vector<glm::vec3> points;
+    // Triangles, and vertices transformed and referenced, before and after optimizing
+    double triangles = 0.0, transformedBefore = 0.0, transformedAfter = 0.0, referenced = 0.0;
+    for (int meshIndex : meshes) {
+        for (const tinygltf::Primitive &primitive : model.meshes[meshIndex].primitives) {
+            auto position = primitive.attributes.find("POSITION");
+            if (position == primitive.attributes.end()) continue;
+            if (primitive.material >= 0 && !materialLoaded[primitive.material]) {
+                materials[primitive.material] = loadMaterialTextures(model, model.materials[primitive.material]);
+                materialLoaded[primitive.material] = true;
+            }
 
-        tinygltf::Accessor indexAccessor = model.accessors[primitive.indices];
+            // Attributes the primitive lacks read as zero; a vertex without weights
+            // follows its first joint
+            readAccessor(model, position->second, positions);
+            size_t count = positions.size();
+            normals.assign(count, glm::vec4(0.0f, 0.0f, 1.0f, 0.0f));
+            texCoords.assign(count, glm::vec4(0.0f));
+            joints.assign(count, glm::vec4(0.0f));
+            weights.assign(count, glm::vec4(0.0f));
+            for (const auto &attrib : primitive.attributes) {
+                const tinygltf::Accessor &accessor = model.accessors[attrib.second];
+                sourceBytes += static_cast<size_t>(elementBytes(accessor)) * accessor.count;
+                std::vector<glm::vec4>* target = nullptr;
+                if (attrib.first == "NORMAL") target = &normals;
+                else if (attrib.first == "TEXCOORD_0") target = &texCoords;
+                else if (attrib.first == "JOINTS_0") target = &joints;
+                else if (attrib.first == "WEIGHTS_0") target = &weights;
+                else if (attrib.first != "POSITION") std::cout << "Unrecognized attribute: " << attrib.first << std::endl;
+                if (target && accessor.count == count) readAccessor(model, attrib.second, *target);
+            }
 
-        GLuint vao;
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
+            vertices.resize(quantizeVertices ? count : 0);
+            floatVertices.resize(quantizeVertices ? 0 : count);
+            for (size_t i = 0; i < count; ++i) {
+                glm::vec3 p(positions[i]);
+                glm::vec3 n = glm::length(glm::vec3(normals[i])) > 0.0f ? glm::normalize(glm::vec3(normals[i])) : glm::vec3(0.0f, 0.0f, 1.0f);
+                glm::u8vec4 jointIndices(glm::clamp(joints[i], glm::vec4(0.0f), glm::vec4(255.0f)));
+                if (!quantizeVertices) {
+                    floatVertices[i] = FloatSkinnedVertex{ p, n, glm::vec2(texCoords[i]), jointIndices, weights[i] };
+                    continue;
+                }
 
-        for (auto &attrib : primitive.attributes) {
-            tinygltf::Accessor accessor = model.accessors[attrib.second];
-            int byteStride =
-                accessor.ByteStride(model.bufferViews[accessor.bufferView]);
-            glBindBuffer(GL_ARRAY_BUFFER, vbos[accessor.bufferView]);
+                SkinnedVertex &vertex = vertices[i];
+                vertex.position = quantizePosition(p, positionOrigin, positionExtent);
+                vertex.normal = encodeOctahedral(n);
+                vertex.texCoord = packHalf2(glm::vec2(texCoords[i]));
+                vertex.joints = jointIndices;
+                vertex.weights = quantizeWeights(weights[i]);
 
-            int size = 1;
-            if (accessor.type != TINYGLTF_TYPE_SCALAR) {
-                size = accessor.type;
+                positionError = std::max(positionError, glm::length(dequantizePosition(vertex.position, positionOrigin, positionExtent) - p));
+                glm::vec3 decoded = decodeOctahedral(vertex.normal);
+                normalError = std::max(normalError, std::atan2(glm::length(glm::cross(decoded, n)), glm::dot(decoded, n)));
             }
+            vertexCount += count;
+
+            DrawItem item;
+            item.mode = primitive.mode >= 0 ? primitive.mode : GL_TRIANGLES;
+            item.material = primitive.material;
+
+            // Triangle lists are reordered for the vertex cache, then optionally for
+            // overdraw, and their vertices renumbered in the order they are fetched
+            readIndices(model, primitive, count, indices);
+            if (item.mode == GL_TRIANGLES && optimizeMeshes && indices.size() >= 3) {
+                VertexCacheStats before = analyzeVertexCache(indices.data(), indices.size(), count);
+                optimizeVertexCache(indices.data(), indices.size(), count);
+                if (reorderForOverdraw) {
+                    points.resize(count);
+                    for (size_t i = 0; i < count; ++i) points[i] = glm::vec3(positions[i]);
+                    optimizeOverdraw(indices.data(), indices.size(), points.data(), count);
+                }
+                optimizeVertexFetch(indices.data(), indices.size(), count, remap);
+                if (quantizeVertices) remapVertices(vertices, remap);
+                else remapVertices(floatVertices, remap);
+                VertexCacheStats after = analyzeVertexCache(indices.data(), indices.size(), count);
+
+                double primitiveTriangles = double(indices.size() / 3);
+                triangles += primitiveTriangles;
+                transformedBefore += before.acmr * primitiveTriangles;
+                transformedAfter += after.acmr * primitiveTriangles;
+                referenced += before.acmr * primitiveTriangles / before.atvr;
+            }
+
+            glGenVertexArrays(1, &item.vao);
+            glState().bindVertexArray(item.vao);
 
-            if (attrib.first.compare("POSITION") == 0) {
-                int vaa = 0;
-                glEnableVertexAttribArray(vaa);
-                glVertexAttribPointer(vaa, size, accessor.componentType,
-                                      accessor.normalized ? GL_TRUE : GL_FALSE,
-                                      byteStride, BUFFER_OFFSET(accessor.byteOffset));
-            } else if (attrib.first.compare("NORMAL") == 0) {
-                int vaa = 1;
-                glEnableVertexAttribArray(vaa);
-                glVertexAttribPointer(vaa, size, accessor.componentType,
-                                      accessor.normalized ? GL_TRUE : GL_FALSE,
-                                      byteStride, BUFFER_OFFSET(accessor.byteOffset));
-            } else if (attrib.first.compare("TEXCOORD_0") == 0) {
-                int vaa = 2;
-                glEnableVertexAttribArray(vaa);
-                glVertexAttribPointer(vaa, size, accessor.componentType,
-                                      accessor.normalized ? GL_TRUE : GL_FALSE,
-                                      byteStride, BUFFER_OFFSET(accessor.byteOffset));
-            } else if (attrib.first.compare("JOINTS_0") == 0) {
-                int vaa = 3; // Attribute location for JOINTS_0
-                glEnableVertexAttribArray(vaa);
-                glVertexAttribIPointer(vaa, size, accessor.componentType,
-                                       byteStride, BUFFER_OFFSET(accessor.byteOffset));
-            } else if (attrib.first.compare("WEIGHTS_0") == 0) {
-                int vaa = 4; // Attribute location for WEIGHTS_0
-                glEnableVertexAttribArray(vaa);
-                glVertexAttribPointer(vaa, size, accessor.componentType,
-                                      accessor.normalized ? GL_TRUE : GL_FALSE,
-                                      byteStride, BUFFER_OFFSET(accessor.byteOffset));
+            GLuint vertexBuffer;
+            glGenBuffers(1, &vertexBuffer);
+            glState().bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            if (quantizeVertices) {
+                glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(SkinnedVertex), vertices.data(), GL_STATIC_DRAW);
+                applyVertexLayout<SkinnedVertex>();
             } else {
-                std::cout << "Unrecognized attribute: " << attrib.first << std::endl;
+                glBufferData(GL_ARRAY_BUFFER, floatVertices.size() * sizeof(FloatSkinnedVertex), floatVertices.data(), GL_STATIC_DRAW);
+                applyVertexLayout<FloatSkinnedVertex>();
             }
+            buffers.push_back(vertexBuffer);
+
+            // Capture the index buffer in the VAO so drawing only needs to bind it;
+            // 16-bit indices whenever the vertices fit
+            GLuint indexBuffer;
+            glGenBuffers(1, &indexBuffer);
+            glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+            if (count <= 65536) {
+                shortIndices.assign(indices.begin(), indices.end());
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+                item.indexType = GL_UNSIGNED_SHORT;
+            } else {
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+                item.indexType = GL_UNSIGNED_INT;
+            }
+            buffers.push_back(indexBuffer);
+            item.count = static_cast<GLsizei>(indices.size());
+            item.indexOffset = 0;
+            glState().bindVertexArray(0);
+            drawItems.push_back(item);
         }
-
-        // Record VAO for later use
-        PrimitiveObject primitiveObject;
-        primitiveObject.vao = vao;
-        primitiveObject.vbos = vbos;
-        primitiveObjects.push_back(primitiveObject);
-
-        glBindVertexArray(0);
     }
-}
-
-void MyBot::bindModelNodes(std::vector<PrimitiveObject>& primitiveObjects, tinygltf::Model& model, tinygltf::Node& node) {
-    // Bind buffers for the current mesh at the node
-    if ((node.mesh >= 0) && (node.mesh < model.meshes.size())) {
-        bindMesh(primitiveObjects, model, model.meshes[node.mesh]);
+    if (vertexCount) {
+        size_t vertexBytes = quantizeVertices ? sizeof(SkinnedVertex) : sizeof(FloatSkinnedVertex);
+        std::cout << (quantizeVertices ? "Quantized " : "Interleaved ") << vertexCount << " vertices from "
+                  << fixed(double(sourceBytes) / vertexCount, 1) << " to " << vertexBytes << " bytes each";
+        if (quantizeVertices) {
+            std::cout << " (max error " << positionError << " position, "
+                      << fixed(glm::degrees(normalError), 3) << " degrees normal)";
+        }
+        std::cout << std::endl;
     }
-
-    // Recursive into children nodes
-    for (size_t i = 0; i < node.children.size(); i++) {
-        assert((node.children[i] >= 0) && (node.children[i] < model.nodes.size()));
-        bindModelNodes(primitiveObjects, model, model.nodes[node.children[i]]);
+    if (triangles > 0.0) {
+        std::cout << "Optimized " << fixed(triangles, 0) << " triangles: ACMR "
+                  << fixed(transformedBefore / triangles, 3) << " -> " << fixed(transformedAfter / triangles, 3)
+                  << ", ATVR " << fixed(transformedBefore / referenced, 3) << " -> "
+                  << fixed(transformedAfter / referenced, 3) << " (" << VERTEX_CACHE_SIZE << "-entry FIFO)" << std::endl;
     }
 }
 
-std::vector<MyBot::PrimitiveObject> MyBot::bindModel(tinygltf::Model& model) {
-    std::vector<PrimitiveObject> primitiveObjects;
-
-    const tinygltf::Scene &scene = model.scenes[model.defaultScene];
-    for (size_t i = 0; i < scene.nodes.size(); ++i) {
-        assert((scene.nodes[i] >= 0) && (scene.nodes[i] < model.nodes.size()));
-        bindModelNodes(primitiveObjects, model, model.nodes[scene.nodes[i]]);
+void MyBot::drawModel(bool bindMaterials) {
+    int boundMaterial = -1;
+    for (const DrawItem& item : drawItems) {
+        if (bindMaterials && item.material >= 0 && item.material != boundMaterial) {
+            const MaterialObject& material = materials[item.material];
+            if (material.diffuse) glState().bindTexture(0, GL_TEXTURE_2D, material.diffuse);
+            if (material.normal) glState().bindTexture(1, GL_TEXTURE_2D, material.normal);
+            if (material.ao) glState().bindTexture(2, GL_TEXTURE_2D, material.ao);
+            boundMaterial = item.material;
+        }
+        glState().bindVertexArray(item.vao);
+        if (item.indexType) {
+            glDrawElements(item.mode, item.count, item.indexType, BUFFER_OFFSET(item.indexOffset));
+        } else {
+            glDrawArrays(item.mode, 0, item.count);
+        }
     }
-
-    return primitiveObjects;
 }
 
-void MyBot::drawMesh(const std::vector<PrimitiveObject>& primitiveObjects, tinygltf::Model& model, tinygltf::Mesh& mesh) {
-    for (size_t i = 0; i < mesh.primitives.size(); ++i)
-    {
-        GLuint vao = primitiveObjects[i].vao;
-        std::map<int, GLuint> vbos = primitiveObjects[i].vbos;
-
-        glBindVertexArray(vao);
-
-        tinygltf::Primitive primitive = mesh.primitives[i];
-        tinygltf::Accessor indexAccessor = model.accessors[primitive.indices];
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbos.at(indexAccessor.bufferView));
-
-        glDrawElements(primitive.mode, indexAccessor.count,
-                    indexAccessor.componentType,
-                    BUFFER_OFFSET(indexAccessor.byteOffset));
-
-        glBindVertexArray(0);
-    }
+AABB MyBot::localBounds() const {
+    AABB bounds;
+    for (const AABB& clip : clipBounds) bounds.expand(clip);
+    return bounds;
 }
 
-void MyBot::drawModelNodes(const std::vector<PrimitiveObject>& primitiveObjects, tinygltf::Model& model, tinygltf::Node& node) {
-    // Draw the mesh at the node, and recursively do so for children nodes
-    if ((node.mesh >= 0) && (node.mesh < model.meshes.size())) {
-        drawMesh(primitiveObjects, model, model.meshes[node.mesh]);
-    }
-    for (size_t i = 0; i < node.children.size(); i++) {
-        drawModelNodes(primitiveObjects, model, model.nodes[node.children[i]]);
-    }
+int MyBot::copyJointMatrices(glm::mat4* out, int maxJoints) const {
+    if (skinObjects.empty()) return 0;
+    const std::vector<glm::mat4>& joints = skinObjects[0].jointMatrices;
+    int count = std::min(static_cast<int>(joints.size()), maxJoints);
+    std::copy_n(sharedPalette ? sharedPalette : joints.data(), count, out);
+    return count;
 }
 
-void MyBot::drawModel(const std::vector<PrimitiveObject>& primitiveObjects, tinygltf::Model& model) {
-    // Draw all nodes
-    const tinygltf::Scene &scene = model.scenes[model.defaultScene];
-    for (size_t i = 0; i < scene.nodes.size(); ++i) {
-        drawModelNodes(primitiveObjects, model, model.nodes[scene.nodes[i]]);
+void MyBot::requestTextureDetail(float screenPixels) const {
+    for (const MaterialObject& material : materials) {
+        if (material.diffuse) textureLoader().requestDetail(material.diffuse, screenPixels);
+        if (material.normal) textureLoader().requestDetail(material.normal, screenPixels);
+        if (material.ao) textureLoader().requestDetail(material.ao, screenPixels);
     }
 }
 
-
-void MyBot::render(glm::mat4 cameraMatrix) {
-    glUseProgram(programID);
+void MyBot::render(glm::mat4 cameraMatrix, const glm::mat4* jointMatrices, int jointCount) {
+    GPU_SCOPE("Character");
+    glState().useProgram(programID);
 
     // Set camera
     glm::mat4 mvp = cameraMatrix;
@@ -634,46 +964,42 @@ void MyBot::render(glm::mat4 cameraMatrix) {
     // TODO: Set animation data for linear blend skinning in shader
     // -----------------------------------------------------------------
 
-    glUniformMatrix4fv(jointMatricesID, skinObjects[0].jointMatrices.size(), GL_FALSE, glm::value_ptr(skinObjects[0].jointMatrices[0]));
+    glUniformMatrix4fv(jointMatricesID, jointCount, GL_FALSE, glm::value_ptr(jointMatrices[0]));
 
     // -----------------------------------------------------------------
 
     // Set light data
     glUniform3fv(lightPositionID, 1, &lightPosition[0]);
     glUniform3fv(lightIntensityID, 1, &lightIntensity[0]);
+    glUniform3fv(positionOriginID, 1, &positionOrigin[0]);
+    glUniform3fv(positionExtentID, 1, &positionExtent[0]);
 
-    // Bind textures
-    for (const auto& texObj : textureObjects) {
-        if (texObj.type == "diffuse") {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, texObj.id);
-            glUniform1i(diffuseMapID, 0);
-        }
-        else if (texObj.type == "normal") {
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, texObj.id);
-            glUniform1i(normalMapID, 1);
-        }
-        else if (texObj.type == "ao") {
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, texObj.id);
-            glUniform1i(aoMapID, 2);
-        }
-    }
-
-    // Draw the GLTF model
-    drawModel(primitiveObjects, model);
+    // Draw the GLTF model, binding each material's textures as it comes up
+    drawModel(true);
 
 
 }
 
 
+// Skinned depth for the shadow pass; lightMatrix is light-space * model
+void MyBot::renderDepth(glm::mat4 lightMatrix, const glm::mat4* jointMatrices, int jointCount) {
+    GPU_SCOPE("Character");
+    glState().useProgram(depthProgramID);
+    glUniformMatrix4fv(depthMvpMatrixID, 1, GL_FALSE, &lightMatrix[0][0]);
+    glUniformMatrix4fv(depthJointMatricesID, jointCount, GL_FALSE, glm::value_ptr(jointMatrices[0]));
+    glUniform3fv(depthPositionOriginID, 1, &positionOrigin[0]);
+    glUniform3fv(depthPositionExtentID, 1, &positionExtent[0]);
+    drawModel(false);
+}
+
 void MyBot::cleanup() {
     glDeleteProgram(programID);
-    for (const auto& texObj : textureObjects) {
-        glDeleteTextures(1, &texObj.id);
-    }
-    textureObjects.clear();
+    glDeleteProgram(depthProgramID);
+    for (const DrawItem& item : drawItems) glDeleteVertexArrays(1, &item.vao);
+    glDeleteBuffers(static_cast<GLsizei>(buffers.size()), buffers.data());
+    drawItems.clear();
+    buffers.clear();
+    materials.clear();   // The textures belong to the texture loader
 }
 
 
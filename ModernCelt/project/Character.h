@@ -6,8 +6,15 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/string_cast.hpp>
+#include <glm/gtc/type_precision.hpp>
 #include <tiny_gltf.h>
 #include <render/shader.h>
+#include "render/VertexFormat.h"
+#include "scene/Bounds.h"
+#include "anim/AnimationClip.h"
+#include "anim/Skeleton.h"
+#include "anim/PoseCache.h"
+#include "anim/AnimationPlayer.h"
 #include <vector>
 #include <iostream>
 #include <map>
@@ -18,14 +25,66 @@
 
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
+// Skinned vertex as uploaded, quantized from the glTF attributes at load (see
+// VertexQuantization.h): 24 bytes against 52 for float attributes
+struct SkinnedVertex {
+    glm::u16vec4 position;   // Within the mesh bounds; w unused
+    glm::i16vec2 normal;     // Octahedral
+    Half2 texCoord;
+    glm::u8vec4 joints;
+    glm::u8vec4 weights;
+};
+
+template <> struct VertexLayout<SkinnedVertex> {
+    static constexpr std::array<VertexAttribute, 5> attributes = {{
+        VERTEX_ATTRIBUTE_NORMALIZED(SkinnedVertex, position, 0),
+        VERTEX_ATTRIBUTE_NORMALIZED(SkinnedVertex, normal, 1),
+        VERTEX_ATTRIBUTE(SkinnedVertex, texCoord, 2),
+        VERTEX_ATTRIBUTE(SkinnedVertex, joints, 3),
+        VERTEX_ATTRIBUTE_NORMALIZED(SkinnedVertex, weights, 4),
+    }};
+};
+
+// The same attributes kept as floats, for comparing against quantizeVertices off
+struct FloatSkinnedVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+    glm::u8vec4 joints;
+    glm::vec4 weights;
+};
+
+template <> struct VertexLayout<FloatSkinnedVertex> {
+    static constexpr std::array<VertexAttribute, 5> attributes = {{
+        VERTEX_ATTRIBUTE(FloatSkinnedVertex, position, 0),
+        VERTEX_ATTRIBUTE(FloatSkinnedVertex, normal, 1),
+        VERTEX_ATTRIBUTE(FloatSkinnedVertex, texCoord, 2),
+        VERTEX_ATTRIBUTE(FloatSkinnedVertex, joints, 3),
+        VERTEX_ATTRIBUTE(FloatSkinnedVertex, weights, 4),
+    }};
+};
+
 struct MyBot {
     // Shader uniform IDs
     GLuint mvpMatrixID;
     GLuint jointMatricesID;
     GLuint lightPositionID;
     GLuint lightIntensityID;
+    GLuint positionOriginID;
+    GLuint positionExtentID;
     GLuint programID;
 
+    // Skinned depth-only program for the shadow pass
+    GLuint depthProgramID;
+    GLuint depthMvpMatrixID;
+    GLuint depthJointMatricesID;
+    GLuint depthPositionOriginID;
+    GLuint depthPositionExtentID;
+
+    // Model-space bounds of every pose each clip passes through, one per animation.
+    // They hold for the whole clip, so culling never needs the current pose.
+    std::vector<AABB> clipBounds;
+
     // Light properties
     glm::vec3 lightIntensity;
     glm::vec3 lightPosition;
@@ -34,87 +93,143 @@ struct MyBot {
     MyBot() : lightIntensity(5e6f, 5e6f, 5e6f),
              lightPosition(-275.0f, 500.0f, 800.0f) {}
 
-    // GLTF model and animation data
+    // Parsed glTF; only alive between loadAsset() and the end of initialize(), which
+    // converts it into the flat structures below and frees it
     tinygltf::Model model;
+    std::string assetPath;
 
     // Animation control properties
     float loopStartTime = 0.5f;
     float loopEndTime = 10.0f;
     bool useLooping = true;
 
-    // Structures for GLTF rendering and animation
-    struct PrimitiveObject {
+    // Compress the clips at load; set before loadAsset()
+    bool compressAnimation = true;
+    AnimationTolerance animationTolerance;
+
+    // Pack vertices into SkinnedVertex rather than FloatSkinnedVertex; set before
+    // initialize()
+    bool quantizeVertices = true;
+
+    // Reorder triangles and vertices for the GPU at load, the triangles for overdraw
+    // as well as the vertex cache; set before initialize()
+    bool optimizeMeshes = true;
+    bool reorderForOverdraw = true;
+
+    // One indexed draw per glTF primitive; the VAO captures the vertex layout and
+    // the element buffer, so drawing is a walk over this list
+    struct DrawItem {
         GLuint vao;
-        std::map<int, GLuint> vbos;
+        GLenum mode;
+        GLsizei count;        // Indices, or vertices when indexType is 0
+        GLenum indexType;
+        size_t indexOffset;   // Bytes into the element buffer
+        int material;         // Index into materials, -1 for none
+    };
+    std::vector<DrawItem> drawItems;
+    std::vector<GLuint> buffers;
+
+    // Box every quantized position lies in; the shaders map unorm16 back into it
+    glm::vec3 positionOrigin = glm::vec3(0.0f);
+    glm::vec3 positionExtent = glm::vec3(1.0f);
+
+    // Texture IDs per glTF material; 0 where the material has no such map
+    struct MaterialObject {
+        GLuint diffuse = 0;
+        GLuint normal = 0;
+        GLuint ao = 0;
     };
-    std::vector<PrimitiveObject> primitiveObjects;
+    std::vector<MaterialObject> materials;
+
+    // The nodes under the skin's root, parents before children
+    Skeleton skeleton;
 
     struct SkinObject {
+        std::vector<int> joints;   // Skeleton index of each joint
         std::vector<glm::mat4> inverseBindMatrices;
-        std::vector<glm::mat4> globalJointTransforms;
         std::vector<glm::mat4> jointMatrices;
     };
     std::vector<SkinObject> skinObjects;
 
-    struct SamplerObject {
-        std::vector<float> input;
-        std::vector<glm::vec4> output;
-        int interpolation;
-    };
+    // One clip per glTF animation, its tracks targeting skeleton joints; the asset's
+    // own first, then those retargeted from clipLibrary
+    std::vector<AnimationClip> clips;
 
-    struct TextureObject {
-        GLuint id;
-        int width;
-        int height;
-        int channels;
-        std::string type;
-    };
+    // Other glTF files whose animations play on this skeleton, matched by joint name
+    std::vector<std::string> clipLibrary;
 
-    struct AnimationObject {
-        std::vector<SamplerObject> samplers;
-    };
-    std::vector<AnimationObject> animationObjects;
+    // Clips playing on this instance and how they crossfade
+    AnimationPlayer player;
+    float crossfadeSeconds = 0.5f;
 
-    // Inverse root transformation for skinning
-    glm::mat4 inverseRootTransform;
+    // Identifies the skeleton, skin and clips for the pose cache: characters loaded
+    // from the same asset with the same settings evaluate to the same palettes
+    uint64_t poseFingerprint = 0;
+    // The pose cache's palette from the last update(), or null when it was
+    // evaluated into skinObjects[0].jointMatrices
+    const glm::mat4* sharedPalette = nullptr;
 
-    // Texture IDs
+    // Texture sampler uniforms
     GLuint diffuseMapID;
     GLuint normalMapID;
     GLuint aoMapID;
-    std::vector<TextureObject> textureObjects;
 
     // Methods for loading and managing textures
-    GLuint loadTexture(const tinygltf::Image& image);
-    void loadMaterialTextures(const tinygltf::Model& model, const tinygltf::Material& material);
+    GLuint loadTexture(const tinygltf::Image& image, const glm::u8vec4& placeholder, bool normalMap = false);
+    MaterialObject loadMaterialTextures(const tinygltf::Model& model, const tinygltf::Material& material);
 
-    // Methods for node transformations
-    glm::mat4 getNodeTransform(const tinygltf::Node& node);
-    void computeLocalNodeTransform(const tinygltf::Model& model, int nodeIndex, std::vector<glm::mat4>& localTransforms);
-    void computeGlobalNodeTransform(const tinygltf::Model& model, const std::vector<glm::mat4>& localTransforms, int nodeIndex, const glm::mat4& parentTransform, std::vector<glm::mat4>& globalTransforms);
+    // Flattens the hierarchy under the skin's root; nodeToSkeleton maps glTF nodes to joints
+    Skeleton prepareSkeleton(const tinygltf::Model& model, std::vector<int>& nodeToSkeleton);
 
     // Methods for skinning and animation
-    std::vector<SkinObject> prepareSkinning(const tinygltf::Model& model);
-    int findKeyframeIndex(const std::vector<float>& times, float animationTime);
-    std::vector<AnimationObject> prepareAnimation(const tinygltf::Model& model);
-
-    void updateAnimation(const tinygltf::Model& model, const tinygltf::Animation& anim, const AnimationObject& animationObject, float time, std::vector<glm::mat4>& nodeTransforms);
-    void updateSkinning(const tinygltf::Skin& skin, const std::vector<glm::mat4>& nodeTransforms);
-
+    std::vector<SkinObject> prepareSkinning(const tinygltf::Model& model, const std::vector<int>& nodeToSkeleton);
+    std::vector<AnimationClip> prepareAnimation(const tinygltf::Model& model, const std::vector<int>& nodeToSkeleton);
+    // Retargets another asset's animations: every joint's skeleton-space rotation
+    // moves away from its rest pose as the source joint of the same name does. The
+    // root keeps its rest heading and only bobs vertically, so clips play in place.
+    std::vector<AnimationClip> importClips(const char* path, const std::vector<std::string>& jointNames);
+    std::vector<AABB> computeClipBounds(const std::vector<AnimationClip>& animations);
+
+    void updateAnimation(const AnimationClip& clip, float time, LocalPose& pose);
+    // Time within a clip; the loop window applies to every clip
+    float clipTime(float time) const;
+    // The player's layers sampled and blended by weight
+    void samplePose(float time, LocalPose& pose);
+    // Hierarchy and palette of one skin in pose
+    void buildPalette(const LocalPose& pose, const SkinObject& skin, glm::mat4* palette);
+
+    // Crossfades to clip (wrapped to the clips loaded) from time on
+    void play(int clip, float time);
+
+    // Evaluates the player's clips; with the pose cache enabled, characters playing one
+    // clip at the same pose this tick share one evaluation
     void update(float time);
     bool loadModel(tinygltf::Model& model, const char* filename);
-    void initialize();
 
-    // Methods for binding and drawing GLTF data
-    void bindMesh(std::vector<PrimitiveObject>& primitiveObjects, tinygltf::Model& model, tinygltf::Mesh& mesh);
-    void bindModelNodes(std::vector<PrimitiveObject>& primitiveObjects, tinygltf::Model& model, tinygltf::Node& node);
-    std::vector<PrimitiveObject> bindModel(tinygltf::Model& model);
+    // CPU half of loading: parse the glTF and prepare skinning and animation data.
+    // Touches no GL state, so it may run on a job system worker.
+    bool loadAsset();
+    bool assetLoaded = false;
 
-    void drawMesh(const std::vector<PrimitiveObject>& primitiveObjects, tinygltf::Model& model, tinygltf::Mesh& mesh);
-    void drawModelNodes(const std::vector<PrimitiveObject>& primitiveObjects, tinygltf::Model& model, tinygltf::Node& node);
-    void drawModel(const std::vector<PrimitiveObject>& primitiveObjects, tinygltf::Model& model);
+    // GL half: buffers, textures and shaders; loads the asset first if needed
+    void initialize();
 
-    // Rendering and cleanup
-    void render(glm::mat4 cameraMatrix);
+    // Builds buffers, draw items and materials from the scene's meshes, quantizing
+    // each primitive's vertices into one interleaved SkinnedVertex buffer (or
+    // FloatSkinnedVertex with quantizeVertices off) and
+    // reordering its triangles and vertices (see MeshOptimizer.h)
+    void bindModel(const tinygltf::Model& model);
+    void drawModel(bool bindMaterials);
+
+    // Skinning palette from the last update(); returns the number of joints written
+    int copyJointMatrices(glm::mat4* out, int maxJoints) const;
+
+    // Rendering and cleanup; jointMatrices is a palette captured by copyJointMatrices()
+    void render(glm::mat4 cameraMatrix, const glm::mat4* jointMatrices, int jointCount);
+    void renderDepth(glm::mat4 lightMatrix, const glm::mat4* jointMatrices, int jointCount);
+    // The material maps cover the whole body once
+    void requestTextureDetail(float screenPixels) const;
+    // Conservative model-space bounds for every clip update() may play
+    AABB localBounds() const;
     void cleanup();
 };
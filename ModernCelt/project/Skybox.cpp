@@ -1,7 +1,9 @@
 #include "Skybox.h"
 #include <glm/gtc/matrix_transform.hpp>
-#include "stb_image.h"
 #include <render/shader.h>
+#include "render/GLState.h"
+#include "render/TextureLoader.h"
+#include "render/GpuProfiler.h"
 #include <iostream>
 
 // Vertex buffer data
@@ -136,27 +138,7 @@ const GLfloat Skybox::uv_buffer_data[48] = {
 
 // Load skybox texture
 GLuint LoadSkyBoxTexture(const char* texture_file_path) {
-    int w, h, channels;
-    uint8_t* img = stbi_load(texture_file_path, &w, &h, &channels, 3);
-    GLuint texture;
-
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    if (img) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, img);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
-        std::cerr << "Failed to load texture: " << texture_file_path << std::endl;
-    }
-
-    stbi_image_free(img);
-    return texture;
+    return textureLoader().load(texture_file_path);
 }
 
 // Initialize skybox
@@ -164,24 +146,13 @@ void Skybox::initialize(glm::vec3 position, glm::vec3 scale) {
     this->position = position;
     this->scale = scale;
 
-    glGenVertexArrays(1, &vertexArrayID);
-    glBindVertexArray(vertexArrayID);
-
-    glGenBuffers(1, &vertexBufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_buffer_data), vertex_buffer_data, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &colorBufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(color_buffer_data), color_buffer_data, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &uvBufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(uv_buffer_data), uv_buffer_data, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &indexBufferID);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index_buffer_data), index_buffer_data, GL_STATIC_DRAW);
+    SkyboxVertex vertices[24];
+    for (int i = 0; i < 24; ++i) {
+        vertices[i].position = glm::vec3(vertex_buffer_data[3 * i], vertex_buffer_data[3 * i + 1], vertex_buffer_data[3 * i + 2]);
+        vertices[i].color = glm::vec3(color_buffer_data[3 * i], color_buffer_data[3 * i + 1], color_buffer_data[3 * i + 2]);
+        vertices[i].uv = glm::vec2(uv_buffer_data[2 * i], uv_buffer_data[2 * i + 1]);
+    }
+    mesh.initialize(vertices, 24, index_buffer_data, 36);
 
     programID = LoadShadersFromFile("../project/skybox.vert", "../project/skybox.frag");
     if (programID == 0) {
@@ -191,26 +162,16 @@ void Skybox::initialize(glm::vec3 position, glm::vec3 scale) {
     mvpMatrixID = glGetUniformLocation(programID, "MVP");
     textureSamplerID = glGetUniformLocation(programID, "textureSampler");
     textureID = LoadSkyBoxTexture("../project/textures/sky.png");
+
+    glState().useProgram(programID);
+    glUniform1i(textureSamplerID, 0);
 }
 
 // Render skybox
 void Skybox::render(glm::mat4 cameraMatrix) {
-    glUseProgram(programID);
-    glBindVertexArray(vertexArrayID);
-
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-    glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+    GPU_SCOPE("Skybox");
+    glState().useProgram(programID);
+    mesh.bind();
 
     glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), position);
     modelMatrix = glm::scale(modelMatrix, scale);
@@ -218,25 +179,15 @@ void Skybox::render(glm::mat4 cameraMatrix) {
 
     glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glUniform1i(textureSamplerID, 0);
-
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr);
-
-    glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
-    glDisableVertexAttribArray(2);
+    glState().bindTexture(0, GL_TEXTURE_2D, textureID);
 
-    glBindVertexArray(0);
+    glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, nullptr);
 }
 
 // Cleanup skybox
 void Skybox::cleanup() {
-    if (vertexArrayID) glDeleteVertexArrays(1, &vertexArrayID);
-    if (vertexBufferID) glDeleteBuffers(1, &vertexBufferID);
-    if (colorBufferID) glDeleteBuffers(1, &colorBufferID);
-    if (uvBufferID) glDeleteBuffers(1, &uvBufferID);
-    if (indexBufferID) glDeleteBuffers(1, &indexBufferID);
+    mesh.cleanup();
     if (programID) glDeleteProgram(programID);
+    programID = 0;
+    textureID = 0;   // Owned by the texture loader
 }
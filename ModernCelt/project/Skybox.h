@@ -4,7 +4,22 @@
 
 #include <glad/gl.h>
 
+#include "render/VertexFormat.h"
 
+// Interleaved skybox vertex; colour is kept for the shader's layout but unused
+struct SkyboxVertex {
+    glm::vec3 position;
+    glm::vec3 color;
+    glm::vec2 uv;
+};
+
+template <> struct VertexLayout<SkyboxVertex> {
+    static constexpr std::array<VertexAttribute, 3> attributes = {{
+        VERTEX_ATTRIBUTE(SkyboxVertex, position, 0),
+        VERTEX_ATTRIBUTE(SkyboxVertex, color, 1),
+        VERTEX_ATTRIBUTE(SkyboxVertex, uv, 2),
+    }};
+};
 
 class Skybox {
 
@@ -15,11 +30,7 @@ public:
 
     // OpenGL buffers
 
-    GLuint vertexArrayID;
-    GLuint vertexBufferID;
-    GLuint indexBufferID;
-    GLuint colorBufferID;
-    GLuint uvBufferID;
+    InterleavedMesh<SkyboxVertex> mesh;
     GLuint textureID;
 
     // Shader variable IDs
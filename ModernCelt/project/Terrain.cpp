@@ -1,21 +1,26 @@
 #include "Terrain.h"
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "../project/include/PerlinNoise.hpp"
+#include "render/GLState.h"
+#include "render/GpuProfiler.h"
+#include "render/MeshOptimizer.h"
+#include "core/CpuProfiler.h"
+#include "core/JobSystem.h"
 
-Terrain::Terrain(int w, int h, GLuint shader, glm::vec3 pos = glm::vec3(0.0f))
+Terrain::Terrain(int w, int h, GLuint shader, glm::vec3 pos, bool optimize)
     : width(w),
       height(h),
       position(pos),
-      VAO(0),
-      VBO(0),
-      EBO(0),
       textureID(0),
       modelMatrix(1.0f) {
     shaderProgram = shader;
-    perlin.reseed(1234); // Initialize Perlin noise generator
     generateTerrain();   // Create terrain vertices and indices
+    if (optimize) optimizeTiles();
     setupBuffers();      // Set up OpenGL buffers
 }
 
@@ -24,38 +29,15 @@ Terrain::~Terrain() {
 }
 
 float Terrain::getHeight(int x, int z) {
-    const double scale = 0.03;
-    const int octaves = 4;
-    const double persistence = 0.5;
-
-    double amplitude = 18.0;
-    double frequency = scale;
-    double height = 0.0;
-    double maxValue = 0.0;
-
-    for (int i = 0; i < octaves; i++) {
-        height += perlin.noise2D(x * frequency, z * frequency) * amplitude;
-        maxValue += amplitude;
-        amplitude *= persistence;
-        frequency *= 2.0;
-    }
-    return height * 12.0 / maxValue; // Scale height to match visual requirements
-}
-
-glm::vec3 Terrain::calculateNormal(int x, int z) {
-    glm::vec3 p0(x - 1, getHeight(x - 1, z), z);
-    glm::vec3 p1(x + 1, getHeight(x + 1, z), z);
-    glm::vec3 p2(x, getHeight(x, z - 1), z - 1);
-    glm::vec3 p3(x, getHeight(x, z + 1), z + 1);
-
-    glm::vec3 v1 = p1 - p0;
-    glm::vec3 v2 = p3 - p2;
-    return glm::normalize(glm::cross(v2, v1));
+    return heightfield.height(x, z);
 }
 
 void Terrain::setTexture(GLuint texID, GLuint samplerID) {
     textureID = texID;
     textureSamplerID = samplerID;
+
+    glState().useProgram(shaderProgram);
+    glUniform1i(textureSamplerID, 0);
 }
 
 void Terrain::updateTerrain(glm::vec3 cameraPos) {
@@ -65,81 +47,119 @@ void Terrain::updateTerrain(glm::vec3 cameraPos) {
     float deltaZ = cameraPos.z - offset.z;
 
     if (abs(deltaX) > threshold || abs(deltaZ) > threshold) {
-        offset.x += round(deltaX / width) * width;
-        offset.z += round(deltaZ / height) * height;
-
-        for (auto& vertex : vertices) {
-            vertex.position.x += round(deltaX / width) * width;
-            vertex.position.z += round(deltaZ / height) * height;
-            vertex.position.y = getHeight(vertex.position.x, vertex.position.z);
-            vertex.normal = calculateNormal(vertex.position.x, vertex.position.z);
-        }
-
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(Vertex), &vertices[0]);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        CPU_SCOPE("Terrain regenerate");
+        float shiftX = round(deltaX / width) * width;
+        float shiftZ = round(deltaZ / height) * height;
+        offset.x += shiftX;
+        offset.z += shiftZ;
+
+        // Every vertex is resampled independently; split them across the job system
+        jobSystem().parallelFor(0, static_cast<int>(vertices.size()), 4096, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                Vertex& vertex = vertices[i];
+                vertex.position.x += shiftX;
+                vertex.position.z += shiftZ;
+                int x = static_cast<int>(vertex.position.x);
+                int z = static_cast<int>(vertex.position.z);
+                vertex.position.y = heightfield.height(x, z);
+                vertex.normal = heightfield.normal(x, z);
+            }
+        });
+
+        mesh.updateVertices(vertices.data(), vertices.size());
+        computeBounds();
+        revision++;
     }
 }
 
 void Terrain::generateTerrain() {
-    vertices.clear();
+    vertices.resize(static_cast<size_t>(width) * height);
     indices.clear();
 
-    for (int z = 0; z < height; z++) {
-        for (int x = 0; x < width; x++) {
-            Vertex vertex;
-            float xPos = (float)x - width / 2.0f;
-            float zPos = (float)z - height / 2.0f;
-            float heightValue = getHeight(x, z);
-
-            vertex.position = glm::vec3(xPos, heightValue, zPos);
-            vertex.normal = calculateNormal(x, z);
-            vertex.texCoord = glm::vec2(x / (float)width * 20.0f, z / (float)height * 20.0f);
-            vertices.push_back(vertex);
+    // Rows are independent, so spread them across the job system
+    jobSystem().parallelFor(0, height, 16, [this](int rowBegin, int rowEnd) {
+        fillGridRows(heightfield, width, height, rowBegin, rowEnd, vertices.data());
+    });
+
+    // Emit the quads tile by tile so every tile is one range of the index buffer
+    tiles.clear();
+    for (int tileZ = 0; tileZ < height - 1; tileZ += TILE_QUADS) {
+        for (int tileX = 0; tileX < width - 1; tileX += TILE_QUADS) {
+            Tile tile;
+            tile.x0 = tileX;
+            tile.z0 = tileZ;
+            tile.x1 = std::min(tileX + TILE_QUADS, width - 1);
+            tile.z1 = std::min(tileZ + TILE_QUADS, height - 1);
+            tile.firstIndex = static_cast<GLsizei>(indices.size());
+
+            for (int z = tile.z0; z < tile.z1; z++) {
+                for (int x = tile.x0; x < tile.x1; x++) {
+                    unsigned int topLeft = z * width + x;
+                    unsigned int topRight = topLeft + 1;
+                    unsigned int bottomLeft = (z + 1) * width + x;
+                    unsigned int bottomRight = bottomLeft + 1;
+
+                    indices.push_back(topLeft);
+                    indices.push_back(bottomLeft);
+                    indices.push_back(topRight);
+
+                    indices.push_back(topRight);
+                    indices.push_back(bottomLeft);
+                    indices.push_back(bottomRight);
+                }
+            }
+            tile.indexCount = static_cast<GLsizei>(indices.size()) - tile.firstIndex;
+            tiles.push_back(tile);
         }
     }
 
-    for (int z = 0; z < height - 1; z++) {
-        for (int x = 0; x < width - 1; x++) {
-            unsigned int topLeft = z * width + x;
-            unsigned int topRight = topLeft + 1;
-            unsigned int bottomLeft = (z + 1) * width + x;
-            unsigned int bottomRight = bottomLeft + 1;
-
-            indices.push_back(topLeft);
-            indices.push_back(bottomLeft);
-            indices.push_back(topRight);
+    gridVertex.resize(vertices.size());
+    for (size_t i = 0; i < gridVertex.size(); ++i) gridVertex[i] = static_cast<unsigned int>(i);
+}
 
-            indices.push_back(topRight);
-            indices.push_back(bottomLeft);
-            indices.push_back(bottomRight);
+// Row-major quads reuse little of the post-transform cache, since a row of a tile is
+// longer than the cache. Each tile is reordered within its own range, so tiles still
+// cull and draw on their own; then vertices are renumbered in the order tiles fetch
+// them. A heightfield seen from above barely overdraws itself, so that pass is skipped.
+void Terrain::optimizeTiles() {
+    CPU_SCOPE("Terrain optimize");
+    VertexCacheStats before = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+    // Tiles are independent; each is optimized in its own vertex numbering
+    jobSystem().parallelFor(0, static_cast<int>(tiles.size()), 1, [this](int begin, int end) {
+        std::vector<uint32_t> local;
+        for (int t = begin; t < end; ++t) {
+            const Tile& tile = tiles[t];
+            int tileWidth = tile.x1 - tile.x0 + 1;
+            unsigned int* range = indices.data() + tile.firstIndex;
+            local.resize(tile.indexCount);
+            for (GLsizei i = 0; i < tile.indexCount; ++i) {
+                int x = range[i] % width, z = range[i] / width;
+                local[i] = (z - tile.z0) * tileWidth + (x - tile.x0);
+            }
+            optimizeVertexCache(local.data(), local.size(), static_cast<size_t>(tileWidth) * (tile.z1 - tile.z0 + 1));
+            for (GLsizei i = 0; i < tile.indexCount; ++i) {
+                int x = tile.x0 + local[i] % tileWidth, z = tile.z0 + local[i] / tileWidth;
+                range[i] = z * width + x;
+            }
         }
-    }
+    });
+
+    std::vector<uint32_t> remap;
+    optimizeVertexFetch(indices.data(), indices.size(), vertices.size(), remap);
+    remapVertices(vertices, remap);
+    gridVertex.assign(remap.begin(), remap.end());
+
+    VertexCacheStats after = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(3) << "Terrain optimized " << indices.size() / 3
+           << " triangles: ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr
+           << " -> " << after.atvr << " (" << VERTEX_CACHE_SIZE << "-entry FIFO)";
+    std::cout << report.str() << std::endl;
 }
 
 void Terrain::setupBuffers() {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
-    glEnableVertexAttribArray(2);
-
-    glBindVertexArray(0);
+    mesh.initialize(vertices.data(), vertices.size(), indices.data(), indices.size());
 
     modelMatrixID = glGetUniformLocation(shaderProgram, "model");
     lightPositionID = glGetUniformLocation(shaderProgram, "lightPosition");
@@ -147,20 +167,20 @@ void Terrain::setupBuffers() {
     mvpMatrixID = glGetUniformLocation(shaderProgram, "MVP");
     lightSpaceMatrixID = glGetUniformLocation(shaderProgram, "lightSpaceMatrix");
     shadowMapID = glGetUniformLocation(shaderProgram, "shadowMap");
-    depthModelID = glGetUniformLocation(shaderProgram, "model");
-    depthLightSpaceMatrixID = glGetUniformLocation(shaderProgram, "lightSpaceMatrix");
 
     modelMatrix = glm::translate(glm::mat4(1.0f), position);
+    computeBounds();
+
+    glState().useProgram(shaderProgram);
     glUniformMatrix4fv(modelMatrixID, 1, GL_FALSE, &modelMatrix[0][0]);
+    glUniform1i(shadowMapID, 1);
 }
 
-void Terrain::render(const glm::mat4& mvpMatrix, const glm::vec3& lightPos, const glm::vec3& lightInt, const glm::mat4& lightSpaceMatrix) {
-    glUseProgram(shaderProgram);
-    glBindVertexArray(VAO);
-
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
+void Terrain::render(const glm::mat4& mvpMatrix, const glm::vec3& lightPos, const glm::vec3& lightInt, const glm::mat4& lightSpaceMatrix,
+                     const int* visibleTiles, int visibleCount) {
+    GPU_SCOPE("Terrain");
+    glState().useProgram(shaderProgram);
+    mesh.bind();
 
     glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvpMatrix[0][0]);
     glUniformMatrix4fv(modelMatrixID, 1, GL_FALSE, &modelMatrix[0][0]);
@@ -168,46 +188,54 @@ void Terrain::render(const glm::mat4& mvpMatrix, const glm::vec3& lightPos, cons
     glUniform3fv(lightIntensityID, 1, &lightInt[0]);
     glUniformMatrix4fv(lightSpaceMatrixID, 1, GL_FALSE, glm::value_ptr(lightSpaceMatrix));
 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, shadowMapID);
-    glUniform1i(glGetUniformLocation(shaderProgram, "shadowMap"), 1);
+    glState().bindTexture(0, GL_TEXTURE_2D, textureID);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glUniform1i(textureSamplerID, 0);
+    drawTiles(visibleTiles, visibleCount);
+}
 
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+// Neighbouring tiles are neighbours in the index buffer too, so runs of
+// consecutive tiles go out as a single draw
+void Terrain::drawTiles(const int* visibleTiles, int visibleCount) {
+    for (int i = 0; i < visibleCount;) {
+        int first = visibleTiles[i];
+        int last = first;
+        for (++i; i < visibleCount && visibleTiles[i] == last + 1; ++i) last = visibleTiles[i];
+        GLsizei count = tiles[last].firstIndex + tiles[last].indexCount - tiles[first].firstIndex;
+        glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (void*)(tiles[first].firstIndex * sizeof(GLuint)));
+    }
+}
 
-    glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
-    glDisableVertexAttribArray(2);
-    glBindVertexArray(0);
+void Terrain::computeBounds() {
+    bounds = AABB();
+    for (Tile& tile : tiles) {
+        AABB tileBounds;
+        for (int z = tile.z0; z <= tile.z1; z++) {
+            for (int x = tile.x0; x <= tile.x1; x++) {
+                tileBounds.expand(vertices[gridVertex[z * width + x]].position);
+            }
+        }
+        tile.bounds = tileBounds.transformed(modelMatrix);
+        bounds.expand(tile.bounds);
+    }
 }
 
-void Terrain::renderDepth(const glm::mat4& lightSpaceMatrix) {
-    glBindVertexArray(VAO);
+void Terrain::setDepthProgram(GLuint program) {
+    depthProgramID = program;
+    depthModelID = glGetUniformLocation(program, "model");
+    depthLightSpaceMatrixID = glGetUniformLocation(program, "lightSpaceMatrix");
+}
 
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+void Terrain::renderDepth(const glm::mat4& lightSpaceMatrix, const int* visibleTiles, int visibleCount) {
+    GPU_SCOPE("Terrain");
+    glState().useProgram(depthProgramID);
+    mesh.bind();
 
     glUniformMatrix4fv(depthModelID, 1, GL_FALSE, glm::value_ptr(modelMatrix));
     glUniformMatrix4fv(depthLightSpaceMatrixID, 1, GL_FALSE, glm::value_ptr(lightSpaceMatrix));
 
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-
-    glDisableVertexAttribArray(0);
-    glBindVertexArray(0);
+    drawTiles(visibleTiles, visibleCount);
 }
 
 void Terrain::cleanup() {
-    if (VAO != 0) {
-        glDeleteVertexArrays(1, &VAO);
-    }
-    if (VBO != 0) {
-        glDeleteBuffers(1, &VBO);
-    }
-    if (EBO != 0) {
-        glDeleteBuffers(1, &EBO);
-    }
+    mesh.cleanup();
 }
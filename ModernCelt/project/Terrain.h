@@ -3,8 +3,12 @@
 #include <glad/gl.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
+#include <cstdint>
 #include <vector>
 #include "../project/include/PerlinNoise.hpp"
+#include "render/VertexFormat.h"
+#include "scene/Bounds.h"
+#include "scene/Heightfield.h"
 using namespace siv;
 
 struct Vertex {
@@ -13,27 +17,61 @@ struct Vertex {
     glm::vec2 texCoord;
 };
 
+template <> struct VertexLayout<Vertex> {
+    static constexpr std::array<VertexAttribute, 3> attributes = {{
+        VERTEX_ATTRIBUTE(Vertex, position, 0),
+        VERTEX_ATTRIBUTE(Vertex, normal, 1),
+        VERTEX_ATTRIBUTE(Vertex, texCoord, 2),
+    }};
+};
+
+// Height-mapped grid around the camera. The index buffer is laid out tile by tile,
+// so each tile is one contiguous range that can be culled and drawn on its own.
 class Terrain {
 public:
-    Terrain(int width, int height, GLuint shader, glm::vec3 pos);
+    static constexpr int TILE_QUADS = 64;   // Tile width and depth in grid cells
+
+    // optimize reorders each tile's triangles and the vertices for the GPU at load
+    Terrain(int width, int height, GLuint shader, glm::vec3 pos, bool optimize = true);
     ~Terrain();
 
-    void renderDepth(const glm::mat4& lightSpaceMatrix);
-    void render(const glm::mat4& mvpMatrix, const glm::vec3& lightPos, const glm::vec3& lightInt, const glm::mat4& lightSpaceMatrix = glm::mat4(1.0f));
+    // Draw the listed tiles; tiles holds tileCount indices in ascending order
+    void renderDepth(const glm::mat4& lightSpaceMatrix, const int* tiles, int tileCount);
+    void render(const glm::mat4& mvpMatrix, const glm::vec3& lightPos, const glm::vec3& lightInt, const glm::mat4& lightSpaceMatrix,
+                const int* tiles, int tileCount);
     void setTexture(GLuint texID, GLuint samplerID);
     void updateTerrain(glm::vec3 cameraPos);
     void cleanup();
     float getHeight(int x, int z);
 
+    // Program used by renderDepth(); shared by all shadow casters
+    void setDepthProgram(GLuint program);
+
+    // World-space bounds of the current terrain patch and of each of its tiles
+    const AABB& getBounds() const { return bounds; }
+    int tileCount() const { return static_cast<int>(tiles.size()); }
+    const AABB& tileBounds(int tile) const { return tiles[tile].bounds; }
+
+    // Incremented whenever the patch is regenerated around the camera
+    uint32_t getRevision() const { return revision; }
+
     glm::vec3 position = glm::vec3(0.0f);
     glm::vec3 offset = glm::vec3(0.0f);
 
 private:
+    struct Tile {
+        int x0, z0, x1, z1;     // Grid vertex range, inclusive
+        GLsizei firstIndex;
+        GLsizei indexCount;
+        AABB bounds;
+    };
+
     GLuint textureID;
     GLuint textureSamplerID;
-    siv::PerlinNoise perlin;
+    Heightfield heightfield;
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
+    std::vector<unsigned int> gridVertex;   // Vertex of each grid point, z * width + x
 
     GLuint modelMatrixID;
     GLuint lightPositionID;
@@ -42,19 +80,23 @@ private:
     GLuint mvpMatrixID;
     GLuint lightSpaceMatrixID;
     GLuint shadowMapID;
+    GLuint depthProgramID = 0;
     GLuint depthModelID;
     GLuint depthLightSpaceMatrixID;
 
     glm::mat4 modelMatrix;
 
-    unsigned int VAO;
-    unsigned int VBO;
-    unsigned int EBO;
+    InterleavedMesh<Vertex> mesh;
+    AABB bounds;
+    std::vector<Tile> tiles;
+    uint32_t revision = 0;
 
     int width;
     int height;
 
     void generateTerrain();
+    void optimizeTiles();
     void setupBuffers();
-    glm::vec3 calculateNormal(int x, int z);
+    void computeBounds();
+    void drawTiles(const int* tiles, int tileCount);
 };
@@ -0,0 +1,304 @@
+#include "AnimationClip.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Smallest-three components lie within +-1/sqrt(2)
+const float SMALLEST_THREE_RANGE = 0.70710678f;
+
+// Share of the tolerance reduction may use; sampling rounds differently from the
+// check, by about 1e-7 rad on rotations
+const float TOLERANCE_MARGIN = 0.999f;
+
+// Index of the last key at or before time, at most count - 2; times are ascending.
+// Branchless halving, as long tracks make the branches of a binary search a coin toss.
+int findKeyframe(const float* times, int count, float time) {
+    const float* base = times;
+    for (int n = count - 1; n > 1; ) {
+        int half = n / 2;
+        base = base[half] <= time ? base + half : base;
+        n -= half;
+    }
+    return static_cast<int>(base - times);
+}
+
+// The keys around time, which loops over the track's last keyframe time. Before
+// the first keyframe that key holds, as glTF specifies, instead of the last span
+// being extrapolated backwards. Most tracks end with the clip, so the clip wraps
+// time once and passes it as clipTime for those.
+void locate(const float* times, int count, float time, float length, float clipTime, int& key, int& next, float& factor) {
+    key = next = 0;
+    factor = 0.0f;
+    if (count < 2) return;
+    float end = times[count - 1];
+    float trackTime = end == length ? clipTime : end > 0.0f ? std::fmod(time, end) : 0.0f;
+    if (trackTime <= times[0]) return;
+    key = findKeyframe(times, count, trackTime);
+    next = key + 1;
+    factor = (trackTime - times[key]) / (times[next] - times[key]);
+}
+
+glm::quat toQuat(const glm::vec4& v) {
+    return glm::quat(v.w, v.x, v.y, v.z);
+}
+
+// Normalised lerp along the shorter arc; what compressed tracks interpolate with
+glm::quat nlerp(const glm::quat& a, glm::quat b, float t) {
+    if (glm::dot(a, b) < 0.0f) b = -b;
+    return glm::normalize(glm::quat(a.w + (b.w - a.w) * t, a.x + (b.x - a.x) * t,
+                                    a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t));
+}
+
+// atan2 of the relative rotation keeps precision near zero, where acos of the
+// dot product cannot resolve angles below about a milliradian
+float angleBetween(const glm::quat& a, const glm::quat& b) {
+    glm::quat relative = glm::conjugate(a) * b;
+    return 2.0f * std::atan2(glm::length(glm::vec3(relative.x, relative.y, relative.z)), std::abs(relative.w));
+}
+
+float tolerance(const AnimationTolerance& settings, TrackKind kind) {
+    switch (kind) {
+    case TrackKind::Translation: return settings.translation;
+    case TrackKind::Rotation: return settings.rotation;
+    case TrackKind::Scale: return settings.scale;
+    }
+    return 0.0f;
+}
+
+uint16_t quantize(float value, float low, float step) {
+    if (step <= 0.0f) return 0;
+    return static_cast<uint16_t>(std::clamp(std::lround((value - low) / step), 0L, 65535L));
+}
+
+// The fourth word passes through unscaled, so rotations get their dropped index back
+glm::vec4 dequantize(const uint16_t* key, const glm::vec3& scale, const glm::vec3& offset) {
+#ifdef MODERNCELT_SSE
+    __m128i words = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(key));
+    __m128 values = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, _mm_setzero_si128()));
+    __m128 scales = _mm_setr_ps(scale.x, scale.y, scale.z, 1.0f);
+    __m128 offsets = _mm_setr_ps(offset.x, offset.y, offset.z, 0.0f);
+    glm::vec4 result;
+    _mm_storeu_ps(&result[0], _mm_add_ps(_mm_mul_ps(values, scales), offsets));
+    return result;
+#else
+    return glm::vec4(glm::vec3(key[0], key[1], key[2]) * scale + offset, key[3]);
+#endif
+}
+
+// Rebuild the dropped component from the unit length
+glm::quat smallestThree(const glm::vec4& decoded) {
+    float a = decoded.x, b = decoded.y, c = decoded.z;
+    float dropped = std::sqrt(std::max(0.0f, 1.0f - a * a - b * b - c * c));
+    switch (static_cast<int>(decoded.w)) {
+    case 0: return glm::quat(c, dropped, a, b);
+    case 1: return glm::quat(c, a, dropped, b);
+    case 2: return glm::quat(c, a, b, dropped);
+    default: return glm::quat(dropped, a, b, c);
+    }
+}
+
+// Quantises one key into four words, smallest-three for rotations
+void encodeKey(const glm::vec4& value, const CompressedTrack& packed, uint16_t key[4]) {
+    key[3] = 0;
+    if (packed.kind == TrackKind::Rotation) {
+        // Drop the largest component, made positive so its sign need not be stored
+        glm::vec4 q = value / glm::length(value);
+        int largest = 0;
+        for (int c = 1; c < 4; ++c) {
+            if (std::abs(q[c]) > std::abs(q[largest])) largest = c;
+        }
+        if (q[largest] < 0.0f) q = -q;
+        for (int c = 0, w = 0; c < 4; ++c) {
+            if (c != largest) key[w++] = quantize(q[c], packed.offset.x, packed.scale.x);
+        }
+        key[3] = static_cast<uint16_t>(largest);
+    } else {
+        for (int c = 0; c < 3; ++c) key[c] = quantize(value[c], packed.offset[c], packed.scale[c]);
+    }
+}
+
+// What sampling reads back for a key, laid out like the raw values
+glm::vec4 decodeKey(const uint16_t* key, const CompressedTrack& packed) {
+    glm::vec4 decoded = dequantize(key, packed.scale, packed.offset);
+    if (packed.kind != TrackKind::Rotation) return glm::vec4(glm::vec3(decoded), 0.0f);
+    glm::quat q = smallestThree(decoded);
+    return glm::vec4(q.x, q.y, q.z, q.w);
+}
+
+// Error of reconstructing the raw curve from the decoded keys a and b, at key i and
+// halfway back to key i - 1; nlerp over a long span drifts most between the raw keys.
+// Measuring the decoded keys keeps the quantisation error inside the tolerance too.
+float keyError(const RawTrack& track, const std::vector<glm::vec4>& decoded, int a, int b, int i) {
+    float error = 0.0f;
+    for (float back : { 0.0f, 0.5f }) {
+        float time = track.times[i] + back * (track.times[i - 1] - track.times[i]);
+        float t = (time - track.times[a]) / (track.times[b] - track.times[a]);
+        if (track.kind == TrackKind::Rotation) {
+            glm::quat expected = glm::slerp(toQuat(track.values[i]), toQuat(track.values[i - 1]), back);
+            glm::quat value = nlerp(toQuat(decoded[a]), toQuat(decoded[b]), t);
+            error = std::max(error, angleBetween(value, glm::normalize(expected)));
+        } else {
+            glm::vec3 expected = glm::mix(glm::vec3(track.values[i]), glm::vec3(track.values[i - 1]), back);
+            glm::vec3 value = glm::mix(glm::vec3(decoded[a]), glm::vec3(decoded[b]), t);
+            error = std::max(error, glm::length(value - expected));
+        }
+    }
+    return error;
+}
+
+// Greedy reduction: extend each span until an interior key no longer fits
+std::vector<int> reduceKeys(const RawTrack& track, const std::vector<glm::vec4>& decoded, float tolerance) {
+    int count = static_cast<int>(track.times.size());
+    std::vector<int> kept(1, 0);
+    if (count == 1) return kept;
+
+    // A track that never leaves its first decoded value within tolerance needs one key
+    bool constant = true;
+    for (int i = 0; i < count && constant; ++i) {
+        float error = track.kind == TrackKind::Rotation
+                    ? angleBetween(toQuat(decoded[0]), glm::normalize(toQuat(track.values[i])))
+                    : glm::length(glm::vec3(track.values[i]) - glm::vec3(decoded[0]));
+        constant = error <= tolerance;
+    }
+    if (constant) return kept;
+
+    int start = 0;
+    for (int end = 2; end < count; ++end) {
+        bool fits = true;
+        for (int i = start + 1; i <= end && fits; ++i) fits = keyError(track, decoded, start, end, i) <= tolerance;
+        if (!fits) {
+            start = end - 1;
+            kept.push_back(start);
+        }
+    }
+    kept.push_back(count - 1);
+    return kept;
+}
+
+// Whether every key is within tolerance of the rest pose value
+bool matchesRest(const RawTrack& track, const LocalPose& rest, float tolerance) {
+    if (track.joint >= rest.jointCount) return false;
+    for (const glm::vec4& value : track.values) {
+        float error = 0.0f;
+        switch (track.kind) {
+        case TrackKind::Translation: error = glm::length(glm::vec3(value) - rest.translation(track.joint)); break;
+        case TrackKind::Rotation: error = angleBetween(glm::normalize(toQuat(value)), glm::normalize(rest.rotation(track.joint))); break;
+        case TrackKind::Scale: error = glm::length(glm::vec3(value) - rest.scale(track.joint)); break;
+        }
+        if (error > tolerance) return false;
+    }
+    return true;
+}
+
+// Quantises and reduces one track, appending its keys to times and words. The
+// quantisation range covers every key, so it is fixed before reduction measures
+// against the decoded keys.
+CompressedTrack compressTrack(const RawTrack& track, float tolerance, std::vector<float>& times, std::vector<uint16_t>& words) {
+    CompressedTrack packed;
+    packed.joint = static_cast<uint16_t>(track.joint);
+    packed.kind = track.kind;
+    if (track.kind == TrackKind::Rotation) {
+        packed.scale = glm::vec3(2.0f * SMALLEST_THREE_RANGE / 65535.0f);
+        packed.offset = glm::vec3(-SMALLEST_THREE_RANGE);
+    } else {
+        glm::vec3 low(track.values[0]), high(track.values[0]);
+        for (const glm::vec4& value : track.values) {
+            low = glm::min(low, glm::vec3(value));
+            high = glm::max(high, glm::vec3(value));
+        }
+        packed.scale = (high - low) / 65535.0f;
+        packed.offset = low;
+    }
+
+    size_t count = track.values.size();
+    std::vector<uint16_t> encoded(4 * count);
+    std::vector<glm::vec4> decoded(count);
+    for (size_t i = 0; i < count; ++i) {
+        encodeKey(track.values[i], packed, &encoded[4 * i]);
+        decoded[i] = decodeKey(&encoded[4 * i], packed);
+    }
+
+    std::vector<int> kept = reduceKeys(track, decoded, tolerance * TOLERANCE_MARGIN);
+    packed.firstKey = static_cast<uint32_t>(times.size());
+    packed.keyCount = static_cast<uint32_t>(kept.size());
+    for (int k : kept) {
+        times.push_back(track.times[k]);
+        words.insert(words.end(), encoded.begin() + 4 * k, encoded.begin() + 4 * k + 4);
+    }
+    return packed;
+}
+
+void apply(LocalPose& pose, int joint, TrackKind kind, const glm::vec3& value) {
+    if (kind == TrackKind::Translation) pose.setTranslation(joint, value);
+    else pose.setScale(joint, value);
+}
+
+} // namespace
+
+void AnimationClip::addTrack(RawTrack track) {
+    if (track.times.empty()) return;
+    length = std::max(length, track.times.back());
+    raw.push_back(std::move(track));
+}
+
+void AnimationClip::compress(const AnimationTolerance& settings, const Skeleton& skeleton) {
+    LocalPose rest = skeleton.restPose();
+    packed.clear();
+    keyTimes.clear();
+    keyWords.clear();
+    for (const RawTrack& track : raw) {
+        float limit = tolerance(settings, track.kind);
+        if (matchesRest(track, rest, limit)) continue;
+        packed.push_back(compressTrack(track, limit, keyTimes, keyWords));
+    }
+    raw.clear();
+    raw.shrink_to_fit();
+    isCompressed = true;
+}
+
+void AnimationClip::sample(float time, LocalPose& pose) const {
+    float clipTime = length > 0.0f ? std::fmod(time, length) : 0.0f;
+    for (const RawTrack& track : raw) {
+        int key, next;
+        float factor;
+        locate(track.times.data(), static_cast<int>(track.times.size()), time, length, clipTime, key, next, factor);
+
+        if (track.kind == TrackKind::Rotation) {
+            pose.setRotation(track.joint, glm::slerp(toQuat(track.values[key]), toQuat(track.values[next]), factor));
+        } else {
+            apply(pose, track.joint, track.kind, glm::mix(glm::vec3(track.values[key]), glm::vec3(track.values[next]), factor));
+        }
+    }
+
+    for (const CompressedTrack& track : packed) {
+        int key, next;
+        float factor;
+        locate(keyTimes.data() + track.firstKey, static_cast<int>(track.keyCount), time, length, clipTime, key, next, factor);
+
+        const uint16_t* words = keyWords.data() + 4 * size_t(track.firstKey);
+        glm::vec4 a = dequantize(words + 4 * key, track.scale, track.offset);
+        glm::vec4 b = dequantize(words + 4 * next, track.scale, track.offset);
+        if (track.kind == TrackKind::Rotation) {
+            pose.setRotation(track.joint, nlerp(smallestThree(a), smallestThree(b), factor));
+        } else {
+            apply(pose, track.joint, track.kind, glm::vec3(a + (b - a) * factor));
+        }
+    }
+}
+
+size_t AnimationClip::byteSize() const {
+    size_t bytes = sizeof(*this);
+    for (const RawTrack& track : raw) {
+        bytes += sizeof(track) + track.times.size() * sizeof(float) + track.values.size() * sizeof(glm::vec4);
+    }
+    bytes += packed.size() * sizeof(CompressedTrack) + keyTimes.size() * sizeof(float) + keyWords.size() * sizeof(uint16_t);
+    return bytes;
+}
+
+int AnimationClip::keyCount() const {
+    size_t keys = 0;
+    for (const RawTrack& track : raw) keys += track.times.size();
+    keys += keyTimes.size();
+    return static_cast<int>(keys);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "anim/Skeleton.h"
+
+enum class TrackKind : uint8_t { Translation, Rotation, Scale };
+
+// Keyframes as loaded, interpolated linearly (slerp for rotations)
+struct RawTrack {
+    int joint;
+    TrackKind kind;
+    std::vector<float> times;
+    std::vector<glm::vec4> values;   // xyz, or a quaternion as xyzw
+};
+
+// The keyframes that survived reduction, as a range of the clip's key arrays.
+// Each key is four 16-bit words, so it is one 64-bit load and dequantising is a
+// convert and a multiply-add. Translation and scale keys map xyz into the track's
+// range; rotation keys store the smallest three quaternion components and, in the
+// fourth word, which one was dropped.
+struct CompressedTrack {
+    uint16_t joint;
+    TrackKind kind;
+    uint32_t firstKey;
+    uint32_t keyCount;
+    glm::vec3 scale;    // Dequantised value = word * scale + offset
+    glm::vec3 offset;
+};
+
+// Largest reconstruction error of a compressed clip, quantisation included
+struct AnimationTolerance {
+    float translation = 0.01f;   // Asset units
+    float rotation = 0.0005f;    // Radians
+    float scale = 0.0001f;
+};
+
+// The tracks of one animation, raw or compressed. Sampling writes only the
+// components the clip animates, so the pose must start from the rest pose.
+class AnimationClip {
+public:
+    void addTrack(RawTrack track);
+
+    // Replaces the raw tracks by reduced, quantised ones. Tracks that stay within
+    // tolerance of the skeleton's rest pose are dropped, as sampling starts from it.
+    void compress(const AnimationTolerance& tolerance, const Skeleton& skeleton);
+    bool compressed() const { return isCompressed; }
+
+    void sample(float time, LocalPose& pose) const;
+
+    float duration() const { return length; }
+    size_t byteSize() const;
+    int keyCount() const;
+
+private:
+    float length = 0.0f;
+    bool isCompressed = false;
+    std::vector<RawTrack> raw;
+    std::vector<CompressedTrack> packed;
+    std::vector<float> keyTimes;
+    std::vector<uint16_t> keyWords;   // 4 per key
+};
@@ -0,0 +1,37 @@
+#include "AnimationPlayer.h"
+#include <algorithm>
+
+void AnimationPlayer::play(int clip, float now, float fadeSeconds, float offset) {
+    if (count == MAX_LAYERS) {
+        std::copy(layers + 1, layers + count, layers);
+        --count;
+    }
+    // The bottom layer has nothing to fade over
+    float fade = count == 0 ? 0.0f : std::max(fadeSeconds, 0.0f);
+    layers[count++] = Layer{ clip, now, offset, fade };
+}
+
+float AnimationPlayer::opacity(int i, float now) const {
+    if (i == 0 || layers[i].fade <= 0.0f) return 1.0f;
+    return std::min(std::max((now - layers[i].start) / layers[i].fade, 0.0f), 1.0f);
+}
+
+void AnimationPlayer::update(float now) {
+    // The topmost opaque layer becomes the bottom one
+    for (int i = count - 1; i > 0; --i) {
+        if (opacity(i, now) < 1.0f) continue;
+        std::copy(layers + i, layers + count, layers);
+        count -= i;
+        layers[0].fade = 0.0f;
+        break;
+    }
+}
+
+void AnimationPlayer::weights(float now, float* out) const {
+    // Each layer covers its share of whatever the layers above left uncovered
+    float remaining = 1.0f;
+    for (int i = count - 1; i >= 0; --i) {
+        out[i] = remaining * opacity(i, now);
+        remaining -= out[i];
+    }
+}
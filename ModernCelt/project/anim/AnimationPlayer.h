@@ -0,0 +1,39 @@
+#pragma once
+
+// Per-instance playback: a stack of clips, each fading in over the ones below it.
+// play() pushes a clip; once it has fully faded in, the layers beneath no longer
+// contribute and are dropped. Layer times are absolute, so the weights at any
+// moment follow from the stack alone and repeat exactly. Fixed size, no heap.
+class AnimationPlayer {
+public:
+    static const int MAX_LAYERS = 4;
+
+    struct Layer {
+        int clip;
+        float start;    // Time the layer began
+        float offset;   // Clip time at start
+        float fade;     // Seconds to reach full weight over the layers below
+    };
+
+    // Crossfades from whatever is playing to clip, which plays from offset on; a
+    // full stack drops its bottom layer
+    void play(int clip, float now, float fadeSeconds, float offset = 0.0f);
+
+    // Drops the layers hidden under one that has fully faded in
+    void update(float now);
+
+    int layerCount() const { return count; }
+    const Layer& layer(int i) const { return layers[i]; }
+    // The clip faded in last, or -1 before play()
+    int currentClip() const { return count ? layers[count - 1].clip : -1; }
+    float clipTime(int i, float now) const { return layers[i].offset + now - layers[i].start; }
+
+    // Blend weight of every layer at now, bottom first; they sum to one
+    void weights(float now, float* out) const;
+
+private:
+    Layer layers[MAX_LAYERS];
+    int count = 0;
+
+    float opacity(int i, float now) const;
+};
@@ -0,0 +1,66 @@
+#include "PoseCache.h"
+#include <cmath>
+#include <thread>
+
+PoseCache& poseCache() {
+    static PoseCache cache;
+    return cache;
+}
+
+void PoseCache::initialize(const Config& config) {
+    settings = config;
+    entries = std::vector<Entry>(settings.maxPoses);
+    storage.assign(settings.maxJoints, glm::mat4(1.0f));
+    used = 0;
+    jointsUsed = 0;
+}
+
+void PoseCache::beginFrame() {
+    std::lock_guard<std::mutex> lock(mutex);
+    used = 0;
+    jointsUsed = 0;
+    lastRequests.store(requests.exchange(0));
+    lastEvaluations.store(evaluations.exchange(0));
+}
+
+PoseCache::Key PoseCache::makeKey(uint64_t skeleton, int clip, float time) const {
+    Key key;
+    key.skeleton = skeleton;
+    key.clip = clip;
+    key.step = static_cast<int32_t>(std::lround(time / settings.timeStep));
+    return key;
+}
+
+PoseCache::Entry* PoseCache::acquire(const Key& key, int jointCount, bool& claimed) {
+    if (!settings.enabled) return nullptr;
+    requests.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // A tick holds a handful of distinct poses, so a linear search beats hashing
+    for (int i = 0; i < used; ++i) {
+        if (entries[i].key == key && entries[i].jointCount == jointCount) return &entries[i];
+    }
+    if (used == settings.maxPoses || jointsUsed + jointCount > settings.maxJoints) return nullptr;
+
+    Entry& entry = entries[used++];
+    entry.key = key;
+    entry.jointCount = jointCount;
+    entry.palette = storage.data() + jointsUsed;
+    entry.ready.store(false, std::memory_order_relaxed);
+    jointsUsed += jointCount;
+    evaluations.fetch_add(1, std::memory_order_relaxed);
+    claimed = true;
+    return &entry;
+}
+
+void PoseCache::waitFor(const Entry& entry) const {
+    // The claiming thread is already evaluating, which takes microseconds
+    while (!entry.ready.load(std::memory_order_acquire)) std::this_thread::yield();
+}
+
+PoseCache::Stats PoseCache::stats() const {
+    Stats result;
+    result.requests = lastRequests.load();
+    result.evaluations = lastEvaluations.load();
+    return result;
+}
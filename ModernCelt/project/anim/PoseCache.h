@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Skinning palettes evaluated during one simulation tick, keyed by (skeleton, clip,
+// quantised time). The first instance to ask for a key evaluates it; every other
+// instance asking for the same key in that tick gets the same palette, so a crowd
+// playing one clip in step costs one evaluation per distinct pose rather than one
+// per instance. Callers may run on any thread; one asking for a key that is still
+// being evaluated waits for it.
+//
+// Storage is allocated up front. When it runs out, or the cache is disabled,
+// palette() returns nullptr and the caller evaluates into its own buffer.
+class PoseCache {
+public:
+    struct Config {
+        bool enabled = true;
+        float timeStep = 1.0f / 240.0f;   // Times within one step share a pose
+        int maxPoses = 64;                // Distinct poses per tick
+        int maxJoints = 4096;             // Palette matrices per tick, over all poses
+    };
+
+    struct Key {
+        uint64_t skeleton;   // Identifies the skeleton, skin and clip data
+        int clip;
+        int32_t step;        // Time in timeSteps
+        bool operator==(const Key& other) const { return skeleton == other.skeleton && clip == other.clip && step == other.step; }
+    };
+
+    struct Stats {
+        int requests = 0;      // palette() calls in the last tick
+        int evaluations = 0;   // Of those, the ones that evaluated a pose
+    };
+
+    void initialize(const Config& config);
+    bool enabled() const { return settings.enabled; }
+
+    // Simulation thread, before the tick's updates; drops the last tick's palettes
+    void beginFrame();
+
+    Key makeKey(uint64_t skeleton, int clip, float time) const;
+    // The time a key's pose is evaluated at, whichever instance evaluates it
+    float keyTime(const Key& key) const { return key.step * settings.timeStep; }
+
+    // Shared palette of jointCount matrices for key, calling evaluate(palette) to fill
+    // it when no instance has yet this tick. Valid until the next beginFrame().
+    template <typename Evaluate>
+    const glm::mat4* palette(const Key& key, int jointCount, Evaluate evaluate) {
+        bool claimed = false;
+        Entry* entry = acquire(key, jointCount, claimed);
+        if (!entry) return nullptr;
+        if (claimed) {
+            evaluate(entry->palette);
+            entry->ready.store(true, std::memory_order_release);
+        } else {
+            waitFor(*entry);
+        }
+        return entry->palette;
+    }
+
+    Stats stats() const;
+
+private:
+    struct Entry {
+        Key key;
+        glm::mat4* palette = nullptr;
+        int jointCount = 0;
+        std::atomic<bool> ready{ false };
+    };
+
+    Config settings;
+    std::mutex mutex;
+    std::vector<Entry> entries;          // The first used are this tick's
+    std::vector<glm::mat4> storage;
+    int used = 0;
+    int jointsUsed = 0;
+    std::atomic<int> requests{ 0 };
+    std::atomic<int> evaluations{ 0 };
+    std::atomic<int> lastRequests{ 0 };
+    std::atomic<int> lastEvaluations{ 0 };
+
+    Entry* acquire(const Key& key, int jointCount, bool& claimed);
+    void waitFor(const Entry& entry) const;
+};
+
+PoseCache& poseCache();
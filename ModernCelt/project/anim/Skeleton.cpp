@@ -0,0 +1,248 @@
+#include "Skeleton.h"
+#include "core/FrameArena.h"
+#include <cstring>
+
+namespace {
+
+// out = a * b; out must not alias a or b
+inline void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+#ifdef MODERNCELT_SSE
+    // Each column of the product mixes a's columns by one column of b
+    __m128 a0 = _mm_loadu_ps(&a[0][0]), a1 = _mm_loadu_ps(&a[1][0]);
+    __m128 a2 = _mm_loadu_ps(&a[2][0]), a3 = _mm_loadu_ps(&a[3][0]);
+    for (int c = 0; c < 4; ++c) {
+        __m128 column = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b[c][0])), _mm_mul_ps(a1, _mm_set1_ps(b[c][1]))),
+                                   _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(b[c][2])), _mm_mul_ps(a3, _mm_set1_ps(b[c][3]))));
+        _mm_storeu_ps(&out[c][0], column);
+    }
+#else
+    out = a * b;
+#endif
+}
+
+// Column-major T * R * S from one joint's components, as glm::mat4_cast lays out R
+void composeScalar(float tx, float ty, float tz, float qx, float qy, float qz, float qw,
+                   float sx, float sy, float sz, glm::mat4& m) {
+    float xx = qx * qx, yy = qy * qy, zz = qz * qz;
+    float xy = qx * qy, xz = qx * qz, yz = qy * qz;
+    float wx = qw * qx, wy = qw * qy, wz = qw * qz;
+    m[0] = glm::vec4((1.0f - 2.0f * (yy + zz)) * sx, 2.0f * (xy + wz) * sx, 2.0f * (xz - wy) * sx, 0.0f);
+    m[1] = glm::vec4(2.0f * (xy - wz) * sy, (1.0f - 2.0f * (xx + zz)) * sy, 2.0f * (yz + wx) * sy, 0.0f);
+    m[2] = glm::vec4(2.0f * (xz + wy) * sz, 2.0f * (yz - wx) * sz, (1.0f - 2.0f * (xx + yy)) * sz, 0.0f);
+    m[3] = glm::vec4(tx, ty, tz, 1.0f);
+}
+
+} // namespace
+
+void LocalPose::setTranslation(int joint, const glm::vec3& t) {
+    stream(TX)[joint] = t.x;
+    stream(TY)[joint] = t.y;
+    stream(TZ)[joint] = t.z;
+}
+
+void LocalPose::setRotation(int joint, const glm::quat& q) {
+    stream(QX)[joint] = q.x;
+    stream(QY)[joint] = q.y;
+    stream(QZ)[joint] = q.z;
+    stream(QW)[joint] = q.w;
+}
+
+void LocalPose::setScale(int joint, const glm::vec3& s) {
+    stream(SX)[joint] = s.x;
+    stream(SY)[joint] = s.y;
+    stream(SZ)[joint] = s.z;
+}
+
+glm::vec3 LocalPose::translation(int joint) const {
+    return glm::vec3(stream(TX)[joint], stream(TY)[joint], stream(TZ)[joint]);
+}
+
+glm::quat LocalPose::rotation(int joint) const {
+    return glm::quat(stream(QW)[joint], stream(QX)[joint], stream(QY)[joint], stream(QZ)[joint]);
+}
+
+glm::vec3 LocalPose::scale(int joint) const {
+    return glm::vec3(stream(SX)[joint], stream(SY)[joint], stream(SZ)[joint]);
+}
+
+LocalPose allocatePose(FrameArena& arena, int jointCount) {
+    LocalPose pose;
+    pose.jointCount = jointCount;
+    pose.stride = (jointCount + 3) & ~3;
+    pose.data = static_cast<float*>(arena.allocate(sizeof(float) * LocalPose::STREAM_COUNT * pose.stride, 16));
+    return pose;
+}
+
+int Skeleton::addJoint(int parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale) {
+    int joint = jointCount();
+    int oldStride = stride();
+    parents.push_back(parent);
+
+    // Re-pad the streams whenever the joint count passes a multiple of four; padding
+    // holds identity transforms so the kernels can run over it harmlessly
+    if (stride() != oldStride) {
+        static const float identity[LocalPose::STREAM_COUNT] = { 0, 0, 0, 0, 0, 0, 1, 1, 1, 1 };
+        std::vector<float> grown(LocalPose::STREAM_COUNT * stride());
+        for (int s = 0; s < LocalPose::STREAM_COUNT; ++s) {
+            for (int i = 0; i < stride(); ++i) {
+                grown[s * stride() + i] = i < joint ? rest[s * oldStride + i] : identity[s];
+            }
+        }
+        rest.swap(grown);
+    }
+
+    LocalPose pose;
+    pose.data = rest.data();
+    pose.jointCount = jointCount();
+    pose.stride = stride();
+    pose.setTranslation(joint, translation);
+    pose.setRotation(joint, rotation);
+    pose.setScale(joint, scale);
+    return joint;
+}
+
+void Skeleton::copyRestPose(LocalPose& pose) const {
+    memcpy(pose.data, rest.data(), rest.size() * sizeof(float));
+}
+
+LocalPose Skeleton::restPose() const {
+    LocalPose pose;
+    pose.data = const_cast<float*>(rest.data());
+    pose.jointCount = jointCount();
+    pose.stride = stride();
+    return pose;
+}
+
+void localMatrices(const LocalPose& pose, glm::mat4* local) {
+#ifdef MODERNCELT_SSE
+    const float* t[3] = { pose.stream(LocalPose::TX), pose.stream(LocalPose::TY), pose.stream(LocalPose::TZ) };
+    const float* q[4] = { pose.stream(LocalPose::QX), pose.stream(LocalPose::QY), pose.stream(LocalPose::QZ), pose.stream(LocalPose::QW) };
+    const float* s[3] = { pose.stream(LocalPose::SX), pose.stream(LocalPose::SY), pose.stream(LocalPose::SZ) };
+    __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), zero = _mm_setzero_ps();
+
+    for (int i = 0; i < pose.jointCount; i += 4) {
+        // Lane k of every register belongs to joint i + k
+        __m128 qx = _mm_load_ps(q[0] + i), qy = _mm_load_ps(q[1] + i), qz = _mm_load_ps(q[2] + i), qw = _mm_load_ps(q[3] + i);
+        __m128 sx = _mm_load_ps(s[0] + i), sy = _mm_load_ps(s[1] + i), sz = _mm_load_ps(s[2] + i);
+        __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+        __m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+        __m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+        __m128 columns[4][4] = {
+            { _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+              _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+              _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx), zero },
+            { _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+              _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+              _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy), zero },
+            { _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+              _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+              _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz), zero },
+            { _mm_load_ps(t[0] + i), _mm_load_ps(t[1] + i), _mm_load_ps(t[2] + i), one },
+        };
+
+        // Transpose each column group so one register holds one joint's column
+        glm::mat4 block[4];
+        for (int c = 0; c < 4; ++c) {
+            _MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+            for (int k = 0; k < 4; ++k) _mm_storeu_ps(&block[k][c][0], columns[c][k]);
+        }
+        int count = pose.jointCount - i < 4 ? pose.jointCount - i : 4;
+        memcpy(local + i, block, count * sizeof(glm::mat4));
+    }
+#else
+    localMatricesScalar(pose, local);
+#endif
+}
+
+void localMatricesScalar(const LocalPose& pose, glm::mat4* local) {
+    for (int i = 0; i < pose.jointCount; ++i) {
+        composeScalar(pose.stream(LocalPose::TX)[i], pose.stream(LocalPose::TY)[i], pose.stream(LocalPose::TZ)[i],
+                      pose.stream(LocalPose::QX)[i], pose.stream(LocalPose::QY)[i], pose.stream(LocalPose::QZ)[i],
+                      pose.stream(LocalPose::QW)[i], pose.stream(LocalPose::SX)[i], pose.stream(LocalPose::SY)[i],
+                      pose.stream(LocalPose::SZ)[i], local[i]);
+    }
+}
+
+void modelMatrices(const Skeleton& skeleton, const glm::mat4* local, glm::mat4* model) {
+    // Parents come first, so theirs are always ready
+    const int* parents = skeleton.parents.data();
+    for (int i = 0; i < skeleton.jointCount(); ++i) {
+        if (parents[i] < 0) model[i] = local[i];
+        else multiply(model[parents[i]], local[i], model[i]);
+    }
+}
+
+void clearPose(LocalPose& sum) {
+    memset(sum.data, 0, sizeof(float) * LocalPose::STREAM_COUNT * sum.stride);
+}
+
+void accumulatePose(const LocalPose& layer, float weight, LocalPose& sum) {
+    const float* in[LocalPose::STREAM_COUNT];
+    float* out[LocalPose::STREAM_COUNT];
+    for (int s = 0; s < LocalPose::STREAM_COUNT; ++s) {
+        in[s] = layer.stream(s);
+        out[s] = sum.stream(s);
+    }
+#ifdef MODERNCELT_SSE
+    __m128 w = _mm_set1_ps(weight);
+    __m128 signBit = _mm_set1_ps(-0.0f);
+    for (int i = 0; i < sum.stride; i += 4) {
+        // Negate the weight in lanes whose rotation points away from the sum's
+        __m128 dot = _mm_setzero_ps();
+        for (int s = LocalPose::QX; s <= LocalPose::QW; ++s) {
+            dot = _mm_add_ps(dot, _mm_mul_ps(_mm_load_ps(in[s] + i), _mm_load_ps(out[s] + i)));
+        }
+        __m128 flipped = _mm_xor_ps(w, _mm_and_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()), signBit));
+        for (int s = LocalPose::TX; s <= LocalPose::TZ; ++s) {
+            _mm_store_ps(out[s] + i, _mm_add_ps(_mm_load_ps(out[s] + i), _mm_mul_ps(_mm_load_ps(in[s] + i), w)));
+        }
+        for (int s = LocalPose::QX; s <= LocalPose::QW; ++s) {
+            _mm_store_ps(out[s] + i, _mm_add_ps(_mm_load_ps(out[s] + i), _mm_mul_ps(_mm_load_ps(in[s] + i), flipped)));
+        }
+        for (int s = LocalPose::SX; s <= LocalPose::SZ; ++s) {
+            _mm_store_ps(out[s] + i, _mm_add_ps(_mm_load_ps(out[s] + i), _mm_mul_ps(_mm_load_ps(in[s] + i), w)));
+        }
+    }
+#else
+    for (int i = 0; i < sum.jointCount; ++i) {
+        float dot = 0.0f;
+        for (int s = LocalPose::QX; s <= LocalPose::QW; ++s) dot += in[s][i] * out[s][i];
+        float flipped = dot < 0.0f ? -weight : weight;
+        for (int s = 0; s < LocalPose::STREAM_COUNT; ++s) {
+            out[s][i] += in[s][i] * (s >= LocalPose::QX && s <= LocalPose::QW ? flipped : weight);
+        }
+    }
+#endif
+}
+
+void normalizePose(LocalPose& sum, float totalWeight) {
+    float inverse = totalWeight > 0.0f ? 1.0f / totalWeight : 0.0f;
+    float* out[LocalPose::STREAM_COUNT];
+    for (int s = 0; s < LocalPose::STREAM_COUNT; ++s) out[s] = sum.stream(s);
+#ifdef MODERNCELT_SSE
+    __m128 scale = _mm_set1_ps(inverse);
+    __m128 tiny = _mm_set1_ps(1e-12f);
+    for (int i = 0; i < sum.stride; i += 4) {
+        for (int s = LocalPose::TX; s <= LocalPose::TZ; ++s) _mm_store_ps(out[s] + i, _mm_mul_ps(_mm_load_ps(out[s] + i), scale));
+        for (int s = LocalPose::SX; s <= LocalPose::SZ; ++s) _mm_store_ps(out[s] + i, _mm_mul_ps(_mm_load_ps(out[s] + i), scale));
+        __m128 length = _mm_setzero_ps();
+        for (int s = LocalPose::QX; s <= LocalPose::QW; ++s) {
+            __m128 q = _mm_load_ps(out[s] + i);
+            length = _mm_add_ps(length, _mm_mul_ps(q, q));
+        }
+        __m128 inverseLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_max_ps(length, tiny)));
+        for (int s = LocalPose::QX; s <= LocalPose::QW; ++s) _mm_store_ps(out[s] + i, _mm_mul_ps(_mm_load_ps(out[s] + i), inverseLength));
+    }
+#else
+    for (int i = 0; i < sum.jointCount; ++i) {
+        for (int s = LocalPose::TX; s <= LocalPose::TZ; ++s) out[s][i] *= inverse;
+        for (int s = LocalPose::SX; s <= LocalPose::SZ; ++s) out[s][i] *= inverse;
+        sum.setRotation(i, glm::normalize(sum.rotation(i)));
+    }
+#endif
+}
+
+void skinningPalette(const glm::mat4* model, const int* joints, const glm::mat4* inverseBind, int count, glm::mat4* palette) {
+    for (int i = 0; i < count; ++i) multiply(model[joints[i]], inverseBind[i], palette[i]);
+}
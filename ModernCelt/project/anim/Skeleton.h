@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+#include "core/Simd.h"
+
+class FrameArena;
+
+// Joint-local transforms in structure-of-arrays form: ten float streams
+// (translation xyz, rotation xyzw, scale xyz), each padded to a multiple of four
+// joints, so the SSE kernel builds the matrices of four joints per step.
+struct LocalPose {
+    enum Stream { TX, TY, TZ, QX, QY, QZ, QW, SX, SY, SZ, STREAM_COUNT };
+
+    float* data = nullptr;
+    int jointCount = 0;
+    int stride = 0;   // Floats per stream
+
+    float* stream(int s) const { return data + s * stride; }
+
+    void setTranslation(int joint, const glm::vec3& t);
+    void setRotation(int joint, const glm::quat& q);
+    void setScale(int joint, const glm::vec3& s);
+    glm::vec3 translation(int joint) const;
+    glm::quat rotation(int joint) const;
+    glm::vec3 scale(int joint) const;
+};
+
+// Uninitialised pose for jointCount joints, valid until the arena rewinds
+LocalPose allocatePose(FrameArena& arena, int jointCount);
+
+// Joint hierarchy sorted so every parent precedes its children; model-space
+// transforms are then one forward pass over the parent indices.
+struct Skeleton {
+    std::vector<int> parents;   // -1 for roots
+    std::vector<float> rest;    // Rest pose, laid out like LocalPose::data
+
+    int jointCount() const { return static_cast<int>(parents.size()); }
+    int stride() const { return (jointCount() + 3) & ~3; }
+
+    // Appends a joint; parent must already be in the skeleton
+    int addJoint(int parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+    void copyRestPose(LocalPose& pose) const;
+    // Read-only view of the rest pose
+    LocalPose restPose() const;
+};
+
+// local[i] = T * R * S of joint i
+void localMatrices(const LocalPose& pose, glm::mat4* local);
+void localMatricesScalar(const LocalPose& pose, glm::mat4* local);
+
+// model[i] = model[parent] * local[i], roots taken as they are
+void modelMatrices(const Skeleton& skeleton, const glm::mat4* local, glm::mat4* model);
+
+// Weighted blending: zero the sum, accumulate each layer, then normalise by the
+// total weight. Rotations are flipped onto the sum's hemisphere before adding, so
+// q and -q reinforce rather than cancel; the result is a normalised lerp.
+void clearPose(LocalPose& sum);
+void accumulatePose(const LocalPose& layer, float weight, LocalPose& sum);
+void normalizePose(LocalPose& sum, float totalWeight);
+
+// palette[i] = model[joints[i]] * inverseBind[i]
+void skinningPalette(const glm::mat4* model, const int* joints, const glm::mat4* inverseBind, int count, glm::mat4* palette);
@@ -0,0 +1,160 @@
+// Animation compression benchmark: memory of a synthetic clip library before and
+// after compression, the worst reconstruction error, and pose sampling throughput.
+// Run from the build directory: ./bench_animation [clip count]
+#include "anim/AnimationClip.h"
+#include "core/FrameArena.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const int JOINT_COUNT = 64;
+const float KEY_RATE = 30.0f;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Median of several runs, after one untimed warm-up
+template <typename Function>
+double medianMs(int runs, Function function) {
+    function();
+    std::vector<double> times;
+    for (int i = 0; i < runs; ++i) {
+        Clock::time_point start = Clock::now();
+        function();
+        times.push_back(millisecondsSince(start));
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+// Spine and limb chains, roughly a humanoid rig with finger joints
+Skeleton makeSkeleton() {
+    Skeleton skeleton;
+    skeleton.addJoint(-1, glm::vec3(0.0f, 100.0f, 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+    for (int i = 1; i < JOINT_COUNT; ++i) {
+        int parent = i % 8 == 1 ? 0 : i - 1;
+        skeleton.addJoint(parent, glm::vec3(0.0f, 12.0f, 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+    }
+    return skeleton;
+}
+
+// Every joint baked at the key rate, as exporters write it: smooth rotations on all
+// joints, a moving root, and constant translation and scale tracks elsewhere
+AnimationClip makeClip(std::mt19937& random) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    float duration = 1.0f + 3.0f * unit(random);
+    int keys = static_cast<int>(duration * KEY_RATE) + 1;
+
+    AnimationClip clip;
+    for (int joint = 0; joint < JOINT_COUNT; ++joint) {
+        glm::vec3 axis = glm::normalize(glm::vec3(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f));
+        float amplitude = 0.2f + unit(random), frequency = 0.5f + 2.0f * unit(random), phase = 6.2831853f * unit(random);
+
+        RawTrack rotation{ joint, TrackKind::Rotation, {}, {} };
+        RawTrack translation{ joint, TrackKind::Translation, {}, {} };
+        RawTrack scale{ joint, TrackKind::Scale, {}, {} };
+        for (int k = 0; k < keys; ++k) {
+            float time = k / KEY_RATE;
+            float angle = amplitude * std::sin(frequency * time + phase);
+            glm::quat q = glm::angleAxis(angle, axis);
+            rotation.times.push_back(time);
+            rotation.values.push_back(glm::vec4(q.x, q.y, q.z, q.w));
+
+            glm::vec3 offset = joint == 0 ? glm::vec3(20.0f * time, 3.0f * std::sin(8.0f * time), 0.0f)
+                                          : glm::vec3(0.0f, 12.0f, 0.0f);
+            translation.times.push_back(time);
+            translation.values.push_back(glm::vec4(offset, 0.0f));
+            scale.times.push_back(time);
+            scale.values.push_back(glm::vec4(1.0f));
+        }
+        clip.addTrack(std::move(rotation));
+        clip.addTrack(std::move(translation));
+        clip.addTrack(std::move(scale));
+    }
+    return clip;
+}
+
+// Largest joint-local difference between the two clips over a fine time grid
+void measureError(const Skeleton& skeleton, const AnimationClip& raw, const AnimationClip& compressed,
+                  FrameArena& arena, float& translationError, float& rotationError) {
+    ArenaScope scope(arena);
+    LocalPose a = allocatePose(arena, skeleton.jointCount());
+    LocalPose b = allocatePose(arena, skeleton.jointCount());
+    for (float time = 0.0f; time < raw.duration(); time += 0.25f / KEY_RATE) {
+        skeleton.copyRestPose(a);
+        skeleton.copyRestPose(b);
+        raw.sample(time, a);
+        compressed.sample(time, b);
+        for (int j = 0; j < skeleton.jointCount(); ++j) {
+            translationError = std::max(translationError, glm::length(a.translation(j) - b.translation(j)));
+            glm::quat relative = glm::conjugate(a.rotation(j)) * b.rotation(j);
+            float angle = 2.0f * std::atan2(glm::length(glm::vec3(relative.x, relative.y, relative.z)), std::abs(relative.w));
+            rotationError = std::max(rotationError, angle);
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int count = argc > 1 ? std::max(atoi(argv[1]), 1) : 200;
+    Skeleton skeleton = makeSkeleton();
+    AnimationTolerance tolerance;
+
+    std::mt19937 random(1234);
+    std::vector<AnimationClip> raw, compressed;
+    for (int i = 0; i < count; ++i) raw.push_back(makeClip(random));
+    compressed = raw;
+
+    Clock::time_point compressStart = Clock::now();
+    for (AnimationClip& clip : compressed) clip.compress(tolerance, skeleton);
+    double compressMs = millisecondsSince(compressStart);
+
+    size_t rawBytes = 0, compressedBytes = 0;
+    long long rawKeys = 0, compressedKeys = 0;
+    for (int i = 0; i < count; ++i) {
+        rawBytes += raw[i].byteSize();
+        compressedBytes += compressed[i].byteSize();
+        rawKeys += raw[i].keyCount();
+        compressedKeys += compressed[i].keyCount();
+    }
+    printf("%d clips of %d joints, compressed in %.1f ms\n", count, JOINT_COUNT, compressMs);
+    printf("memory: %.1f KB raw, %.1f KB compressed (%.1fx); keys %lld -> %lld\n", rawBytes / 1024.0,
+           compressedBytes / 1024.0, double(rawBytes) / compressedBytes, rawKeys, compressedKeys);
+
+    FrameArena arena(size_t(1) << 20);
+    float translationError = 0.0f, rotationError = 0.0f;
+    for (int i = 0; i < count; ++i) measureError(skeleton, raw[i], compressed[i], arena, translationError, rotationError);
+    printf("max error: translation %.4f (tolerance %.4f), rotation %.5f rad (tolerance %.5f)\n",
+           translationError, tolerance.translation, rotationError, tolerance.rotation);
+
+    // One pose per clip at a time that walks through the clips, like a crowd would
+    LocalPose pose = allocatePose(arena, skeleton.jointCount());
+    float sink = 0.0f;
+    const int SAMPLES = 4;
+    auto sampleAll = [&](const std::vector<AnimationClip>& clips) {
+        for (int s = 0; s < SAMPLES; ++s) {
+            for (int i = 0; i < count; ++i) {
+                skeleton.copyRestPose(pose);
+                clips[i].sample(0.37f * (i + s), pose);
+                sink += pose.stream(LocalPose::QW)[i % JOINT_COUNT];
+            }
+        }
+    };
+    double rawMs = medianMs(11, [&] { sampleAll(raw); });
+    double compressedMs = medianMs(11, [&] { sampleAll(compressed); });
+    double poses = double(count) * SAMPLES;
+    printf("sampling: raw %.0f poses/s (%.2f us), compressed %.0f poses/s (%.2f us) (%d)\n",
+           poses / (rawMs * 1e-3), 1e3 * rawMs / poses, poses / (compressedMs * 1e-3), 1e3 * compressedMs / poses,
+           static_cast<int>(sink) & 1);
+    return 0;
+}
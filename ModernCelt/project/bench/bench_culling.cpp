@@ -0,0 +1,148 @@
+// Culling microbenchmarks: BVH frustum culling against a linear sweep, four boxes
+// per SSE plane test against one box at a time, and incremental refits as a
+// fraction of the objects move.
+// Run from the build directory: ./bench_culling [object count]
+#include "core/JobSystem.h"
+#include "scene/EntityStore.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Median of several runs, after one untimed warm-up
+template <typename Function>
+double medianMs(int runs, Function function) {
+    function();
+    std::vector<double> times;
+    for (int i = 0; i < runs; ++i) {
+        Clock::time_point start = Clock::now();
+        function();
+        times.push_back(millisecondsSince(start));
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+// Boxes scattered over a square world, roughly like buildings on the terrain;
+// every tenth one is dynamic
+void populate(EntityStore& entities, int count, float worldSize, std::vector<Entity>& dynamic) {
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-0.5f * worldSize, 0.5f * worldSize);
+    std::uniform_real_distribution<float> size(0.5f, 8.0f);
+    for (int i = 0; i < count; ++i) {
+        glm::vec3 scale(size(random), 2.0f * size(random), size(random));
+        Entity entity = entities.create(glm::vec3(position(random), scale.y, position(random)),
+                                        glm::quat(1.0f, 0.0f, 0.0f, 0.0f), scale);
+        entities.setLocalBounds(entity, AABB(glm::vec3(-1.0f), glm::vec3(1.0f)));
+        bool moving = i % 10 == 0;
+        entities.setRenderable(entity, Renderable{ RenderKind::Building, 0, true, !moving });
+        if (moving) dynamic.push_back(entity);
+    }
+    entities.updateTransforms();
+}
+
+// Visible boxes among the first count, classified four at a time
+int countVisibleBatched(const Frustum& view, const EntityStore& entities, int count) {
+    int visible = 0;
+    for (int i = 0; i < count; i += 4) {
+        const AABB* boxes[4];
+        for (int k = 0; k < 4; ++k) boxes[k] = &entities.boundsAt(std::min(i + k, count - 1));
+        Frustum::Result results[4];
+        view.classify(boxes, results);
+        for (int k = 0; k < 4 && i + k < count; ++k) visible += results[k] != Frustum::Result::Outside;
+    }
+    return visible;
+}
+
+// Camera frusta looking across the world from a ring of positions
+std::vector<Frustum> makeViews(float worldSize, int count) {
+    std::vector<Frustum> views;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
+    for (int i = 0; i < count; ++i) {
+        float angle = 6.2831853f * i / count;
+        glm::vec3 eye(0.3f * worldSize * std::cos(angle), 10.0f, 0.3f * worldSize * std::sin(angle));
+        glm::vec3 target = eye + glm::vec3(-std::sin(angle), -0.05f, std::cos(angle));
+        views.push_back(Frustum::fromMatrix(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f))));
+    }
+    return views;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int count = argc > 1 ? std::max(atoi(argv[1]), 1) : 10000;
+    float worldSize = 40.0f * std::sqrt(static_cast<float>(count));
+    jobSystem().initialize();
+
+    EntityStore entities;
+    std::vector<Entity> dynamic;
+    Clock::time_point buildStart = Clock::now();
+    populate(entities, count, worldSize, dynamic);
+    double buildMs = millisecondsSince(buildStart);
+    printf("%d objects (%zu dynamic), built in %.2f ms, BVH height %d static / %d dynamic\n", count, dynamic.size(),
+           buildMs, entities.staticTree().height(), entities.dynamicTree().height());
+
+    std::vector<Frustum> views = makeViews(worldSize, 16);
+    std::vector<int> visible;
+    visible.reserve(count);
+
+    // Every method must agree on what is visible, up to the BVH's conservative leaves
+    long long bvhVisible = 0, linearVisible = 0, batchedVisible = 0;
+    for (const Frustum& view : views) {
+        visible.clear();
+        bvhVisible += entities.cull(view, EntityStore::CULL_ALL, visible);
+        for (int i = 0; i < entities.count(); ++i) linearVisible += view.visible(entities.boundsAt(i)) ? 1 : 0;
+        batchedVisible += countVisibleBatched(view, entities, entities.count());
+    }
+    printf("visible per view: %.1f BVH, %.1f exact, %.1f exact in batches of four\n", double(bvhVisible) / views.size(),
+           double(linearVisible) / views.size(), double(batchedVisible) / views.size());
+
+    double bvhMs = medianMs(21, [&] {
+        for (const Frustum& view : views) {
+            visible.clear();
+            entities.cull(view, EntityStore::CULL_ALL, visible);
+        }
+    }) / views.size();
+
+    int sink = 0;
+    double batchedMs = medianMs(21, [&] {
+        for (const Frustum& view : views) sink += countVisibleBatched(view, entities, entities.count());
+    }) / views.size();
+    double singleMs = medianMs(21, [&] {
+        for (const Frustum& view : views) {
+            for (int i = 0; i < entities.count(); ++i) sink += view.classify(entities.boundsAt(i)) != Frustum::Result::Outside;
+        }
+    }) / views.size();
+
+    printf("cull per view: BVH %.4f ms, linear four boxes per test %.4f ms, linear one box per test %.4f ms (%d)\n",
+           bvhMs, batchedMs, singleMs, sink & 1);
+
+    // Refit: move a share of the dynamic objects each frame, as the simulation would
+    std::mt19937 random(99);
+    std::uniform_real_distribution<float> step(-0.5f, 0.5f);
+    for (int percent : { 1, 10, 100 }) {
+        int moving = std::max(1, static_cast<int>(dynamic.size()) * percent / 100);
+        double refitMs = medianMs(21, [&] {
+            for (int i = 0; i < moving; ++i) {
+                Entity entity = dynamic[i];
+                entities.setPosition(entity, entities.position(entity) + glm::vec3(step(random), 0.0f, step(random)));
+            }
+            entities.updateTransforms();
+        });
+        printf("update + refit, %3d%% of dynamic objects moving (%d): %.4f ms\n", percent, moving, refitMs);
+    }
+
+    jobSystem().shutdown();
+    return 0;
+}
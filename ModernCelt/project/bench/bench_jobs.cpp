@@ -0,0 +1,89 @@
+// Job system microbenchmarks: spawn overhead, and parallel-for scaling on the
+// terrain generator. Run from the build directory: ./bench_jobs [grid size]
+#include "core/JobSystem.h"
+#include "scene/Heightfield.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct GridVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+};
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Median of several runs, after one untimed warm-up
+template <typename Function>
+double medianMs(int runs, Function function) {
+    function();
+    std::vector<double> times;
+    for (int i = 0; i < runs; ++i) {
+        Clock::time_point start = Clock::now();
+        function();
+        times.push_back(millisecondsSince(start));
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+void benchSpawn(int workers) {
+    const int jobs = 100000;
+    std::atomic<int> sink{ 0 };
+    jobSystem().initialize(workers);
+    double ms = medianMs(5, [&] {
+        JobCounter counter;
+        for (int i = 0; i < jobs; ++i) {
+            jobSystem().run([&sink] { sink.fetch_add(1, std::memory_order_relaxed); }, &counter);
+        }
+        jobSystem().wait(counter);
+    });
+    jobSystem().shutdown();
+    printf("  %2d workers: %8.1f ns per job (spawn + run + wait)\n", workers, ms * 1e6 / jobs);
+}
+
+void benchTerrain(int size, int workers, double serialMs) {
+    Heightfield field(1234);
+    std::vector<GridVertex> vertices(static_cast<size_t>(size) * size);
+    jobSystem().initialize(workers);
+    double ms = medianMs(5, [&] {
+        jobSystem().parallelFor(0, size, 16, [&](int rowBegin, int rowEnd) {
+            fillGridRows(field, size, size, rowBegin, rowEnd, vertices.data());
+        });
+    });
+    jobSystem().shutdown();
+    printf("  %2d workers: %8.2f ms  speed-up %.2fx\n", workers, ms, serialMs / ms);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int size = argc > 1 ? atoi(argv[1]) : 500;
+    int hardware = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::vector<int> workerCounts;
+    for (int workers = 1; workers < hardware; workers *= 2) workerCounts.push_back(workers);
+    if (workerCounts.empty() || workerCounts.back() != std::max(1, hardware - 1)) workerCounts.push_back(std::max(1, hardware - 1));
+
+    printf("Hardware threads: %d\n\n", hardware);
+
+    printf("Task spawn overhead (100000 empty jobs from the main thread)\n");
+    for (int workers : workerCounts) benchSpawn(workers);
+
+    printf("\nTerrain generation, %d x %d grid, parallel-for over rows\n", size, size);
+    Heightfield field(1234);
+    std::vector<GridVertex> vertices(static_cast<size_t>(size) * size);
+    double serialMs = medianMs(5, [&] { fillGridRows(field, size, size, 0, size, vertices.data()); });
+    printf("  serial:     %8.2f ms\n", serialMs);
+    for (int workers : workerCounts) benchTerrain(size, workers, serialMs);
+    return 0;
+}
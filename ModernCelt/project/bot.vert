@@ -1,22 +1,45 @@
 #version 330 core
 
-// Attributes
-layout(location = 0) in vec3 inPosition;   // Vertex position
+// Attributes, quantized at load (see SkinnedVertex); FLOAT_VERTICES is defined
+// when the character keeps them as floats (FloatSkinnedVertex)
+layout(location = 0) in vec3 inPosition;   // Vertex position, unorm16 within the mesh bounds
+#ifdef FLOAT_VERTICES
 layout(location = 1) in vec3 inNormal;     // Vertex normal
-layout(location = 2) in vec2 inTexCoord;   // Texture coordinates
+#else
+layout(location = 1) in vec2 inNormal;     // Vertex normal, octahedral snorm16
+#endif
+layout(location = 2) in vec2 inTexCoord;   // Texture coordinates, half float
 layout(location = 3) in uvec4 inJoints;    // Joint indices
-layout(location = 4) in vec4 inWeights;    // Joint weights
+layout(location = 4) in vec4 inWeights;    // Joint weights, unorm8
 
 // Uniforms
 uniform mat4 MVP;                  // Model-View-Projection matrix
 uniform mat4 jointMatrices[50];    // Array of joint matrices
+uniform vec3 positionOrigin;       // Mesh bounds the positions were quantized in
+uniform vec3 positionExtent;
 
 // Outputs to the fragment shader
 out vec3 worldPosition;
 out vec3 worldNormal;
 out vec2 texCoord;  // Add this for texture coordinates
 
+// Unfolds the lower hemisphere from the octahedron's corners
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 void main() {
+#ifdef FLOAT_VERTICES
+    vec3 position = inPosition;
+    vec3 normal = inNormal;
+#else
+    vec3 position = positionOrigin + positionExtent * inPosition;
+    vec3 normal = decodeOctahedral(inNormal);
+#endif
+
     // Skinning transformation
     vec4 skinnedPosition = vec4(0.0);
     vec3 skinnedNormal = vec3(0.0);
@@ -26,9 +49,9 @@ void main() {
         if (weight > 0.0) {
             uint jointIndex = inJoints[i];
             mat4 jointMatrix = jointMatrices[jointIndex];
-            skinnedPosition += weight * (jointMatrix * vec4(inPosition, 1.0));
+            skinnedPosition += weight * (jointMatrix * vec4(position, 1.0));
             mat3 jointMatrix3 = mat3(jointMatrix);
-            skinnedNormal += weight * (jointMatrix3 * inNormal);
+            skinnedNormal += weight * (jointMatrix3 * normal);
         }
     }
 
@@ -0,0 +1,27 @@
+#version 330 core
+
+// Skinned positions only; the shadow pass needs no other attributes
+layout(location = 0) in vec3 inPosition;   // Vertex position, unorm16 within the mesh bounds
+layout(location = 3) in uvec4 inJoints;    // Joint indices
+layout(location = 4) in vec4 inWeights;    // Joint weights, unorm8
+
+uniform mat4 MVP;                  // Light-space matrix * model matrix
+uniform mat4 jointMatrices[50];    // Array of joint matrices
+uniform vec3 positionOrigin;       // Mesh bounds the positions were quantized in
+uniform vec3 positionExtent;
+
+void main() {
+#ifdef FLOAT_VERTICES
+    vec3 position = inPosition;
+#else
+    vec3 position = positionOrigin + positionExtent * inPosition;
+#endif
+    vec4 skinnedPosition = vec4(0.0);
+    for (int i = 0; i < 4; i++) {
+        float weight = inWeights[i];
+        if (weight > 0.0) {
+            skinnedPosition += weight * (jointMatrices[inJoints[i]] * vec4(position, 1.0));
+        }
+    }
+    gl_Position = MVP * skinnedPosition;
+}
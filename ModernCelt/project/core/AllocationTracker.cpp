@@ -0,0 +1,65 @@
+#include "AllocationTracker.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> count{ 0 };
+std::atomic<uint64_t> bytes{ 0 };
+std::atomic<bool> guardArmed{ false };
+thread_local int allowDepth = 0;
+
+void* allocate(size_t size) {
+    count.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    if (guardArmed.load(std::memory_order_relaxed) && allowDepth == 0) {
+        // Disarm first: reporting must not trip the guard again
+        guardArmed.store(false);
+        fprintf(stderr, "Heap allocation of %zu bytes while the allocation guard is armed\n", size);
+        std::abort();
+    }
+    return std::malloc(size ? size : 1);
+}
+
+void* allocateOrThrow(size_t size) {
+    void* memory = allocate(size);
+    if (!memory) throw std::bad_alloc();
+    return memory;
+}
+
+} // namespace
+
+uint64_t allocationCount() {
+    return count.load(std::memory_order_relaxed);
+}
+
+uint64_t allocationBytes() {
+    return bytes.load(std::memory_order_relaxed);
+}
+
+void setAllocationGuard(bool armed) {
+    guardArmed.store(armed);
+}
+
+bool allocationGuardArmed() {
+    return guardArmed.load();
+}
+
+AllowAllocations::AllowAllocations() {
+    allowDepth++;
+}
+
+AllowAllocations::~AllowAllocations() {
+    allowDepth--;
+}
+
+void* operator new(size_t size) { return allocateOrThrow(size); }
+void* operator new[](size_t size) { return allocateOrThrow(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Heap allocation accounting. Linking AllocationTracker.cpp replaces the global
+// operator new and delete, so every allocation in the program is counted; reading
+// the counters before and after a stretch of code shows what it allocated.
+// Over-aligned new and plain malloc (stb_image, GL drivers) are not counted.
+//
+// The guard is a debug mode for allocation-free frames: while it is armed, any heap
+// allocation on any thread reports its size and aborts, so a debugger or core dump
+// shows the call stack. Work that is allowed to allocate (background loading, files
+// written on request) runs under AllowAllocations.
+uint64_t allocationCount();
+uint64_t allocationBytes();
+
+void setAllocationGuard(bool armed);
+bool allocationGuardArmed();
+
+// Exempts the calling thread from the guard while alive
+class AllowAllocations {
+public:
+    AllowAllocations();
+    ~AllowAllocations();
+    AllowAllocations(const AllowAllocations&) = delete;
+    AllowAllocations& operator=(const AllowAllocations&) = delete;
+};
@@ -0,0 +1,161 @@
+#include "BenchmarkReport.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+struct Summary {
+    double mean = 0.0, min = 0.0, max = 0.0;
+    double p50 = 0.0, p90 = 0.0, p95 = 0.0, p99 = 0.0;
+};
+
+// Nearest-rank percentile of sorted samples
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t rank = static_cast<size_t>(p / 100.0 * sorted.size() + 0.5);
+    rank = std::min(std::max(rank, static_cast<size_t>(1)), sorted.size());
+    return sorted[rank - 1];
+}
+
+Summary summarize(std::vector<double> samples) {
+    Summary summary;
+    if (samples.empty()) return summary;
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (double sample : samples) sum += sample;
+    summary.mean = sum / samples.size();
+    summary.min = samples.front();
+    summary.max = samples.back();
+    summary.p50 = percentile(samples, 50.0);
+    summary.p90 = percentile(samples, 90.0);
+    summary.p95 = percentile(samples, 95.0);
+    summary.p99 = percentile(samples, 99.0);
+    return summary;
+}
+
+void writeSummary(FILE* file, const Summary& s) {
+    fprintf(file, "{ \"mean\": %.4f, \"min\": %.4f, \"max\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p95\": %.4f, \"p99\": %.4f }",
+            s.mean, s.min, s.max, s.p50, s.p90, s.p95, s.p99);
+}
+
+// Minimal JSON string escaping for names and paths
+void writeString(FILE* file, const std::string& text) {
+    fputc('"', file);
+    for (char c : text) {
+        if (c == '"' || c == '\\') fprintf(file, "\\%c", c);
+        else if (static_cast<unsigned char>(c) < 0x20) fprintf(file, "\\u%04x", c);
+        else fputc(c, file);
+    }
+    fputc('"', file);
+}
+
+} // namespace
+
+void BenchmarkReport::addPass(const char* name, double ms) {
+    size_t index = 0;
+    while (index < passNames.size() && passNames[index] != name) index++;
+    if (index == passNames.size()) passNames.push_back(name);
+    if (currentPasses.size() < passNames.size()) currentPasses.resize(passNames.size(), 0.0);
+    currentPasses[index] += ms;
+}
+
+void BenchmarkReport::addCounter(const char* name, double value) {
+    size_t index = 0;
+    while (index < counterNames.size() && counterNames[index] != name) index++;
+    if (index == counterNames.size()) counterNames.push_back(name);
+    if (currentCounters.size() < counterNames.size()) currentCounters.resize(counterNames.size(), 0.0);
+    currentCounters[index] += value;
+}
+
+void BenchmarkReport::reserve(int frameCount) {
+    // Generous per-frame room; the pass and counter lists are short
+    frames.reserve(frameCount);
+    values.reserve(static_cast<size_t>(frameCount) * 32);
+    passNames.reserve(32);
+    counterNames.reserve(32);
+    currentPasses.reserve(32);
+    currentCounters.reserve(32);
+}
+
+void BenchmarkReport::endFrame(double ms) {
+    currentPasses.resize(passNames.size(), 0.0);
+    currentCounters.resize(counterNames.size(), 0.0);
+    Frame frame{ ms, values.size(), currentPasses.size(), values.size() + currentPasses.size(), currentCounters.size() };
+    values.insert(values.end(), currentPasses.begin(), currentPasses.end());
+    values.insert(values.end(), currentCounters.begin(), currentCounters.end());
+    frames.push_back(frame);
+    std::fill(currentPasses.begin(), currentPasses.end(), 0.0);
+    std::fill(currentCounters.begin(), currentCounters.end(), 0.0);
+}
+
+void BenchmarkReport::addGpuScope(const std::string& path, double meanMs) {
+    gpuScopes.push_back(GpuScope{ path, meanMs });
+}
+
+bool BenchmarkReport::writeJson(const char* path, const Info& info) const {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return false;
+    }
+
+    size_t first = std::min(frames.size(), static_cast<size_t>(std::max(warmupFrames, 0)));
+    std::vector<double> frameSamples;
+    for (size_t i = first; i < frames.size(); ++i) frameSamples.push_back(frames[i].ms);
+
+    fprintf(file, "{\n  \"renderer\": ");
+    writeString(file, info.renderer);
+    fprintf(file, ",\n  \"cameraPath\": ");
+    writeString(file, info.cameraPath);
+    fprintf(file, ",\n  \"width\": %d,\n  \"height\": %d,\n", info.width, info.height);
+    fprintf(file, "  \"fixedTimestep\": %.6f,\n", info.fixedTimestep);
+    fprintf(file, "  \"frames\": %zu,\n  \"warmupFrames\": %zu,\n", frames.size(), first);
+    fprintf(file, "  \"frameCpuMs\": ");
+    writeSummary(file, summarize(frameSamples));
+
+    fprintf(file, ",\n  \"passes\": [");
+    for (size_t p = 0; p < passNames.size(); ++p) {
+        std::vector<double> passSamples;
+        for (size_t i = first; i < frames.size(); ++i) {
+            passSamples.push_back(passMs(frames[i], p));
+        }
+        fprintf(file, "%s\n    { \"name\": ", p ? "," : "");
+        writeString(file, passNames[p]);
+        fprintf(file, ", \"cpuMs\": ");
+        writeSummary(file, summarize(passSamples));
+        fprintf(file, " }");
+    }
+
+    fprintf(file, "\n  ],\n  \"counters\": [");
+    for (size_t c = 0; c < counterNames.size(); ++c) {
+        std::vector<double> counterSamples;
+        for (size_t i = first; i < frames.size(); ++i) {
+            counterSamples.push_back(counter(frames[i], c));
+        }
+        fprintf(file, "%s\n    { \"name\": ", c ? "," : "");
+        writeString(file, counterNames[c]);
+        fprintf(file, ", \"value\": ");
+        writeSummary(file, summarize(counterSamples));
+        fprintf(file, " }");
+    }
+
+    fprintf(file, "\n  ],\n  \"gpuScopes\": [");
+    for (size_t g = 0; g < gpuScopes.size(); ++g) {
+        fprintf(file, "%s\n    { \"path\": ", g ? "," : "");
+        writeString(file, gpuScopes[g].path);
+        fprintf(file, ", \"meanMs\": %.4f }", gpuScopes[g].meanMs);
+    }
+
+    fprintf(file, "\n  ],\n  \"perFrame\": [");
+    for (size_t i = 0; i < frames.size(); ++i) {
+        fprintf(file, "%s\n    { \"frame\": %zu, \"cpuMs\": %.4f, \"passes\": [", i ? "," : "", i, frames[i].ms);
+        for (size_t p = 0; p < frames[i].passCount; ++p) {
+            fprintf(file, "%s%.4f", p ? ", " : "", passMs(frames[i], p));
+        }
+        fprintf(file, "] }");
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Per-frame timings of a benchmark run, written out as a JSON report.
+// Frames before warmupFrames are kept in the per-frame list but left out of the
+// summary statistics (shader compilation and first uploads land there).
+class BenchmarkReport {
+public:
+    struct Info {
+        std::string renderer;
+        std::string cameraPath;
+        int width = 0;
+        int height = 0;
+        double fixedTimestep = 0.0;
+    };
+
+    int warmupFrames = 10;
+
+    // Room for frameCount frames, so recording them does not allocate
+    void reserve(int frameCount);
+
+    // Record the CPU time of a named pass in the current frame
+    void addPass(const char* name, double ms);
+
+    // Close the current frame with its total CPU time
+    void endFrame(double ms);
+
+    // Record a per-frame count (objects drawn, culled, ...) in the current frame
+    void addCounter(const char* name, double value);
+
+    // GPU time for a profiler scope (its rolling average), reported alongside the CPU passes
+    void addGpuScope(const std::string& path, double meanMs);
+
+    int frameCount() const { return static_cast<int>(frames.size()); }
+
+    bool writeJson(const char* path, const Info& info) const;
+
+private:
+    // Pass times and counters live in values, indexed like passNames and counterNames;
+    // names first seen after a frame read as 0 for it
+    struct Frame {
+        double ms;
+        size_t passBegin;
+        size_t passCount;
+        size_t counterBegin;
+        size_t counterCount;
+    };
+
+    double passMs(const Frame& frame, size_t pass) const { return pass < frame.passCount ? values[frame.passBegin + pass] : 0.0; }
+    double counter(const Frame& frame, size_t index) const { return index < frame.counterCount ? values[frame.counterBegin + index] : 0.0; }
+
+    struct GpuScope {
+        std::string path;
+        double meanMs;
+    };
+
+    std::vector<std::string> passNames;
+    std::vector<double> currentPasses;
+    std::vector<std::string> counterNames;
+    std::vector<double> currentCounters;
+    std::vector<Frame> frames;
+    std::vector<double> values;
+    std::vector<GpuScope> gpuScopes;
+};
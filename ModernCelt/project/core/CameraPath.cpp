@@ -0,0 +1,57 @@
+#include "CameraPath.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+bool CameraPath::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open camera path " << path << std::endl;
+        return false;
+    }
+
+    keys.clear();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+
+        Key key;
+        std::istringstream fields(line);
+        if (!(fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch)) {
+            std::cerr << path << ":" << lineNumber << ": expected 'time x y z yaw pitch'" << std::endl;
+            return false;
+        }
+        if (!keys.empty() && key.time <= keys.back().time) {
+            std::cerr << path << ":" << lineNumber << ": key times must increase" << std::endl;
+            return false;
+        }
+        keys.push_back(key);
+    }
+
+    if (keys.empty()) {
+        std::cerr << "Camera path " << path << " has no keys" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+CameraPath::Key CameraPath::sample(float time) const {
+    if (time <= keys.front().time) return keys.front();
+    if (time >= keys.back().time) return keys.back();
+
+    size_t next = 1;
+    while (keys[next].time < time) next++;
+    const Key& a = keys[next - 1];
+    const Key& b = keys[next];
+    float t = (time - a.time) / (b.time - a.time);
+
+    Key key;
+    key.time = time;
+    key.position = glm::mix(a.position, b.position, t);
+    key.yaw = a.yaw + (b.yaw - a.yaw) * t;
+    key.pitch = a.pitch + (b.pitch - a.pitch) * t;
+    return key;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Keyframed camera flythrough loaded from a text file with one key per line:
+//     time x y z yaw pitch
+// Times are in seconds and increasing; yaw/pitch are degrees as used by the free
+// camera. Blank lines and lines starting with '#' are ignored. Between keys the
+// camera is interpolated linearly; before the first / after the last key it holds.
+class CameraPath {
+public:
+    struct Key {
+        float time;
+        glm::vec3 position;
+        float yaw;
+        float pitch;
+    };
+
+    bool load(const std::string& path);
+
+    bool empty() const { return keys.empty(); }
+    float duration() const { return keys.empty() ? 0.0f : keys.back().time; }
+    Key sample(float time) const;
+
+private:
+    std::vector<Key> keys;
+};
@@ -0,0 +1,150 @@
+#include "CpuProfiler.h"
+#include "AllocationTracker.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+
+namespace {
+
+thread_local void* threadBuffer = nullptr;
+
+void writeString(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') fprintf(file, "\\%c", *c);
+        else if (static_cast<unsigned char>(*c) < 0x20) fprintf(file, "\\u%04x", *c);
+        else fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+// Chrome trace timestamps are microseconds; every event follows the Frames track metadata
+void writeCompleteEvent(FILE* file, const char* name, int tid, uint64_t begin, uint64_t end) {
+    fprintf(file, ",\n    { \"name\": ");
+    writeString(file, name);
+    fprintf(file, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f }",
+            tid, begin / 1000.0, (end - begin) / 1000.0);
+}
+
+} // namespace
+
+CpuProfiler& cpuProfiler() {
+    static CpuProfiler profiler;
+    return profiler;
+}
+
+CpuProfiler::Scope::~Scope() {
+    cpuProfiler().record(name, begin, now());
+}
+
+uint64_t CpuProfiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CpuProfiler::ThreadBuffer& CpuProfiler::localBuffer() {
+    if (!threadBuffer) {
+        // First scope on this thread; buffers outlive their threads so traces keep them
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        threads.emplace_back(new ThreadBuffer());
+        ThreadBuffer& buffer = *threads.back();
+        buffer.id = static_cast<int>(threads.size());
+        buffer.name = "Thread " + std::to_string(buffer.id);
+        threadBuffer = &buffer;
+    }
+    return *static_cast<ThreadBuffer*>(threadBuffer);
+}
+
+void CpuProfiler::setThreadName(const char* name) {
+    ThreadBuffer& buffer = localBuffer();
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    buffer.name = name;
+}
+
+void CpuProfiler::record(const char* name, uint64_t begin, uint64_t end) {
+    ThreadBuffer& buffer = localBuffer();
+    uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    buffer.events[index % EVENTS_PER_THREAD] = { name, begin, end };
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void CpuProfiler::beginFrame() {
+    frameBegin = now();
+}
+
+void CpuProfiler::endFrame() {
+    uint64_t end = now();
+    uint64_t index = frameIndex++;
+    frames[index % FRAME_HISTORY] = { index, frameBegin, end };
+    lastFrameDuration = (end - frameBegin) / 1e6;
+
+    // One dump per run of slow frames: the next can only follow once this one's frames have scrolled out
+    if (config.hitchBudgetMs <= 0.0 || lastFrameDuration <= config.hitchBudgetMs || index < nextHitchFrame) return;
+    hitches++;
+    nextHitchFrame = index + config.hitchFrames;
+    AllowAllocations allow;
+
+    std::filesystem::create_directories(config.hitchDirectory);
+    std::string path = config.hitchDirectory + "/hitch_frame_" + std::to_string(index) + ".json";
+    if (writeChromeTrace(path.c_str(), config.hitchFrames)) {
+        printf("Hitch: frame %llu took %.1f ms (budget %.1f ms), trace saved to %s\n",
+               (unsigned long long)index, lastFrameDuration, config.hitchBudgetMs, path.c_str());
+    }
+}
+
+bool CpuProfiler::writeChromeTrace(const char* path, int frameCount) const {
+    uint64_t available = std::min<uint64_t>(frameIndex, FRAME_HISTORY);
+    uint64_t count = std::min<uint64_t>(std::max(frameCount, 1), available);
+    if (count == 0) return false;
+
+    const Frame& newest = frames[(frameIndex - 1) % FRAME_HISTORY];
+    const Frame& oldest = frames[(frameIndex - count) % FRAME_HISTORY];
+    uint64_t from = oldest.begin;
+    uint64_t to = newest.end;
+
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        std::cerr << "Failed to open " << path << " for writing." << std::endl;
+        return false;
+    }
+
+    // Frames get their own track above the threads
+    fprintf(file, "{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [");
+    fprintf(file, "\n    { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": { \"name\": \"Frames\" } }");
+    char frameName[32];
+    for (uint64_t i = frameIndex - count; i < frameIndex; ++i) {
+        const Frame& frame = frames[i % FRAME_HISTORY];
+        snprintf(frameName, sizeof(frameName), "Frame %llu", (unsigned long long)frame.index);
+        writeCompleteEvent(file, frameName, 0, frame.begin, frame.end);
+    }
+
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    std::vector<Event> events;
+    for (const std::unique_ptr<ThreadBuffer>& buffer : threads) {
+        fprintf(file, ",\n    { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": { \"name\": ", buffer->id);
+        writeString(file, buffer->name.c_str());
+        fprintf(file, " } }");
+
+        // Copy the ring, then keep only entries the owner cannot have overwritten meanwhile
+        // (it may already be writing entry 'after', which reuses the slot of after - EVENTS_PER_THREAD)
+        uint64_t end = buffer->written.load(std::memory_order_acquire);
+        uint64_t begin = end > EVENTS_PER_THREAD ? end - EVENTS_PER_THREAD : 0;
+        events.clear();
+        for (uint64_t i = begin; i < end; ++i) events.push_back(buffer->events[i % EVENTS_PER_THREAD]);
+        uint64_t after = buffer->written.load(std::memory_order_acquire) + 1;
+        uint64_t firstIntact = after > EVENTS_PER_THREAD ? after - EVENTS_PER_THREAD : 0;
+        size_t skip = static_cast<size_t>(std::min(std::max(firstIntact, begin) - begin, end - begin));
+
+        for (size_t i = skip; i < events.size(); ++i) {
+            const Event& event = events[i];
+            if (event.end < from || event.begin > to) continue;
+            writeCompleteEvent(file, event.name, buffer->id, event.begin, event.end);
+        }
+    }
+
+    fprintf(file, "\n  ]\n}\n");
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Scoped CPU timing for every thread, exported as Chrome trace-event JSON
+// (load the file in chrome://tracing or ui.perfetto.dev).
+// Each thread records into its own ring of completed scopes. Only the owning thread
+// writes its ring and publishes entries with a release store of the write count, so
+// recording takes no lock. Exporting copies a ring and then drops any entries the
+// owner overwrote while it was being copied. Scopes nest by time in the viewer.
+//
+// The main thread also brackets frames. A frame longer than the hitch budget dumps
+// the trace of the last hitchFrames frames to hitchDirectory.
+class CpuProfiler {
+public:
+    static const int EVENTS_PER_THREAD = 16384;
+    static const int FRAME_HISTORY = 600;
+
+    struct Config {
+        double hitchBudgetMs = 100.0;   // 0 turns the hitch detector off
+        int hitchFrames = 30;           // Frames written per hitch dump
+        std::string hitchDirectory = "hitches";
+    };
+
+    // RAII helper; see CPU_SCOPE below
+    struct Scope {
+        explicit Scope(const char* name) : name(name), begin(now()) {}
+        ~Scope();
+        const char* name;
+        uint64_t begin;
+    };
+
+    void configure(const Config& config) { this->config = config; }
+
+    // Label the calling thread in exported traces
+    void setThreadName(const char* name);
+
+    // Call on the main thread around every frame
+    void beginFrame();
+    void endFrame();
+
+    // Store a finished scope for the calling thread; name must outlive the profiler
+    void record(const char* name, uint64_t begin, uint64_t end);
+
+    // Write every thread's scopes that overlap the last frameCount frames
+    bool writeChromeTrace(const char* path, int frameCount) const;
+
+    double lastFrameMs() const { return lastFrameDuration; }
+    uint64_t hitchCount() const { return hitches; }
+
+    // Nanoseconds on the steady clock
+    static uint64_t now();
+
+private:
+    struct Event {
+        const char* name;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    struct ThreadBuffer {
+        std::string name;
+        int id = 0;
+        Event events[EVENTS_PER_THREAD];
+        std::atomic<uint64_t> written{ 0 };
+    };
+
+    struct Frame {
+        uint64_t index;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    Config config;
+    mutable std::mutex threadsMutex;   // Guards the list, not the rings
+    std::vector<std::unique_ptr<ThreadBuffer>> threads;
+    Frame frames[FRAME_HISTORY] = {};
+    uint64_t frameIndex = 0;
+    uint64_t frameBegin = 0;
+    uint64_t nextHitchFrame = 1;       // Frame 0 carries shader compilation and first uploads
+    uint64_t hitches = 0;
+    double lastFrameDuration = 0.0;
+
+    ThreadBuffer& localBuffer();
+};
+
+CpuProfiler& cpuProfiler();
+
+#define CPU_PROFILER_CONCAT_INNER(a, b) a##b
+#define CPU_PROFILER_CONCAT(a, b) CPU_PROFILER_CONCAT_INNER(a, b)
+// Time the enclosing block on the calling thread under the given (string literal) name
+#define CPU_SCOPE(name) CpuProfiler::Scope CPU_PROFILER_CONCAT(cpuScope, __LINE__)(name)
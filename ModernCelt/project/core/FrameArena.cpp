@@ -0,0 +1,76 @@
+#include "FrameArena.h"
+#include <algorithm>
+#include <cstdlib>
+
+struct FrameArena::OverflowBlock {
+    OverflowBlock* next;
+    size_t bytes;
+};
+
+FrameArena::FrameArena(size_t capacity) : size(capacity) {
+    buffer = static_cast<uint8_t*>(std::malloc(size));
+}
+
+FrameArena::~FrameArena() {
+    releaseOverflow(nullptr);
+    std::free(buffer);
+}
+
+void* FrameArena::allocate(size_t bytes, size_t alignment) {
+    size_t start = (offset + alignment - 1) & ~(alignment - 1);
+    if (start + bytes <= size) {
+        offset = start + bytes;
+        peak = std::max(peak, offset + overflowBytes);
+        return buffer + start;
+    }
+
+    // Out of room: borrow from malloc until the next reset grows the arena. The block
+    // carries its own list link, so the arena never goes through operator new.
+    size_t blockBytes = sizeof(OverflowBlock) + bytes + alignment;
+    OverflowBlock* block = static_cast<OverflowBlock*>(std::malloc(blockBytes));
+    block->next = overflow;
+    block->bytes = blockBytes;
+    overflow = block;
+    overflowBytes += blockBytes;
+    peak = std::max(peak, offset + overflowBytes);
+    uintptr_t address = reinterpret_cast<uintptr_t>(block + 1);
+    return reinterpret_cast<void*>((address + alignment - 1) & ~uintptr_t(alignment - 1));
+}
+
+// Overflow blocks are taken in stack order, like the offset, so the ones newer
+// than the mark are exactly those allocated since
+void FrameArena::rewind(const Mark& mark) {
+    offset = mark.offset;
+    if (overflow == mark.overflow) return;
+    releaseOverflow(mark.overflow);
+    // Nothing is left alive, so threads that never reset grow here instead
+    if (offset == 0 && !overflow) grow();
+}
+
+void FrameArena::reset() {
+    offset = 0;
+    if (!overflow) return;
+    releaseOverflow(nullptr);
+    grow();
+}
+
+void FrameArena::releaseOverflow(OverflowBlock* keep) {
+    while (overflow != keep) {
+        OverflowBlock* block = overflow;
+        overflow = block->next;
+        overflowBytes -= block->bytes;
+        std::free(block);
+    }
+}
+
+// Grow once so the frame that overflowed fits next time
+void FrameArena::grow() {
+    size = std::max(size * 2, peak);
+    std::free(buffer);
+    buffer = static_cast<uint8_t*>(std::malloc(size));
+}
+
+FrameArena& threadArena() {
+    thread_local FrameArena arena;
+    return arena;
+}
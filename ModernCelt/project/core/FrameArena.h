@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+// Linear (bump) allocator for data that only lives until the end of a frame or a
+// simulation tick. Allocating moves an offset; nothing is freed one by one. The owner
+// resets the arena once per frame, and code that only needs memory for a call
+// takes an ArenaScope, which rewinds to where it started when it goes out of scope.
+//
+// Each thread has its own arena (threadArena()), so allocating takes no lock. When
+// a frame needs more than the capacity, the overflow comes from malloc and the
+// next reset grows the arena to the high-water mark, so steady-state frames never
+// touch the heap. Only the main thread resets; on the simulation thread and the job
+// workers the overflow goes back when the ArenaScope that took it ends, and the
+// arena grows once the outermost scope has released everything.
+class FrameArena {
+public:
+    explicit FrameArena(size_t capacity = size_t(256) << 10);
+    ~FrameArena();
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    // count value-initialised Ts; they are never destroyed, so T must not need it
+    template <typename T>
+    T* allocateArray(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destroyed");
+        T* items = static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+        for (size_t i = 0; i < count; ++i) new (items + i) T();
+        return items;
+    }
+
+    struct OverflowBlock;
+
+    // Where the arena stood; rewinding frees everything allocated since
+    struct Mark {
+        size_t offset;
+        OverflowBlock* overflow;
+    };
+
+    Mark mark() const { return Mark{ offset, overflow }; }
+    void rewind(const Mark& mark);
+    void reset();
+
+    size_t used() const { return offset + overflowBytes; }
+    size_t highWater() const { return peak; }
+    size_t capacity() const { return size; }
+
+private:
+    uint8_t* buffer = nullptr;
+    size_t size = 0;
+    size_t offset = 0;
+    size_t peak = 0;
+    size_t overflowBytes = 0;
+    OverflowBlock* overflow = nullptr;   // Newest first; the list lives in the blocks
+
+    void releaseOverflow(OverflowBlock* keep);
+    void grow();
+};
+
+// The calling thread's arena
+FrameArena& threadArena();
+
+// Rewinds the arena to where it was on construction
+class ArenaScope {
+public:
+    explicit ArenaScope(FrameArena& arena = threadArena()) : arena(arena), start(arena.mark()) {}
+    ~ArenaScope() { arena.rewind(start); }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    FrameArena& arena;
+    FrameArena::Mark start;
+};
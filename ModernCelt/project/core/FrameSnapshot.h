@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+// Everything the renderer needs from one simulation tick. Snapshots are plain
+// fixed-size values so they can be copied between threads without allocating.
+struct CharacterSnapshot {
+    static const int MAX_JOINTS = 50;   // Size of jointMatrices[] in bot.vert
+
+    glm::mat4 model = glm::mat4(1.0f);
+    int jointCount = 0;
+    glm::mat4 jointMatrices[MAX_JOINTS];
+};
+
+struct FrameSnapshot {
+    static const int MAX_CHARACTERS = 4;
+
+    uint64_t tick = 0;
+    double time = 0.0;                  // Simulation time in seconds
+
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float yaw = 0.0f;                   // Degrees
+    float pitch = 0.0f;                 // Degrees
+
+    int characterCount = 0;
+    CharacterSnapshot characters[MAX_CHARACTERS];
+};
+
+// Camera moves requested by input since the last tick, in camera-relative terms
+struct CameraInput {
+    float forward = 0.0f;
+    float right = 0.0f;
+    float yaw = 0.0f;
+    float pitch = 0.0f;
+    int clipSteps = 0;    // Clips the characters advance by
+};
+
+// Unit view direction for a yaw/pitch pair in degrees
+glm::vec3 cameraDirection(float yaw, float pitch);
+
+// Blend two consecutive snapshots
+void interpolateSnapshots(const FrameSnapshot& from, const FrameSnapshot& to, float alpha, FrameSnapshot& out);
@@ -0,0 +1,107 @@
+#include "HeadlessContext.h"
+#include <iostream>
+
+#ifdef MODERNCELT_HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+static GLADapiproc loadEglProc(const char* name) {
+    return reinterpret_cast<GLADapiproc>(eglGetProcAddress(name));
+}
+
+bool HeadlessContext::isSupported() {
+    return true;
+}
+
+bool HeadlessContext::create(int width, int height) {
+    // Prefer the surfaceless platform; it works without X, Wayland or a DRM device
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay) {
+        eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (eglDisplay == EGL_NO_DISPLAY) {
+        eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, NULL, NULL)) {
+        std::cerr << "Failed to initialize EGL." << std::endl;
+        return false;
+    }
+    display = eglDisplay;
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "EGL has no desktop OpenGL support." << std::endl;
+        return false;
+    }
+
+    // No surface at all, so no config either (EGL_KHR_no_config_context)
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext eglContext = eglCreateContext(eglDisplay, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+    if (eglContext == EGL_NO_CONTEXT || !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext)) {
+        std::cerr << "Failed to create a surfaceless OpenGL 3.3 context." << std::endl;
+        return false;
+    }
+    context = eglContext;
+
+    if (!gladLoadGL(loadEglProc)) {
+        std::cerr << "Failed to initialize GLAD." << std::endl;
+        return false;
+    }
+
+    // Offscreen stand-in for the window's back buffer
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        std::cerr << "Headless framebuffer is not complete!" << std::endl;
+        return false;
+    }
+
+    std::cout << "Headless renderer: " << glGetString(GL_RENDERER) << std::endl;
+    return true;
+}
+
+void HeadlessContext::destroy() {
+    if (fbo) glDeleteFramebuffers(1, &fbo);
+    if (colorBuffer) glDeleteRenderbuffers(1, &colorBuffer);
+    if (depthBuffer) glDeleteRenderbuffers(1, &depthBuffer);
+    fbo = colorBuffer = depthBuffer = 0;
+
+    if (display) {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context) eglDestroyContext(display, context);
+        eglTerminate(display);
+    }
+    display = context = nullptr;
+}
+
+#else
+
+bool HeadlessContext::isSupported() {
+    return false;
+}
+
+bool HeadlessContext::create(int, int) {
+    std::cerr << "Headless mode is not available; configure with -DMODERNCELT_HEADLESS=ON." << std::endl;
+    return false;
+}
+
+void HeadlessContext::destroy() {}
+
+#endif
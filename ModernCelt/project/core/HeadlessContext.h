@@ -0,0 +1,26 @@
+#pragma once
+
+#include <glad/gl.h>
+
+// OpenGL 3.3 core context without a window, for display-less benchmark hosts.
+// Uses EGL on Mesa's surfaceless platform (llvmpipe needs neither a display nor
+// a GPU) and renders into an offscreen framebuffer that stands in for the window.
+// Only available when configured with -DMODERNCELT_HEADLESS=ON.
+class HeadlessContext {
+public:
+    static bool isSupported();
+
+    // Create and make current the context, load GL and build the framebuffer
+    bool create(int width, int height);
+    void destroy();
+
+    // Framebuffer to render to instead of the default one
+    GLuint framebuffer() const { return fbo; }
+
+private:
+    void* display = nullptr;
+    void* context = nullptr;
+    GLuint fbo = 0;
+    GLuint colorBuffer = 0;
+    GLuint depthBuffer = 0;
+};
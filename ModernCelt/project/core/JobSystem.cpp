@@ -0,0 +1,197 @@
+#include "JobSystem.h"
+#include "CpuProfiler.h"
+#include <algorithm>
+#include <string>
+
+namespace {
+
+// Index of this thread's deque; non-workers use the shared one
+thread_local int workerIndex = -1;
+
+} // namespace
+
+JobSystem& jobSystem() {
+    static JobSystem system;
+    return system;
+}
+
+void JobSystem::initialize(int workerCount) {
+    if (workerCount <= 0) {
+        workerCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    }
+    stopping = false;
+    for (int i = 0; i <= workerCount; ++i) {
+        queues.emplace_back(new Queue());
+    }
+    for (int i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+void JobSystem::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) worker.join();
+    workers.clear();
+    queues.clear();
+}
+
+void JobSystem::run(std::function<void()> function, JobCounter* counter) {
+    if (counter) counter->value++;
+    Job job{ std::move(function), counter };
+    if (queues.empty()) {
+        execute(job);
+        return;
+    }
+    push(std::move(job));
+}
+
+void JobSystem::runAfter(JobCounter& dependency, std::function<void()> function, JobCounter* counter) {
+    if (counter) counter->value++;
+    {
+        // finish() drops the count and takes the list under this lock, so a
+        // continuation is either registered in time or sees zero here
+        std::lock_guard<std::mutex> lock(dependency.continuationMutex);
+        if (dependency.value.load() > 0) {
+            dependency.continuations.emplace_back(std::move(function), counter);
+            return;
+        }
+    }
+    Job job{ std::move(function), counter };
+    if (queues.empty()) execute(job);
+    else push(std::move(job));
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    int self = workerIndex >= 0 ? workerIndex : static_cast<int>(queues.size()) - 1;
+    while (counter.value.load() > 0) {
+        if (queues.empty() || !tryRunOne(self)) std::this_thread::yield();
+    }
+
+    // The last finish() may still hold the lock; the counter can go once it lets go
+    std::lock_guard<std::mutex> lock(counter.continuationMutex);
+}
+
+void JobSystem::parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body) {
+    if (end <= begin) return;
+    grain = std::max(grain, 1);
+
+    // The caller takes the first chunk itself, then helps with the rest
+    JobCounter counter;
+    for (int chunk = begin + grain; chunk < end; chunk += grain) {
+        int chunkEnd = std::min(chunk + grain, end);
+        run([&body, chunk, chunkEnd] { body(chunk, chunkEnd); }, &counter);
+    }
+    body(begin, std::min(begin + grain, end));
+    wait(counter);
+}
+
+void JobSystem::JobRing::pushBack(Job&& job) {
+    if (count == slots.size()) {
+        // Unroll into a ring twice the size
+        std::vector<Job> grown(std::max<size_t>(slots.size() * 2, 64));
+        for (size_t i = 0; i < count; ++i) grown[i] = std::move(slots[(head + i) & (slots.size() - 1)]);
+        slots.swap(grown);
+        head = 0;
+    }
+    slots[(head + count) & (slots.size() - 1)] = std::move(job);
+    count++;
+}
+
+void JobSystem::JobRing::popBack(Job& job) {
+    count--;
+    job = std::move(slots[(head + count) & (slots.size() - 1)]);
+}
+
+void JobSystem::JobRing::popFront(Job& job) {
+    job = std::move(slots[head]);
+    head = (head + 1) & (slots.size() - 1);
+    count--;
+}
+
+void JobSystem::push(Job job) {
+    int target = workerIndex >= 0 ? workerIndex : static_cast<int>(queues.size()) - 1;
+    {
+        std::lock_guard<std::mutex> lock(queues[target]->mutex);
+        queues[target]->jobs.pushBack(std::move(job));
+    }
+    queued++;
+
+    // Waking needs the sleep lock, so only take it when someone may be asleep
+    if (sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wake.notify_one();
+    }
+}
+
+bool JobSystem::tryRunOne(int self) {
+    Job job;
+    bool found = false;
+
+    // Own work first, newest job
+    {
+        Queue& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            own.jobs.popBack(job);
+            found = true;
+        }
+    }
+
+    // Otherwise steal the oldest job of another queue, starting next to ours
+    int count = static_cast<int>(queues.size());
+    for (int i = 1; i < count && !found; ++i) {
+        Queue& victim = *queues[(self + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            victim.jobs.popFront(job);
+            found = true;
+        }
+    }
+
+    if (!found) return false;
+    queued--;
+    execute(job);
+    return true;
+}
+
+void JobSystem::execute(Job& job) {
+    job.function();
+    finish(job.counter);
+}
+
+void JobSystem::finish(JobCounter* counter) {
+    if (!counter) return;
+
+    // Counters often live on the waiter's stack, so this lock is the last access:
+    // wait() takes it once more before returning
+    std::vector<std::pair<std::function<void()>, JobCounter*>> ready;
+    {
+        std::lock_guard<std::mutex> lock(counter->continuationMutex);
+        if (counter->value.fetch_sub(1) != 1) return;
+        ready.swap(counter->continuations);
+    }
+    for (auto& continuation : ready) {
+        Job job{ std::move(continuation.first), continuation.second };
+        if (queues.empty()) execute(job);
+        else push(std::move(job));
+    }
+}
+
+void JobSystem::workerLoop(int index) {
+    workerIndex = index;
+    std::string name = "Worker " + std::to_string(index);
+    cpuProfiler().setThreadName(name.c_str());
+
+    while (!stopping.load()) {
+        if (tryRunOne(index)) continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleeping++;
+        wake.wait(lock, [this] { return stopping.load() || queued.load() > 0; });
+        sleeping--;
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class JobSystem;
+
+// Counts unfinished jobs. Jobs started with a counter add one to it and remove
+// it when they finish; continuations registered with runAfter() start once it
+// drops to zero. Only reuse a counter after waiting on it.
+class JobCounter {
+public:
+    int pending() const { return value.load(); }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<int> value{ 0 };
+    std::mutex continuationMutex;
+    std::vector<std::pair<std::function<void()>, JobCounter*>> continuations;
+};
+
+// Work-stealing scheduler shared by the whole engine.
+// Every worker owns a deque: it pushes and pops its own jobs at the back (newest
+// first, which keeps the data it just touched in cache), while idle workers steal
+// from the front of someone else's (oldest first, which tends to be the biggest
+// piece of work). Threads that are not workers submit into one extra shared deque.
+// Each deque has its own short lock; workers only sleep when every deque is empty.
+//
+// wait() does not block: the waiting thread runs queued jobs until the counter
+// reaches zero, so jobs may wait on jobs they spawned.
+class JobSystem {
+public:
+    // workerCount 0 starts one worker per hardware thread, less the calling thread.
+    // Before initialize() every job runs inline on the calling thread.
+    void initialize(int workerCount = 0);
+    void shutdown();
+
+    // Start function on any worker
+    void run(std::function<void()> function, JobCounter* counter = nullptr);
+
+    // Start function once dependency has no pending jobs
+    void runAfter(JobCounter& dependency, std::function<void()> function, JobCounter* counter = nullptr);
+
+    // Run jobs until counter reaches zero
+    void wait(JobCounter& counter);
+
+    // Call body(chunkBegin, chunkEnd) over [begin, end) in chunks of at most grain,
+    // spread across the workers; returns once every chunk is done
+    void parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body);
+
+    // Worker threads, not counting threads that help out in wait()
+    int workerCount() const { return static_cast<int>(workers.size()); }
+
+private:
+    struct Job {
+        std::function<void()> function;
+        JobCounter* counter = nullptr;
+    };
+
+    // Double-ended ring of jobs. It grows when full and never shrinks, so once warmed
+    // up it stops allocating, where std::deque allocates and frees blocks as it moves.
+    class JobRing {
+    public:
+        bool empty() const { return count == 0; }
+        void pushBack(Job&& job);
+        void popBack(Job& job);
+        void popFront(Job& job);
+
+    private:
+        std::vector<Job> slots;   // Size is zero or a power of two
+        size_t head = 0;
+        size_t count = 0;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        JobRing jobs;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;   // One per worker, then the shared one
+    std::vector<std::thread> workers;
+    std::atomic<int> queued{ 0 };
+    std::atomic<int> sleeping{ 0 };
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<bool> stopping{ false };
+
+    void push(Job job);
+    bool tryRunOne(int self);
+    void execute(Job& job);
+    void finish(JobCounter* counter);
+    void workerLoop(int index);
+};
+
+JobSystem& jobSystem();
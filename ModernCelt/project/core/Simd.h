@@ -0,0 +1,7 @@
+#pragma once
+
+// SSE2 is part of every x86-64 target; elsewhere the scalar paths are used
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MODERNCELT_SSE 1
+#include <emmintrin.h>
+#endif
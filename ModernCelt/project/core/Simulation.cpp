@@ -0,0 +1,158 @@
+#include "Simulation.h"
+#include "CpuProfiler.h"
+#include <algorithm>
+
+glm::vec3 cameraDirection(float yaw, float pitch) {
+    glm::vec3 direction;
+    direction.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
+    direction.y = sin(glm::radians(pitch));
+    direction.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
+    return glm::normalize(direction);
+}
+
+void interpolateSnapshots(const FrameSnapshot& from, const FrameSnapshot& to, float alpha, FrameSnapshot& out) {
+    out.tick = to.tick;
+    out.time = from.time + (to.time - from.time) * alpha;
+    out.cameraPosition = glm::mix(from.cameraPosition, to.cameraPosition, alpha);
+    out.yaw = glm::mix(from.yaw, to.yaw, alpha);
+    out.pitch = glm::mix(from.pitch, to.pitch, alpha);
+
+    out.characterCount = to.characterCount;
+    for (int i = 0; i < to.characterCount; ++i) {
+        const CharacterSnapshot& a = from.characters[i];
+        const CharacterSnapshot& b = to.characters[i];
+        CharacterSnapshot& c = out.characters[i];
+        c.model = a.model + (b.model - a.model) * alpha;
+        c.jointCount = b.jointCount;
+
+        // Blending skinning matrices directly is fine across a single tick
+        int blended = std::min(a.jointCount, b.jointCount);
+        for (int j = 0; j < blended; ++j) {
+            c.jointMatrices[j] = a.jointMatrices[j] + (b.jointMatrices[j] - a.jointMatrices[j]) * alpha;
+        }
+        for (int j = blended; j < b.jointCount; ++j) c.jointMatrices[j] = b.jointMatrices[j];
+    }
+}
+
+void Simulation::start(const Config& config, const FrameSnapshot& initial, StepFunction step) {
+    this->config = config;
+    stepFunction = std::move(step);
+
+    workingState = initial;
+    workingState.tick = 0;
+    workingState.time = 0.0;
+    stepFunction(workingState, CameraInput(), 0.0);
+    previousState = workingState;
+    currentState = workingState;
+    currentPublishTime = Clock::now();
+    consumedTick = UINT64_MAX;
+    tickCount = 0;
+
+    running = true;
+    if (config.mode != Mode::Serial) {
+        thread = std::thread(&Simulation::threadLoop, this);
+    }
+}
+
+void Simulation::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    published.notify_all();
+    if (thread.joinable()) thread.join();
+}
+
+void Simulation::queueInput(const CameraInput& input) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingInput.forward += input.forward;
+    pendingInput.right += input.right;
+    pendingInput.yaw += input.yaw;
+    pendingInput.pitch += input.pitch;
+    pendingInput.clipSteps += input.clipSteps;
+}
+
+void Simulation::step() {
+    CPU_SCOPE("Simulation step");
+    Clock::time_point begin = Clock::now();
+
+    CameraInput input;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        input = pendingInput;
+        pendingInput = CameraInput();
+    }
+
+    workingState.tick++;
+    workingState.time = workingState.tick * config.timestep;
+    stepFunction(workingState, input, config.timestep);
+
+    tickCount++;
+    stepMs = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+void Simulation::threadLoop() {
+    cpuProfiler().setThreadName("Simulation");
+    Clock::duration timestep = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(config.timestep));
+    Clock::time_point nextTick = Clock::now();
+
+    for (;;) {
+        step();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // Lockstep: stay one tick ahead, publishing only once the renderer has the last one
+            if (config.mode == Mode::Lockstep) {
+                published.wait(lock, [this] { return !running || consumedTick == currentState.tick; });
+            }
+            if (!running) return;
+            previousState = currentState;
+            currentState = workingState;
+            currentPublishTime = Clock::now();
+        }
+        published.notify_all();
+
+        if (config.mode == Mode::RealTime) {
+            nextTick += timestep;
+            Clock::time_point now = Clock::now();
+            if (now - nextTick > timestep * config.maxCatchUpTicks) nextTick = now;
+            std::this_thread::sleep_until(nextTick);
+        }
+    }
+}
+
+float Simulation::acquire(FrameSnapshot& previous, FrameSnapshot& current) {
+    switch (config.mode) {
+    case Mode::Serial:
+        // The first frame shows tick 0, every later frame simulates one tick first
+        if (consumedTick != UINT64_MAX) step();
+        consumedTick = workingState.tick;
+        previous = workingState;
+        current = workingState;
+        return 1.0f;
+
+    case Mode::Lockstep: {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            published.wait(lock, [this] { return currentState.tick != consumedTick; });
+            consumedTick = currentState.tick;
+            current = currentState;
+        }
+        published.notify_all();
+        previous = current;
+        return 1.0f;
+    }
+
+    case Mode::RealTime:
+    default: {
+        Clock::time_point publishTime;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            previous = previousState;
+            current = currentState;
+            publishTime = currentPublishTime;
+        }
+        double elapsed = std::chrono::duration<double>(Clock::now() - publishTime).count();
+        return static_cast<float>(std::min(std::max(elapsed / config.timestep, 0.0), 1.0));
+    }
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "FrameSnapshot.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Fixed-timestep simulation that hands its results to the render thread as snapshots.
+// The step function advances a private copy of the state by one timestep; the result
+// is published as the newest snapshot and never touched again. The render thread
+// takes snapshots with acquire() while the next tick is already being simulated, so
+// a frame costs roughly max(simulation, render) instead of their sum.
+//
+//   RealTime  Ticks follow the wall clock on a simulation thread. acquire() returns
+//             the two newest snapshots and how far to blend between them; the
+//             picture trails the simulation by up to one tick.
+//   Lockstep  One tick per rendered frame, simulated on a thread at most one tick
+//             ahead of the renderer. Frame N always shows tick N, so runs repeat.
+//   Serial    Lockstep on the render thread, for comparison.
+class Simulation {
+public:
+    enum class Mode { RealTime, Lockstep, Serial };
+
+    using StepFunction = std::function<void(FrameSnapshot& state, const CameraInput& input, double dt)>;
+
+    struct Config {
+        Mode mode = Mode::RealTime;
+        double timestep = 1.0 / 60.0;
+        int maxCatchUpTicks = 5;   // RealTime: after falling further behind, drop the backlog
+    };
+
+    // Tick 0 is the initial state run through one zero-length step
+    void start(const Config& config, const FrameSnapshot& initial, StepFunction step);
+    void stop();
+
+    // Render thread: fetch the snapshots for this frame, returning the blend factor
+    // from previous to current (always 1 outside RealTime)
+    float acquire(FrameSnapshot& previous, FrameSnapshot& current);
+
+    // Any thread: camera input, applied on the next tick
+    void queueInput(const CameraInput& input);
+
+    Mode mode() const { return config.mode; }
+    uint64_t ticks() const { return tickCount.load(); }
+    double lastStepMs() const { return stepMs.load(); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Config config;
+    StepFunction stepFunction;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable published;   // New snapshot, or the renderer took one
+    bool running = false;
+
+    // Guarded by mutex
+    FrameSnapshot previousState;
+    FrameSnapshot currentState;
+    Clock::time_point currentPublishTime;
+    uint64_t consumedTick = UINT64_MAX;  // Lockstep: newest tick handed to the renderer
+    CameraInput pendingInput;
+
+    // Owned by whichever thread steps
+    FrameSnapshot workingState;
+
+    std::atomic<uint64_t> tickCount{ 0 };
+    std::atomic<double> stepMs{ 0.0 };
+
+    void step();
+    void threadLoop();
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Bounded lock-free ring for exactly one producer thread and one consumer thread.
+// The producer only writes tail and the consumer only writes head, each publishing
+// with a release store that the other side reads with acquire, so a slot is
+// always filled before it becomes visible and emptied before it is reused.
+// CAPACITY must be a power of two.
+template <typename T, uint32_t CAPACITY>
+class SpscQueue {
+    static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+public:
+    // Producer: false when the ring is full
+    bool push(T value) {
+        uint32_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - headIndex.load(std::memory_order_acquire) == CAPACITY) return false;
+        slots[tail & (CAPACITY - 1)] = std::move(value);
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: false when the ring is empty
+    bool pop(T& value) {
+        uint32_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == tailIndex.load(std::memory_order_acquire)) return false;
+        value = std::move(slots[head & (CAPACITY - 1)]);
+        headIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Either side; only a snapshot while the other side is running
+    bool empty() const {
+        return headIndex.load(std::memory_order_acquire) == tailIndex.load(std::memory_order_acquire);
+    }
+
+private:
+    // Each index on its own cache line so the two threads do not contend
+    alignas(64) std::atomic<uint32_t> headIndex{ 0 };
+    alignas(64) std::atomic<uint32_t> tailIndex{ 0 };
+    T slots[CAPACITY];
+};
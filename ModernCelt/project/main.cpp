@@ -3,45 +3,92 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <stb_image_write.h>
+#include <filesystem>
+#include <vector>
 
 #include "Building.h"
 #include "Skybox.h"
 #include "Terrain.h"
 #include "render/shader.h"
+#include "render/GLState.h"
+#include "render/GpuProfiler.h"
+#include "render/DebugOverlay.h"
+#include "render/ShadowCascades.h"
+#include "render/AsyncReadback.h"
+#include "render/OcclusionQueries.h"
+#include "render/TextureLoader.h"
+#include "core/HeadlessContext.h"
+#include "core/CameraPath.h"
+#include "core/BenchmarkReport.h"
+#include "core/CpuProfiler.h"
+#include "core/Simulation.h"
+#include "core/JobSystem.h"
+#include "core/FrameArena.h"
+#include "core/AllocationTracker.h"
+#include "scene/EntityStore.h"
+#include "scene/OcclusionCuller.h"
+#include "anim/PoseCache.h"
 #include "Character.h"
 #include "IrishPub.h"
 #include "stb_image.h"
 
 // Global variables
-GLFWwindow* window;
+GLFWwindow* window = nullptr;
+static bool headless = false;          // Rendering offscreen without a window
+static GLuint screenFramebuffer = 0;   // Window back buffer, or the headless offscreen target
 static bool playAnimation = true;       // Animation playback toggle
 static float playbackSpeed = 1.0f;     // Playback speed for animations
-static float characterTime = 0.0f;     // Tracks time for character animation
-static double lastTime = glfwGetTime(); // Last frame's time
+static float characterTime = 0.0f;     // Tracks time for character animation (simulation thread)
+static int characterClip = 0;          // Clip the characters crossfade to (simulation thread)
 static bool saveDepth = false;         // Save depth map flag
-
-// Camera variables
+static bool dumpGpuProfile = false;    // Write GPU timings to CSV flag
+static bool captureFrames = false;     // Write every frame to capture/ flag
+static bool dumpCpuTrace = false;      // Write recent CPU scopes as a Chrome trace flag
+static bool occlusionCulling = true;   // Hide objects behind the biggest buildings (CPU depth buffer)
+static bool occlusionQueries = true;   // Hide objects with GPU occlusion queries
+static bool dumpTextureResidency = false; // Print each texture's resident mips flag
+static int captureIndex = 0;           // Next capture frame number
+
+// Camera variables; the simulation owns the camera, these are its starting values
 static glm::vec3 cameraPos = glm::vec3(0.0f, 10.0f, 75.0f); // Camera position
-static glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f); // Camera direction
 static float yaw = -90.0f;             // Yaw for camera rotation
 static float pitch = 0.0f;             // Pitch for camera rotation
 static glm::vec3 up(0, 1, 0);          // Up direction for camera
 
+// Fixed-timestep camera and character updates, published to the renderer as snapshots
+static Simulation simulation;
+
 // Lighting variables
 const glm::vec3 wave500(0.0f, 255.0f, 146.0f);
 const glm::vec3 wave600(255.0f, 190.0f, 0.0f);
 const glm::vec3 wave700(205.0f, 0.0f, 0.0f);
 static glm::vec3 lightPosition(-200.0f, 100.0f, 200.0f); // Light source position
+static glm::vec3 lightTarget(-10.0f, 0.0f, -20.0f);      // Point the shadow-casting light aims at
 static glm::vec3 lightIntensity = 3.0f * (wave500 + wave600 + wave700); // Light intensity
 
 // Shadow mapping variables
-static GLuint depthMapFBO;             // Framebuffer object for depth map
-static GLuint depthMap;                // Texture for depth map
-const GLuint SHADOW_WIDTH = 4096;      // Shadow map width
-const GLuint SHADOW_HEIGHT = 4096;     // Shadow map height
+static ShadowCascades shadowCascades;  // Depth maps fitted to slices of the view frustum
 static GLuint depthShaderProg;         // Shader program for depth rendering
+static const char* cascadeScopeNames[ShadowCascades::MAX_CASCADES] = { "Cascade 0", "Cascade 1", "Cascade 2", "Cascade 3" };
+
+// Camera projection
+const float cameraFov = glm::radians(60.0f);
+const float cameraAspect = 1024.0f / 768.0f;
+const float cameraNear = 0.1f;
+
+// Window / offscreen size
+const int screenWidth = 1024;
+const int screenHeight = 768;
+
+// Simulation tick length; headless runs also render exactly one tick per frame
+const double fixedTimestep = 1.0 / 60.0;
+
+using Clock = std::chrono::steady_clock;
 
 // FPS counter variables
 static int frameCount = 0;
@@ -50,131 +97,243 @@ static double fps = 0.0;
 
 // Key callback function to handle user input
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    AllowAllocations allow; // Key presses are rare and may print or create directories
     if (key == GLFW_KEY_SPACE && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
         saveDepth = true; // Trigger saving depth map
     }
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, GL_TRUE); // Close the window
     }
+    if (key == GLFW_KEY_F1 && action == GLFW_PRESS) {
+        debugOverlay().visible = !debugOverlay().visible; // Toggle stats overlay
+    }
+    if (key == GLFW_KEY_F2 && action == GLFW_PRESS) {
+        dumpGpuProfile = true; // Trigger GPU profile CSV dump
+    }
+    if (key == GLFW_KEY_F3 && action == GLFW_PRESS) {
+        captureFrames = !captureFrames; // Toggle image sequence capture
+        if (captureFrames) std::filesystem::create_directories("capture");
+        std::cout << "Frame capture " << (captureFrames ? "started" : "stopped") << std::endl;
+    }
+    if (key == GLFW_KEY_F4 && action == GLFW_PRESS) {
+        dumpCpuTrace = true; // Trigger CPU trace dump
+    }
+    if (key == GLFW_KEY_F5 && action == GLFW_PRESS) {
+        occlusionCulling = !occlusionCulling; // Toggle CPU occlusion culling
+        std::cout << "Occlusion culling " << (occlusionCulling ? "on" : "off") << std::endl;
+    }
+    if (key == GLFW_KEY_F6 && action == GLFW_PRESS) {
+        occlusionQueries = !occlusionQueries; // Toggle hardware occlusion queries
+        std::cout << "Occlusion queries " << (occlusionQueries ? "on" : "off") << std::endl;
+    }
+    if (key == GLFW_KEY_F7 && action == GLFW_PRESS) {
+        dumpTextureResidency = true; // Trigger texture residency listing
+    }
 
+    // Camera moves and clip changes are queued and applied by the simulation on its next tick
+    CameraInput input;
+    if (key == GLFW_KEY_F8 && action == GLFW_PRESS) {
+        input.clipSteps = 1; // Crossfade the characters to their next clip
+        std::cout << "Characters crossfading to the next clip" << std::endl;
+    }
     float cameraSpeed = 1.0f; // Movement speed
+    bool pressed = action == GLFW_PRESS || action == GLFW_REPEAT;
+    if (!pressed) return;
+
     // Camera movement controls
-    if (key == GLFW_KEY_W && (action == GLFW_PRESS || action == GLFW_REPEAT))
-        cameraPos += cameraSpeed * cameraFront;
-    if (key == GLFW_KEY_S && (action == GLFW_PRESS || action == GLFW_REPEAT))
-        cameraPos -= cameraSpeed * cameraFront;
-    if (key == GLFW_KEY_A && (action == GLFW_PRESS || action == GLFW_REPEAT))
-        cameraPos -= glm::normalize(glm::cross(cameraFront, up)) * cameraSpeed;
-    if (key == GLFW_KEY_D && (action == GLFW_PRESS || action == GLFW_REPEAT))
-        cameraPos += glm::normalize(glm::cross(cameraFront, up)) * cameraSpeed;
+    if (key == GLFW_KEY_W) input.forward += cameraSpeed;
+    if (key == GLFW_KEY_S) input.forward -= cameraSpeed;
+    if (key == GLFW_KEY_A) input.right -= cameraSpeed;
+    if (key == GLFW_KEY_D) input.right += cameraSpeed;
 
     // Camera rotation controls
-    if (key == GLFW_KEY_UP && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
-        pitch += 2.0f;
-        if (pitch > 89.0f) pitch = 89.0f;
-    }
-    if (key == GLFW_KEY_DOWN && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
-        pitch -= 2.0f;
-        if (pitch < -89.0f) pitch = -89.0f;
+    if (key == GLFW_KEY_UP) input.pitch += 2.0f;
+    if (key == GLFW_KEY_DOWN) input.pitch -= 2.0f;
+    if (key == GLFW_KEY_LEFT) input.yaw -= 2.0f;
+    if (key == GLFW_KEY_RIGHT) input.yaw += 2.0f;
+
+    simulation.queueInput(input);
+}
+
+// Read shadow settings from the command line, e.g. --cascades 4 --shadow-resolution 1024 --no-shadow-cache
+ShadowCascades::Config parseShadowConfig(int argc, char* argv[]) {
+    ShadowCascades::Config config;
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--cascades") == 0 && hasValue) {
+            config.cascadeCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shadow-resolution") == 0 && hasValue) {
+            config.resolution = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shadow-distance") == 0 && hasValue) {
+            config.maxDistance = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--no-shadow-cache") == 0) {
+            config.cacheStatic = false;
+        }
     }
-    if (key == GLFW_KEY_LEFT && (action == GLFW_PRESS || action == GLFW_REPEAT))
-        yaw -= 2.0f;
-    if (key == GLFW_KEY_RIGHT && (action == GLFW_PRESS || action == GLFW_REPEAT))
-        yaw += 2.0f;
-
-    // Update camera direction based on yaw and pitch
-    glm::vec3 direction;
-    direction.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
-    direction.y = sin(glm::radians(pitch));
-    direction.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
-    cameraFront = glm::normalize(direction);
+    return config;
 }
 
-// Function to save the depth texture as an image
-void saveDepthTexture(GLuint fbo, std::string filename) {
-    int width = SHADOW_WIDTH;
-    int height = SHADOW_HEIGHT;
-    int channels = 1;
-
-    std::vector<float> depth(width * height);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // Convert depth values to grayscale image
-    std::vector<unsigned char> img(width * height);
-    for (int i = 0; i < width * height; ++i) {
-        img[i] = static_cast<unsigned char>(depth[i] * 255);
+// Benchmark settings, e.g. --headless --camera-path ../project/paths/flythrough.txt --frames 600
+struct RunOptions {
+    bool headless = false;
+    std::string cameraPath;   // Drive the camera from this file instead of the keyboard
+    int frames = 0;           // Stop after this many frames; 0 runs until closed
+    int warmupFrames = 10;    // Frames left out of the report's statistics
+    std::string reportPath;   // Write a JSON benchmark report here
+    double hitchBudgetMs = -1.0;  // Dump a CPU trace when a frame runs longer; 0 disables
+    int hitchFrames = 30;         // Frames per hitch dump
+    bool serialSimulation = false; // Simulate on the render thread, one tick per frame
+    bool occlusionCulling = true;
+    bool occlusionQueries = true;
+    bool textureCompression = true;
+    bool textureStreaming = true;
+    int textureBudgetMB = 64;   // GPU memory for textures before finer mips are evicted
+    bool failOnAllocation = false; // Abort on any heap allocation once warm-up is over
+    bool animationCompression = true;
+    bool vertexQuantization = true;   // Characters' vertices packed to 24 bytes at load
+    bool meshOptimization = true;     // Reorder triangles and vertices for the GPU at load
+    bool overdrawOptimization = true; // Characters' triangles also ordered for overdraw
+    bool poseCache = true;         // Characters at the same pose share one evaluation
+    int characterClip = 0;         // Clip the characters start with
+};
+
+RunOptions parseRunOptions(int argc, char* argv[]) {
+    RunOptions options;
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--headless") == 0) {
+            options.headless = true;
+        } else if (strcmp(argv[i], "--camera-path") == 0 && hasValue) {
+            options.cameraPath = argv[++i];
+        } else if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+            options.frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && hasValue) {
+            options.warmupFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--report") == 0 && hasValue) {
+            options.reportPath = argv[++i];
+        } else if (strcmp(argv[i], "--serial-simulation") == 0) {
+            options.serialSimulation = true;
+        } else if (strcmp(argv[i], "--hitch-budget") == 0 && hasValue) {
+            options.hitchBudgetMs = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--hitch-frames") == 0 && hasValue) {
+            options.hitchFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-occlusion") == 0) {
+            options.occlusionCulling = false;
+        } else if (strcmp(argv[i], "--no-occlusion-queries") == 0) {
+            options.occlusionQueries = false;
+        } else if (strcmp(argv[i], "--no-texture-compression") == 0) {
+            options.textureCompression = false;
+        } else if (strcmp(argv[i], "--fail-on-allocation") == 0) {
+            options.failOnAllocation = true;
+        } else if (strcmp(argv[i], "--no-texture-streaming") == 0) {
+            options.textureStreaming = false;
+        } else if (strcmp(argv[i], "--texture-budget") == 0 && hasValue) {
+            options.textureBudgetMB = std::max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--no-animation-compression") == 0) {
+            options.animationCompression = false;
+        } else if (strcmp(argv[i], "--no-vertex-quantization") == 0) {
+            options.vertexQuantization = false;
+        } else if (strcmp(argv[i], "--no-mesh-optimization") == 0) {
+            options.meshOptimization = false;
+        } else if (strcmp(argv[i], "--no-overdraw-optimization") == 0) {
+            options.overdrawOptimization = false;
+        } else if (strcmp(argv[i], "--no-pose-cache") == 0) {
+            options.poseCache = false;
+        } else if (strcmp(argv[i], "--character-clip") == 0 && hasValue) {
+            options.characterClip = std::max(atoi(argv[++i]), 0);
+        }
+    }
+
+    // Headless runs are benchmarks: bounded and always reported
+    if (options.headless) {
+        if (options.frames <= 0) options.frames = 600;
+        if (options.reportPath.empty()) options.reportPath = "benchmark_report.json";
     }
 
-    stbi_write_png(filename.c_str(), width, height, channels, img.data(), width * channels);
+    // Software-rendered benchmark frames would all count as hitches, so only detect them when asked
+    if (options.hitchBudgetMs < 0.0) options.hitchBudgetMs = options.headless ? 0.0 : 100.0;
+    return options;
 }
 
-// Initialize shadow map resources
-void initializeShadowMap() {
-    // Generate framebuffer
-    glGenFramebuffers(1, &depthMapFBO);
-
-    // Create depth texture
-    glGenTextures(1, &depthMap);
-    glBindTexture(GL_TEXTURE_2D, depthMap);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT,
-                 SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-
-    // Configure texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
-    // Attach depth texture to framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-
-    // Check framebuffer status
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "Shadow Framebuffer is not complete!" << std::endl;
+// One line per texture: resident levels against the whole chain
+static void printTextureResidency() {
+    std::vector<TextureLoader::Residency> textures;
+    textureLoader().residency(textures);
+    for (const TextureLoader::Residency& texture : textures) {
+        printf("%8.1f / %8.1f KB  mips %d-%d of %d (wanted %d)  %dx%d  %s\n", texture.residentBytes / 1024.0,
+               texture.fullBytes / 1024.0, texture.baseLevel, texture.levelCount - 1, texture.levelCount,
+               texture.wantedLevel, texture.width, texture.height, texture.key.c_str());
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-int main() {
-    // Initialize GLFW
-    if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW." << std::endl;
-        return -1;
-    }
+// Milliseconds since mark, moving mark to now
+static double millisecondsSince(Clock::time_point& mark) {
+    Clock::time_point now = Clock::now();
+    double ms = std::chrono::duration<double, std::milli>(now - mark).count();
+    mark = now;
+    return ms;
+}
 
-    // Configure GLFW context
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+int main(int argc, char* argv[]) {
+    Clock::time_point launchTime = Clock::now();
+    RunOptions options = parseRunOptions(argc, argv);
+    headless = options.headless;
 
-    // Create window
-    window = glfwCreateWindow(1024, 768, "Terrain and Buildings", nullptr, nullptr);
-    if (!window) {
-        std::cerr << "Failed to open GLFW window." << std::endl;
-        glfwTerminate();
-        return -1;
+    HeadlessContext headlessContext;
+    if (headless) {
+        if (!headlessContext.create(screenWidth, screenHeight)) {
+            return -1;
+        }
+        screenFramebuffer = headlessContext.framebuffer();
+    } else {
+        // Initialize GLFW
+        if (!glfwInit()) {
+            std::cerr << "Failed to initialize GLFW." << std::endl;
+            return -1;
+        }
+
+        // Configure GLFW context
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+        // Create window
+        window = glfwCreateWindow(screenWidth, screenHeight, "Terrain and Buildings", nullptr, nullptr);
+        if (!window) {
+            std::cerr << "Failed to open GLFW window." << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+
+        glfwMakeContextCurrent(window);
+
+        // Load OpenGL functions using GLAD
+        if (!gladLoadGL(glfwGetProcAddress)) {
+            std::cerr << "Failed to initialize GLAD." << std::endl;
+            return -1;
+        }
+
+        glfwSetKeyCallback(window, key_callback); // Set key callback
     }
 
-    glfwMakeContextCurrent(window);
+    CpuProfiler::Config profilerConfig;
+    profilerConfig.hitchBudgetMs = options.hitchBudgetMs;
+    profilerConfig.hitchFrames = std::max(options.hitchFrames, 1);
+    cpuProfiler().configure(profilerConfig);
+    cpuProfiler().setThreadName("Main");
 
-    // Load OpenGL functions using GLAD
-    if (!gladLoadGL(glfwGetProcAddress)) {
-        std::cerr << "Failed to initialize GLAD." << std::endl;
+    CameraPath cameraPath;
+    if (!options.cameraPath.empty() && !cameraPath.load(options.cameraPath)) {
         return -1;
     }
-
-    glfwSetKeyCallback(window, key_callback); // Set key callback
+    BenchmarkReport report;
+    report.warmupFrames = options.warmupFrames;
+    bool benchmarking = !options.reportPath.empty();
+    if (benchmarking) report.reserve(options.frames > 0 ? options.frames : 36000);   // Open-ended runs: ten minutes at 60 Hz
 
     // Enable depth testing and face culling
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    glState().enable(GL_DEPTH_TEST);
+    glState().enable(GL_CULL_FACE);
 
     // Load shaders
     GLuint shaderProgram = LoadShadersFromFile("../project/terrain.vert", "../project/terrain.frag");
@@ -184,13 +343,42 @@ int main() {
     }
 
     // Initialize objects and resources
-    initializeShadowMap();
+    if (!shadowCascades.initialize(parseShadowConfig(argc, argv))) {
+        std::cerr << "Failed to create shadow cascades." << std::endl;
+        return -1;
+    }
+    std::cout << "Shadow cascades: " << shadowCascades.count() << " x " << shadowCascades.resolution() << "^2" << std::endl;
     depthShaderProg = LoadShadersFromFile("../project/depth.vert", "../project/depth.frag");
+    gpuProfiler().initialize();
+    asyncReadback().initialize();
+    debugOverlay().initialize();
+
+    jobSystem().initialize();
+    TextureLoader::Config textureConfig;
+    textureConfig.compress = options.textureCompression;
+    textureConfig.streaming = options.textureStreaming;
+    textureConfig.residentBudget = size_t(options.textureBudgetMB) << 20;
+    textureLoader().initialize(textureConfig);
+
+    PoseCache::Config poseCacheConfig;
+    poseCacheConfig.enabled = options.poseCache;
+    poseCache().initialize(poseCacheConfig);
+    characterClip = options.characterClip;
+
+    // Parse the character models on the workers while the GL-side assets load here
+    MyBot character1, character2;
+    character1.compressAnimation = character2.compressAnimation = options.animationCompression;
+    character1.quantizeVertices = character2.quantizeVertices = options.vertexQuantization;
+    character1.optimizeMeshes = character2.optimizeMeshes = options.meshOptimization;
+    character1.reorderForOverdraw = character2.reorderForOverdraw = options.overdrawOptimization;
+    JobCounter charactersLoaded;
+    jobSystem().run([&character1] { character1.loadAsset(); }, &charactersLoaded);
+    jobSystem().run([&character2] { character2.loadAsset(); }, &charactersLoaded);
 
     Skybox skybox;
     skybox.initialize(glm::vec3(0.0f), glm::vec3(500.0f));
 
-    Terrain terrain(500, 500, shaderProgram, glm::vec3(0.0f, 0.0f, 0.0f));
+    Terrain terrain(500, 500, shaderProgram, glm::vec3(0.0f, 0.0f, 0.0f), options.meshOptimization);
 
     GLuint terrainTexture = LoadTextureTileBox("../project/textures/Grass_01.png");
     GLuint terrainSampler = glGetUniformLocation(shaderProgram, "terrainTexture");
@@ -200,117 +388,553 @@ int main() {
     GLuint pubside = LoadTextureTileBox("../project/textures/facade3.jpg");
     GLuint pubfront = LoadTextureTileBox("../project/textures/pub1.jpg");
 
-    MyBot character1, character2;
+    jobSystem().wait(charactersLoaded);
     character1.initialize();
     character2.initialize();
 
     Building building;
     IrishPub pub;
-    building.initialize(glm::vec3(0.0f, 6.0f, 0.0f), glm::vec3(5.0f, 40.0f, 5.0f), buildingTexture1);
-    pub.initialize(glm::vec3(-10.0f, -5.0f, -35.0f), glm::vec3(12.0f, 16.0f, 5.0f), pubfront, pubside, lightPosition, lightIntensity);
-
-    glm::mat4 projectionMatrix = glm::perspective(glm::radians(60.0f), 1024.0f / 768.0f, 0.1f, 1000.0f);
+    building.initialize(buildingTexture1);
+    pub.initialize(pubfront, pubside, lightPosition, lightIntensity);
+
+    // Shadow casters share one depth program; receivers read the cascade uniform block
+    terrain.setDepthProgram(depthShaderProg);
+    building.setDepthProgram(depthShaderProg);
+    pub.setDepthProgram(depthShaderProg);
+    shadowCascades.attachProgram(shaderProgram);
+    shadowCascades.attachProgram(building.programID);
+    shadowCascades.attachProgram(pub.programID);
+    glm::vec3 lightDirection = glm::normalize(lightTarget - lightPosition);
+
+    glm::mat4 projectionMatrix = glm::perspective(cameraFov, cameraAspect, cameraNear, 1000.0f);
+
+    // Everything in the scene is an entity; its renderable indexes one of these lists
+    Building* buildings[] = { &building };
+    IrishPub* pubs[] = { &pub };
+    MyBot* characters[] = { &character1, &character2 };
+
+    // Terrain tiles are entities of their own so they cull independently
+    EntityStore entities;
+    std::vector<Entity> terrainTiles;
+    for (int tile = 0; tile < terrain.tileCount(); ++tile) {
+        Entity entity = entities.create();
+        entities.setLocalBounds(entity, terrain.tileBounds(tile));
+        entities.setRenderable(entity, Renderable{ RenderKind::Terrain, uint32_t(tile) });
+        terrainTiles.push_back(entity);
+    }
+    uint32_t terrainRevision = terrain.getRevision();
+
+    Entity buildingEntity = entities.create(glm::vec3(0.0f, 6.0f, 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(5.0f, 40.0f, 5.0f));
+    entities.setLocalBounds(buildingEntity, Building::localBounds());
+    entities.setRenderable(buildingEntity, Renderable{ RenderKind::Building, 0, true, true, true });
+
+    Entity pubEntity = entities.create(glm::vec3(-10.0f, -5.0f, -35.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(12.0f, 16.0f, 5.0f));
+    entities.setLocalBounds(pubEntity, Building::localBounds());
+    entities.setRenderable(pubEntity, Renderable{ RenderKind::Pub, 0, true, true, true });
+
+    // Characters stand still; their pose comes from the simulation, so the store only
+    // supplies the placement, bounds covering the whole clip, and the snapshot slot
+    float characterGround = terrain.getHeight(-47 + 250, -47 + 250);
+    glm::quat characterFacing = glm::angleAxis(glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::vec3 characterPositions[] = { glm::vec3(-15.0f, characterGround, -15.0f), glm::vec3(-5.0f, characterGround, -20.0f) };
+    for (int i = 0; i < 2; ++i) {
+        Entity character = entities.create(characterPositions[i], characterFacing, glm::vec3(0.05f));
+        entities.setLocalBounds(character, characters[i]->localBounds());
+        entities.setRenderable(character, Renderable{ RenderKind::Character, uint32_t(i), true, false });
+        entities.setAnimator(character, Animator{ i });
+    }
+    entities.updateTransforms();
+
+    FrameSnapshot initialState;
+    initialState.cameraPosition = cameraPos;
+    initialState.yaw = yaw;
+    initialState.pitch = pitch;
+    for (int i = 0; i < entities.count(); ++i) {
+        int slot = entities.animatorAt(i).character;
+        if (slot < 0) continue;
+        initialState.characters[slot].model = entities.worldMatrixAt(i);
+        initialState.characterCount = std::max(initialState.characterCount, slot + 1);
+    }
 
-    // Main loop
-    while (!glfwWindowShouldClose(window)) {
-        // First pass: Render depth from light's perspective
-        glm::mat4 lightProjection = glm::ortho(-200.0f, 200.0f, -200.0f, 200.0f, 1.0f, 1000.0f);
-        glm::mat4 lightView = glm::lookAt(lightPosition, glm::vec3(-10.0f, 0.0f, -20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 lightSpaceMatrix = lightProjection * lightView;
+    // One simulation tick: camera (scripted or from input), then character animation.
+    // Runs on the simulation thread; it may only touch CPU-side state.
+    auto simulate = [&](FrameSnapshot& state, const CameraInput& input, double dt) {
+        if (!cameraPath.empty()) {
+            // Scripted flythrough overrides the keyboard camera
+            CameraPath::Key key = cameraPath.sample(static_cast<float>(state.time));
+            state.cameraPosition = key.position;
+            state.yaw = key.yaw;
+            state.pitch = key.pitch;
+        } else {
+            state.yaw += input.yaw;
+            state.pitch = glm::clamp(state.pitch + input.pitch, -89.0f, 89.0f);
+            glm::vec3 front = cameraDirection(state.yaw, state.pitch);
+            state.cameraPosition += input.forward * front + input.right * glm::normalize(glm::cross(front, up));
+        }
 
-        // Render to depth map
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
+        characterClip += input.clipSteps;
+        if (playAnimation) {
+            characterTime += float(dt) * playbackSpeed;
+            poseCache().beginFrame();
+            for (MyBot* character : characters) character->play(characterClip, characterTime);
+            JobCounter animated;
+            for (MyBot* character : characters) {
+                jobSystem().run([character] { character->update(characterTime); }, &animated);
+            }
+            jobSystem().wait(animated);
+        }
+        for (int i = 0; i < state.characterCount; ++i) {
+            CharacterSnapshot& snapshot = state.characters[i];
+            snapshot.jointCount = characters[i]->copyJointMatrices(snapshot.jointMatrices, CharacterSnapshot::MAX_JOINTS);
+        }
+    };
+
+    // Windowed runs simulate in real time; headless runs stay in lockstep so they repeat exactly
+    Simulation::Config simulationConfig;
+    simulationConfig.timestep = fixedTimestep;
+    simulationConfig.mode = options.serialSimulation ? Simulation::Mode::Serial
+                          : headless ? Simulation::Mode::Lockstep : Simulation::Mode::RealTime;
+    simulation.start(simulationConfig, initialState, simulate);
+    FrameSnapshot previousState, currentState, frameState;
+    int transformsUpdated = 0;
+
+    // Culling results, reused every frame
+    struct CullStats {
+        int visible = 0;
+        int culled = 0;
+    };
+    CullStats cameraCull, shadowCull;
+    OcclusionCuller occlusionCuller;
+    occlusionCuller.initialize(OcclusionCuller::Config());
+    occlusionCulling = options.occlusionCulling;
+    OcclusionQueries hardwareOcclusion;
+    hardwareOcclusion.initialize(OcclusionQueries::Config(), depthShaderProg);
+    occlusionQueries = options.occlusionQueries;
+    std::vector<int> visible;
+    std::vector<int> deferred;
+    std::vector<int> visibleTiles;
+    visible.reserve(entities.count());   // Full size now, so no frame grows them
+    deferred.reserve(entities.count());
+    visibleTiles.reserve(entities.count());
+
+    // Entities inside the frustum from the given trees; shadow passes drop non-casters
+    auto cullEntities = [&](const Frustum& frustum, int sets, bool castersOnly, CullStats& stats) {
+        visible.clear();
+        int found = entities.cull(frustum, sets, visible);
+        stats.visible += found;
+        stats.culled += entities.cullableCount(sets) - found;
+        if (castersOnly) {
+            visible.erase(std::remove_if(visible.begin(), visible.end(),
+                                         [&](int i) { return !entities.renderableAt(i).castsShadow; }), visible.end());
+        }
+    };
+
+    // Visible terrain tiles go out in one call. Static entities draw with their own
+    // world matrix, characters with the interpolated snapshot.
+    auto gatherTerrainTiles = [&]() {
+        visibleTiles.clear();
+        for (int i : visible) {
+            if (entities.renderableAt(i).kind == RenderKind::Terrain) visibleTiles.push_back(int(entities.renderableAt(i).resource));
+        }
+    };
+    auto drawVisibleDepth = [&](const glm::mat4& lightSpaceMatrix) {
+        gatherTerrainTiles();
+        if (!visibleTiles.empty()) terrain.renderDepth(lightSpaceMatrix, visibleTiles.data(), int(visibleTiles.size()));
+        for (int i : visible) {
+            const Renderable& renderable = entities.renderableAt(i);
+            switch (renderable.kind) {
+            case RenderKind::Building:
+                buildings[renderable.resource]->renderDepth(lightSpaceMatrix, entities.worldMatrixAt(i));
+                break;
+            case RenderKind::Pub:
+                pubs[renderable.resource]->renderDepth(lightSpaceMatrix, entities.worldMatrixAt(i));
+                break;
+            case RenderKind::Character: {
+                const CharacterSnapshot& pose = frameState.characters[entities.animatorAt(i).character];
+                characters[renderable.resource]->renderDepth(lightSpaceMatrix * pose.model, pose.jointMatrices, pose.jointCount);
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    };
 
-        glUseProgram(depthShaderProg);
-        glUniformMatrix4fv(glGetUniformLocation(depthShaderProg, "lightSpaceMatrix"), 1, GL_FALSE, glm::value_ptr(lightSpaceMatrix));
+    // Headless runs must repeat exactly, so they do not start with placeholders
+    if (headless) textureLoader().finish();
+    bool texturesReported = false;
 
-        terrain.renderDepth(lightSpaceMatrix);
-        building.renderDepth(lightSpaceMatrix);
-        pub.renderDepth(lightSpaceMatrix);
+    Clock::time_point startTime = Clock::now();
+    uint64_t allocationMark = allocationCount();
+    uint64_t frameAllocations = 0;   // Heap allocations during the last frame, on every thread
 
-        if (saveDepth) {
-            std::string filename = "depth_map.png";
-            saveDepthTexture(depthMapFBO, filename);
-            std::cout << "Depth texture saved to " << filename << std::endl;
-            saveDepth = false;
+    // Main loop
+    for (int frame = 0; options.frames <= 0 || frame < options.frames; ++frame) {
+        if (!headless && glfwWindowShouldClose(window)) break;
+        Clock::time_point frameStart = Clock::now();
+        Clock::time_point passMark = frameStart;
+
+        // Warm-up is over: from here on frames must not touch the heap
+        if (options.failOnAllocation && frame == options.warmupFrames) {
+            std::cout << "Allocation guard armed at frame " << frame << std::endl;
+            setAllocationGuard(true);
         }
+        threadArena().reset();
 
-        // Second pass: Normal rendering
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glViewport(0, 0, 1024, 768);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        cpuProfiler().beginFrame();
+        glState().beginFrame();
+        gpuProfiler().beginFrame();
+        textureLoader().update();
+
+        // Latest simulated state, blended between the last two ticks
+        float blend;
+        {
+            CPU_SCOPE("Acquire snapshot");
+            blend = simulation.acquire(previousState, currentState);
+            interpolateSnapshots(previousState, currentState, blend, frameState);
+        }
+        if (benchmarking) report.addPass("Acquire snapshot", millisecondsSince(passMark));
 
-        glm::mat4 viewMatrix = glm::lookAt(cameraPos, cameraPos + cameraFront, up);
+        glm::vec3 cameraPosition = frameState.cameraPosition;
+        glm::vec3 cameraFront = cameraDirection(frameState.yaw, frameState.pitch);
+        glm::mat4 viewMatrix = glm::lookAt(cameraPosition, cameraPosition + cameraFront, up);
         glm::mat4 mvpMatrix = projectionMatrix * viewMatrix;
         glm::mat4 viewNoTranslation = glm::mat4(glm::mat3(viewMatrix));
         glm::mat4 mvp = projectionMatrix * viewNoTranslation;
 
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-
-        glUseProgram(shaderProgram);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "MVP"), 1, GL_FALSE, &mvpMatrix[0][0]);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "lightSpaceMatrix"), 1, GL_FALSE, glm::value_ptr(lightSpaceMatrix));
-        glUniform1i(glGetUniformLocation(shaderProgram, "shadowMap"), 1);
-
-        terrain.updateTerrain(cameraPos);
-        terrain.render(mvpMatrix, lightPosition, lightIntensity, lightSpaceMatrix);
-        building.render(mvpMatrix, lightPosition, lightIntensity, lightSpaceMatrix);
-        pub.render(mvpMatrix, lightSpaceMatrix);
-
-        double currentTime = glfwGetTime();
-        float deltaTime = float(currentTime - lastTime);
-        lastTime = currentTime;
-
-        if (playAnimation) {
-            characterTime += deltaTime * playbackSpeed;
-            character1.update(characterTime);
-            character2.update(characterTime);
+        // The terrain patch may move with the camera, so update it before fitting shadows
+        {
+            CPU_SCOPE("Terrain update");
+            terrain.updateTerrain(cameraPosition);
+            if (terrain.getRevision() != terrainRevision) {
+                terrainRevision = terrain.getRevision();
+                for (int tile = 0; tile < terrain.tileCount(); ++tile) {
+                    entities.setLocalBounds(terrainTiles[tile], terrain.tileBounds(tile));
+                }
+            }
+            transformsUpdated = entities.updateTransforms();
         }
+        if (benchmarking) report.addPass("Terrain update", millisecondsSince(passMark));
 
-        glm::mat4 characterModelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(-15.0f, terrain.getHeight(-47 + 250, -47 + 250), -15.0f));
-        characterModelMatrix = glm::rotate(characterModelMatrix, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        characterModelMatrix = glm::scale(characterModelMatrix, glm::vec3(0.05f));
-        glm::mat4 characterMVP = mvpMatrix * characterModelMatrix;
-        character1.render(characterMVP);
+        // First pass: render each cascade from the light's perspective
+        shadowCascades.update(viewMatrix, cameraFov, cameraAspect, cameraNear, lightDirection);
+        shadowCascades.setStaticRevision(entities.staticRevision());
+        cameraCull = CullStats();
+        shadowCull = CullStats();
+        {
+            GPU_SCOPE("Shadow pass");
+            CPU_SCOPE("Shadow pass");
+            // Casters between the light and a cascade's near plane are clamped instead of clipped
+            glState().enable(GL_DEPTH_CLAMP);
+            for (int c = 0; c < shadowCascades.count(); ++c) {
+                gpuProfiler().push(cascadeScopeNames[c]);
+                CPU_SCOPE(cascadeScopeNames[c]);
+                const glm::mat4& cascadeMatrix = shadowCascades.lightSpaceMatrix(c);
+                Frustum casterFrustum = shadowCascades.casterFrustum(c);
+
+                // Static casters only when the cached layer is stale
+                if (shadowCascades.beginStatic(c)) {
+                    cullEntities(casterFrustum, EntityStore::CULL_STATIC, true, shadowCull);
+                    drawVisibleDepth(cascadeMatrix);
+                }
+
+                // Dynamic casters on top of the static layer, every frame
+                cullEntities(casterFrustum, EntityStore::CULL_DYNAMIC, true, shadowCull);
+                if (shadowCascades.beginDynamic(c, !visible.empty())) drawVisibleDepth(cascadeMatrix);
+                gpuProfiler().pop();
+            }
+            glState().disable(GL_DEPTH_CLAMP);
+            shadowCascades.endPass();
+        }
+        if (benchmarking) report.addPass("Shadow pass", millisecondsSince(passMark));
 
-        glm::mat4 characterModelMatrix2 = glm::translate(glm::mat4(1.0f), glm::vec3(-5.0f, terrain.getHeight(-47 + 250, -47 + 250), -20.0f));
-        characterModelMatrix2 = glm::rotate(characterModelMatrix2, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        characterModelMatrix2 = glm::scale(characterModelMatrix2, glm::vec3(0.05f));
-        glm::mat4 characterMVP2 = mvpMatrix * characterModelMatrix2;
-        character2.render(characterMVP2);
+        if (saveDepth) {
+            AllowAllocations allow;
+            for (int c = 0; c < shadowCascades.count(); ++c) {
+                std::string filename = "depth_map_" + std::to_string(c) + ".png";
+                if (asyncReadback().read(shadowCascades.framebuffer(c), shadowCascades.resolution(), shadowCascades.resolution(),
+                                         AsyncReadback::Format::Depth, filename)) {
+                    std::cout << "Saving depth texture to " << filename << std::endl;
+                }
+            }
+            saveDepth = false;
+        }
 
-        glDepthMask(GL_FALSE);
-        skybox.render(mvp);
-        glDepthMask(GL_TRUE);
+        // Second pass: Normal rendering
+        {
+            GPU_SCOPE("Main pass");
+            CPU_SCOPE("Main pass");
+            glState().bindFramebuffer(GL_FRAMEBUFFER, screenFramebuffer);
+            glViewport(0, 0, screenWidth, screenHeight);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            glState().bindTexture(1, GL_TEXTURE_2D_ARRAY, shadowCascades.depthTexture());
+            const glm::mat4& lightSpaceMatrix = shadowCascades.lightSpaceMatrix(0);
+
+            glState().useProgram(shaderProgram);
+            glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "MVP"), 1, GL_FALSE, &mvpMatrix[0][0]);
+            glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+            glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "lightSpaceMatrix"), 1, GL_FALSE, glm::value_ptr(lightSpaceMatrix));
+
+            cullEntities(Frustum::fromMatrix(mvpMatrix), EntityStore::CULL_ALL, false, cameraCull);
+            if (occlusionCulling) {
+                CPU_SCOPE("Occlusion cull");
+                occlusionCuller.beginFrame(mvpMatrix);
+                for (int i : visible) {
+                    if (entities.renderableAt(i).occluder) occlusionCuller.addOccluder(entities.worldMatrixAt(i), entities.boundsAt(i), i);
+                }
+                occlusionCuller.rasterize();
+                visible.erase(std::remove_if(visible.begin(), visible.end(), [&](int i) {
+                    return !occlusionCuller.isOccluder(i) && occlusionCuller.isOccluded(entities.boundsAt(i));
+                }), visible.end());
+            }
+            gatherTerrainTiles();
+            if (!visibleTiles.empty()) {
+                textureLoader().requestDetail(terrainTexture, float(screenHeight));   // Tiled under the camera
+                terrain.render(mvpMatrix, lightPosition, lightIntensity, lightSpaceMatrix, visibleTiles.data(), int(visibleTiles.size()));
+            }
+            // Rough size on screen in pixels, for texture streaming
+            auto screenPixels = [&](int i) {
+                const AABB& bounds = entities.boundsAt(i);
+                float radius = glm::length(bounds.extents());
+                float distance = std::max(glm::length(bounds.center() - cameraPosition) - radius, cameraNear);
+                return radius * screenHeight / (distance * std::tan(0.5f * cameraFov));
+            };
+            auto drawEntity = [&](int i) {
+                const Renderable& renderable = entities.renderableAt(i);
+                switch (renderable.kind) {
+                case RenderKind::Building:
+                    buildings[renderable.resource]->requestTextureDetail(screenPixels(i));
+                    buildings[renderable.resource]->render(mvpMatrix, entities.worldMatrixAt(i), lightPosition, lightIntensity, lightSpaceMatrix);
+                    break;
+                case RenderKind::Pub:
+                    pubs[renderable.resource]->requestTextureDetail(screenPixels(i));
+                    pubs[renderable.resource]->render(mvpMatrix, entities.worldMatrixAt(i), lightSpaceMatrix);
+                    break;
+                case RenderKind::Character: {
+                    const CharacterSnapshot& pose = frameState.characters[entities.animatorAt(i).character];
+                    characters[renderable.resource]->requestTextureDetail(screenPixels(i));
+                    characters[renderable.resource]->render(mvpMatrix * pose.model, pose.jointMatrices, pose.jointCount);
+                    break;
+                }
+                default:
+                    break;
+                }
+            };
+
+            // Objects that passed their last query draw first; the rest are tested
+            // against that depth afterwards and drawn only where their box shows
+            deferred.clear();
+            if (occlusionQueries) hardwareOcclusion.beginFrame(mvpMatrix, cameraPosition);
+            for (int i : visible) {
+                if (!occlusionQueries || entities.renderableAt(i).kind == RenderKind::Terrain) {
+                    drawEntity(i);
+                    continue;
+                }
+                uint32_t id = entities.entityAt(i).index;
+                if (!hardwareOcclusion.wasVisible(id)) {
+                    deferred.push_back(i);
+                    continue;
+                }
+                hardwareOcclusion.beginVisible(id);
+                drawEntity(i);
+                hardwareOcclusion.endVisible();
+            }
+            for (int i : deferred) {
+                hardwareOcclusion.beginHidden(entities.entityAt(i).index, entities.boundsAt(i));
+                drawEntity(i);
+                hardwareOcclusion.endHidden();
+            }
+
+            glState().depthMask(GL_FALSE);
+            textureLoader().requestDetail(skybox.textureID, float(screenHeight));
+            skybox.render(mvp);
+            glState().depthMask(GL_TRUE);
+        }
+        if (benchmarking) report.addPass("Main pass", millisecondsSince(passMark));
 
         // Update FPS counter
         frameCount++;
-        double currentFPSTime = glfwGetTime();
+        double currentFPSTime = std::chrono::duration<double>(Clock::now() - startTime).count();
         if (currentFPSTime - lastFPSTime >= 1.0) // Update every second
         {
             fps = double(frameCount) / (currentFPSTime - lastFPSTime);
             frameCount = 0;
             lastFPSTime = currentFPSTime;
 
-            // Update window title with FPS
-            std::string title = "Project | FPS: " + std::to_string(static_cast<int>(fps));
-            glfwSetWindowTitle(window, title.c_str());
+            // Update window title with FPS and the state calls of the last frame
+            const GLState::Stats& glStats = glState().lastFrame();
+            char title[128];
+            snprintf(title, sizeof(title), "Project | FPS: %d | GL state calls: %u issued, %u elided",
+                     static_cast<int>(fps), glStats.issued, glStats.elided);
+            if (window) glfwSetWindowTitle(window, title);
+        }
+
+        // Stats overlay with rolling GPU averages
+        {
+            GPU_SCOPE("Overlay");
+            CPU_SCOPE("Overlay");
+            const GLState::Stats& glStats = glState().lastFrame();
+            debugOverlay().printLine("FPS %.0f", fps);
+            debugOverlay().printLine("CPU frame %.2f ms, %llu hitches over %.0f ms", cpuProfiler().lastFrameMs(),
+                                     (unsigned long long)cpuProfiler().hitchCount(), options.hitchBudgetMs);
+            debugOverlay().printLine("Heap allocations %llu last frame, frame arena %zu KB peak",
+                                     (unsigned long long)frameAllocations, threadArena().highWater() / 1024);
+            static const char* simulationModes[] = { "real time", "lockstep", "serial" };
+            debugOverlay().printLine("Simulation %s, tick %llu, step %.3f ms, blend %.2f",
+                                     simulationModes[static_cast<int>(simulation.mode())],
+                                     (unsigned long long)frameState.tick, simulation.lastStepMs(), blend);
+            debugOverlay().printLine("Entities %d, %d transforms updated, BVH %d static + %d dynamic, height %d",
+                                     entities.count(), transformsUpdated, entities.staticTree().leafCount(),
+                                     entities.dynamicTree().leafCount(), std::max(entities.staticTree().height(), entities.dynamicTree().height()));
+            if (poseCache().enabled()) {
+                const PoseCache::Stats poseStats = poseCache().stats();
+                debugOverlay().printLine("Pose cache %d evaluated for %d characters", poseStats.evaluations, poseStats.requests);
+            } else {
+                debugOverlay().printLine("Pose cache off");
+            }
+            debugOverlay().printLine("Camera culling %d visible, %d culled", cameraCull.visible, cameraCull.culled);
+            if (occlusionCulling) {
+                const OcclusionCuller::Stats& occlusionStats = occlusionCuller.stats();
+                debugOverlay().printLine("Occlusion %d occluders, %d/%d hidden (%.0f%%), raster %.3f ms", occlusionStats.occluders,
+                                         occlusionStats.occluded, occlusionStats.tested,
+                                         occlusionStats.tested ? 100.0 * occlusionStats.occluded / occlusionStats.tested : 0.0,
+                                         occlusionStats.rasterMs);
+            } else {
+                debugOverlay().printLine("Occlusion off");
+            }
+            if (occlusionQueries) {
+                const OcclusionQueries::Stats& queryStats = hardwareOcclusion.stats();
+                debugOverlay().printLine("Occlusion queries %d visible, %d hidden, %d issued, %d in flight", queryStats.visible,
+                                         queryStats.hidden, queryStats.issued, queryStats.pending);
+            } else {
+                debugOverlay().printLine("Occlusion queries off");
+            }
+            const TextureLoader::Stats& textureStats = textureLoader().stats();
+            debugOverlay().printLine("Textures %d/%d uploaded, %d decoded, %d cached, %d this frame in %.2f ms",
+                                     textureStats.uploaded, textureStats.requested, textureStats.decoded, textureStats.cacheHits,
+                                     textureStats.uploadedLastFrame, textureStats.uploadMs);
+            debugOverlay().printLine("Texture residency %.1f/%d MB, %d mips streamed, %d evicted",
+                                     textureStats.residentBytes / (1024.0 * 1024.0), options.textureBudgetMB,
+                                     textureStats.streamedLastFrame, textureStats.evictedLastFrame);
+            debugOverlay().printLine("GL state calls %u issued, %u elided", glStats.issued, glStats.elided);
+            const ShadowCascades::Stats& shadowStats = shadowCascades.stats();
+            debugOverlay().printLine("Shadow cascades %d x %d, casters %d drawn, %d culled", shadowCascades.count(),
+                                     shadowCascades.resolution(), shadowCull.visible, shadowCull.culled);
+            debugOverlay().printLine("Shadow cache %d rendered, %d reused, %d copied; %llu/%llu frames cached",
+                                     shadowStats.staticRendered, shadowStats.staticReused, shadowStats.composited,
+                                     (unsigned long long)shadowCascades.cachedFrames(), (unsigned long long)shadowCascades.totalFrames());
+            debugOverlay().printLine("Readback %d in flight, %llu written, %llu dropped%s", asyncReadback().inFlight(),
+                                     (unsigned long long)asyncReadback().written(), (unsigned long long)asyncReadback().dropped(),
+                                     captureFrames ? " (capturing)" : "");
+            for (int i = 0; i < gpuProfiler().scopeCount(); ++i) {
+                debugOverlay().printLine("%*s%-14s %7.3f ms", 2 * gpuProfiler().scopeDepth(i), "",
+                                         gpuProfiler().scopeName(i), gpuProfiler().averageMs(i));
+            }
+            debugOverlay().render(screenWidth, screenHeight);
+        }
+        gpuProfiler().endFrame();
+        if (benchmarking) report.addPass("Overlay", millisecondsSince(passMark));
+
+        if (dumpGpuProfile) {
+            AllowAllocations allow;
+            if (gpuProfiler().writeCsv("gpu_profile.csv")) {
+                std::cout << "GPU profile saved to gpu_profile.csv" << std::endl;
+            }
+            dumpGpuProfile = false;
+        }
+
+        if (dumpTextureResidency) {
+            AllowAllocations allow;
+            printTextureResidency();
+            dumpTextureResidency = false;
         }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (dumpCpuTrace) {
+            AllowAllocations allow;
+            if (cpuProfiler().writeChromeTrace("cpu_trace.json", 120)) {
+                std::cout << "CPU trace saved to cpu_trace.json" << std::endl;
+            }
+            dumpCpuTrace = false;
+        }
+
+        if (captureFrames) {
+            char filename[64];
+            snprintf(filename, sizeof(filename), "capture/frame_%06d.png", captureIndex++);
+            asyncReadback().read(screenFramebuffer, screenWidth, screenHeight, AsyncReadback::Format::Color, filename);
+        }
+        asyncReadback().update();
+
+        {
+            CPU_SCOPE("Present");
+            if (headless) {
+                // No swap to wait on; finish so the frame time includes the GPU work
+                glFinish();
+            } else {
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+        }
+        if (frame == 0) {
+            std::cout << "Time to first frame: " << std::chrono::duration<double, std::milli>(Clock::now() - launchTime).count()
+                      << " ms, " << textureLoader().stats().uploaded << "/" << textureLoader().stats().requested
+                      << " textures loaded" << std::endl;
+        }
+        if (!texturesReported && textureLoader().idle()) {
+            std::cout << "All textures loaded after " << std::chrono::duration<double, std::milli>(Clock::now() - launchTime).count()
+                      << " ms" << std::endl;
+            texturesReported = true;
+        }
+        if (benchmarking) {
+            report.addPass("Present", millisecondsSince(passMark));
+            report.addCounter("Camera visible", cameraCull.visible);
+            report.addCounter("Camera culled", cameraCull.culled);
+            report.addCounter("Occlusion hidden", occlusionCulling ? occlusionCuller.stats().occluded : 0);
+            report.addCounter("Query hidden", occlusionQueries ? hardwareOcclusion.stats().hidden : 0);
+            report.addCounter("Shadow casters drawn", shadowCull.visible);
+            report.addCounter("Shadow casters culled", shadowCull.culled);
+            report.addCounter("Texture resident KB", textureLoader().stats().residentBytes / 1024.0);
+            report.addCounter("Heap allocations", double(frameAllocations));
+            report.addCounter("Poses evaluated", poseCache().stats().evaluations);
+            report.endFrame(millisecondsSince(frameStart));
+        }
+        cpuProfiler().endFrame();
+        frameAllocations = allocationCount() - allocationMark;
+        allocationMark = allocationCount();
+    }
+    setAllocationGuard(false);
+
+    simulation.stop();
+    textureLoader().cleanup();   // Waits for decode jobs, so before the workers go
+    jobSystem().shutdown();
+
+    if (benchmarking) {
+        for (int i = 0; i < gpuProfiler().scopeCount(); ++i) {
+            report.addGpuScope(gpuProfiler().scopePath(i), gpuProfiler().averageMs(i));
+        }
+        BenchmarkReport::Info info;
+        info.renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        info.cameraPath = options.cameraPath;
+        info.width = screenWidth;
+        info.height = screenHeight;
+        info.fixedTimestep = headless ? fixedTimestep : 0.0;
+        if (report.writeJson(options.reportPath.c_str(), info)) {
+            std::cout << "Benchmark report (" << report.frameCount() << " frames) saved to " << options.reportPath << std::endl;
+        }
     }
 
     // Cleanup resources
+    asyncReadback().cleanup();
+    debugOverlay().cleanup();
+    gpuProfiler().cleanup();
+    hardwareOcclusion.cleanup();
+    shadowCascades.cleanup();
     skybox.cleanup();
     building.cleanup();
     pub.cleanup();
     character1.cleanup();
     character2.cleanup();
-    glfwTerminate();
+    if (headless) headlessContext.destroy();
+    else glfwTerminate();
     return 0;
 }
@@ -0,0 +1,13 @@
+#version 330 core
+in vec2 UV;
+in vec4 color;
+
+uniform sampler2D fontTexture;
+
+out vec4 FragColor;
+
+void main() {
+    // The font atlas stores glyph coverage in the red channel
+    float coverage = texture(fontTexture, UV).r;
+    FragColor = vec4(color.rgb, color.a * coverage);
+}
@@ -0,0 +1,17 @@
+#version 330 core
+layout(location = 0) in vec2 vertexPosition;
+layout(location = 1) in vec2 vertexUV;
+layout(location = 2) in vec4 vertexColor;
+
+uniform vec2 screenSize;
+
+out vec2 UV;
+out vec4 color;
+
+void main() {
+    // Pixel coordinates with a top-left origin to clip space
+    vec2 ndc = vec2(vertexPosition.x / screenSize.x * 2.0 - 1.0, 1.0 - vertexPosition.y / screenSize.y * 2.0);
+    gl_Position = vec4(ndc, 0.0, 1.0);
+    UV = vertexUV;
+    color = vertexColor;
+}
@@ -0,0 +1,185 @@
+#include "AsyncReadback.h"
+#include "GLState.h"
+#include "core/AllocationTracker.h"
+#include "core/CpuProfiler.h"
+#include <stb_image_write.h>
+#include <algorithm>
+#include <cstdio>
+
+AsyncReadback& asyncReadback() {
+    static AsyncReadback readback;
+    return readback;
+}
+
+void AsyncReadback::initialize(int workerCount) {
+    if (workerCount <= 0) {
+        int hardware = static_cast<int>(std::thread::hardware_concurrency());
+        workerCount = std::max(1, std::min(hardware - 1, 4));
+    }
+    stopping = false;
+    for (int i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&AsyncReadback::workerLoop, this);
+    }
+}
+
+void AsyncReadback::cleanup() {
+    // Block on the outstanding fences here; nothing else is left to render
+    while (inFlight() > 0) {
+        for (Slot& slot : slots) {
+            if (slot.state.load() == PENDING) {
+                glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+            }
+        }
+        update();
+        std::this_thread::yield();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (std::thread& worker : workers) worker.join();
+    workers.clear();
+
+    for (Slot& slot : slots) {
+        if (slot.buffer) {
+            glState().forgetBuffer(slot.buffer);
+            glDeleteBuffers(1, &slot.buffer);
+        }
+        slot.buffer = 0;
+        slot.capacity = 0;
+    }
+}
+
+int AsyncReadback::inFlight() const {
+    int count = 0;
+    for (const Slot& slot : slots) {
+        if (slot.state.load() != FREE) count++;
+    }
+    return count;
+}
+
+bool AsyncReadback::read(GLuint framebuffer, int width, int height, Format format, const std::string& path) {
+    // Take the oldest free slot so buffers are reused round-robin
+    Slot* target = nullptr;
+    for (int i = 0; i < RING_SIZE && !target; ++i) {
+        Slot& candidate = slots[(nextSlot + i) % RING_SIZE];
+        if (candidate.state.load() == FREE) {
+            target = &candidate;
+            nextSlot = (nextSlot + i + 1) % RING_SIZE;
+        }
+    }
+    if (!target) {
+        droppedCount++;
+        return false;
+    }
+    Slot& slot = *target;
+
+    // Depth is read as floats; colour as tightly packed RGB
+    GLsizeiptr bytes = static_cast<GLsizeiptr>(width) * height * (format == Format::Depth ? 4 : 3);
+    if (!slot.buffer) glGenBuffers(1, &slot.buffer);
+    glState().bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (slot.capacity < bytes) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+        slot.capacity = bytes;
+    }
+
+    glState().bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    if (format == Format::Depth) {
+        glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+    } else {
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, 0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    }
+    glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.width = width;
+    slot.height = height;
+    slot.format = format;
+    {
+        // Captures are requested explicitly, so their bookkeeping may allocate
+        AllowAllocations allow;
+        slot.path = path;
+    }
+    slot.state.store(PENDING);
+    return true;
+}
+
+void AsyncReadback::update() {
+    CPU_SCOPE("Readback poll");
+    for (Slot& slot : slots) {
+        int state = slot.state.load();
+        if (state == PENDING) {
+            GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) continue;
+            glDeleteSync(slot.fence);
+            slot.fence = 0;
+
+            // The copy is complete, so mapping does not wait on the GPU
+            GLsizeiptr bytes = static_cast<GLsizeiptr>(slot.width) * slot.height * (slot.format == Format::Depth ? 4 : 3);
+            glState().bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            slot.data = static_cast<const unsigned char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT));
+            glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            if (!slot.data) {
+                fprintf(stderr, "Failed to map readback buffer for %s\n", slot.path.c_str());
+                slot.state.store(FREE);
+                continue;
+            }
+
+            slot.state.store(ENCODING);
+            {
+                std::lock_guard<std::mutex> lock(jobMutex);
+                jobs.push_back(&slot);
+            }
+            jobReady.notify_one();
+        } else if (state == DONE) {
+            glState().bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            slot.data = nullptr;
+            slot.state.store(FREE);
+        }
+    }
+}
+
+void AsyncReadback::workerLoop() {
+    cpuProfiler().setThreadName("Readback encoder");
+    for (;;) {
+        Slot* slot;
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+            slot = jobs.front();
+            jobs.pop_front();
+        }
+
+        AllowAllocations allow;
+        if (encode(*slot)) writtenCount++;
+        else fprintf(stderr, "Failed to write %s\n", slot->path.c_str());
+        slot->state.store(DONE);
+    }
+}
+
+bool AsyncReadback::encode(const Slot& slot) {
+    CPU_SCOPE("Encode PNG");
+    int pixels = slot.width * slot.height;
+    if (slot.format == Format::Depth) {
+        // Convert depth values to grayscale image
+        const float* depth = reinterpret_cast<const float*>(slot.data);
+        std::vector<unsigned char> img(pixels);
+        for (int i = 0; i < pixels; ++i) {
+            img[i] = static_cast<unsigned char>(depth[i] * 255);
+        }
+        return stbi_write_png(slot.path.c_str(), slot.width, slot.height, 1, img.data(), slot.width) != 0;
+    }
+
+    // GL rows run bottom-up; a negative stride writes them top-down without a copy
+    // (stbi_flip_vertically_on_write is a global and not safe to toggle per thread)
+    int stride = slot.width * 3;
+    const unsigned char* lastRow = slot.data + static_cast<size_t>(slot.height - 1) * stride;
+    return stbi_write_png(slot.path.c_str(), slot.width, slot.height, 3, lastRow, -stride) != 0;
+}
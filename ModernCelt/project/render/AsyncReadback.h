@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Non-blocking framebuffer readback to PNG files.
+// glReadPixels writes into a pixel buffer object from a small ring and a fence is
+// placed behind it. update() polls the fences without waiting; once the GPU is done
+// the buffer is mapped and the mapped pointer goes to a pool of encoder threads,
+// which convert and PNG-encode straight from it. The buffer is unmapped on the
+// render thread after the encoder has finished. When every slot is busy a request
+// is dropped rather than stalling the frame.
+class AsyncReadback {
+public:
+    static const int RING_SIZE = 8;
+
+    enum class Format {
+        Depth,   // Depth attachment, written as 8-bit grey in GL row order
+        Color,   // RGB colour, flipped so the image is upright
+    };
+
+    // Start encoder threads; workerCount 0 picks one per spare hardware thread (max 4)
+    void initialize(int workerCount = 0);
+
+    // Finish every outstanding request, then stop the encoder threads
+    void cleanup();
+
+    // Queue a read of the framebuffer's lower-left width x height pixels.
+    // Returns false, counting a drop, when the ring is full.
+    bool read(GLuint framebuffer, int width, int height, Format format, const std::string& path);
+
+    // Call once per frame on the render thread
+    void update();
+
+    int inFlight() const;
+    uint64_t written() const { return writtenCount.load(); }
+    uint64_t dropped() const { return droppedCount; }
+
+private:
+    enum SlotState {
+        FREE,       // Unused
+        PENDING,    // Readback issued, waiting on the fence
+        ENCODING,   // Mapped and owned by an encoder thread
+        DONE,       // Encoder finished; waiting to be unmapped
+    };
+
+    struct Slot {
+        GLuint buffer = 0;
+        GLsizeiptr capacity = 0;
+        GLsync fence = 0;
+        int width = 0;
+        int height = 0;
+        Format format = Format::Color;
+        std::string path;
+        const unsigned char* data = nullptr;
+        std::atomic<int> state{ FREE };
+    };
+
+    Slot slots[RING_SIZE];
+    int nextSlot = 0;
+    std::vector<std::thread> workers;
+    std::deque<Slot*> jobs;
+    std::mutex jobMutex;
+    std::condition_variable jobReady;
+    bool stopping = false;
+    std::atomic<uint64_t> writtenCount{ 0 };
+    uint64_t droppedCount = 0;
+
+    void workerLoop();
+    static bool encode(const Slot& slot);
+};
+
+AsyncReadback& asyncReadback();
@@ -0,0 +1,167 @@
+#include "BlockCompression.h"
+#include "core/JobSystem.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace {
+
+uint16_t packRgb565(const glm::vec3& color) {
+    int r = static_cast<int>(std::lround(glm::clamp(color.r, 0.0f, 255.0f) * 31.0f / 255.0f));
+    int g = static_cast<int>(std::lround(glm::clamp(color.g, 0.0f, 255.0f) * 63.0f / 255.0f));
+    int b = static_cast<int>(std::lround(glm::clamp(color.b, 0.0f, 255.0f) * 31.0f / 255.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+// Expand the way the hardware does, replicating the top bits into the bottom ones
+glm::vec3 unpackRgb565(uint16_t packed) {
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    return glm::vec3(float((r << 3) | (r >> 2)), float((g << 2) | (g >> 4)), float((b << 3) | (b >> 2)));
+}
+
+void writeU16(uint8_t* out, uint16_t value) {
+    out[0] = static_cast<uint8_t>(value & 0xff);
+    out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+// BC1 colour block: endpoints at the ends of the principal axis, pulled in by
+// 1/16 of the range so the interpolated colours land nearer the data
+void encodeColorBlock(const uint8_t pixels[16][4], uint8_t* out) {
+    glm::vec3 colors[16];
+    glm::vec3 mean(0.0f), low(255.0f), high(0.0f);
+    for (int i = 0; i < 16; ++i) {
+        colors[i] = glm::vec3(pixels[i][0], pixels[i][1], pixels[i][2]);
+        mean += colors[i];
+        low = glm::min(low, colors[i]);
+        high = glm::max(high, colors[i]);
+    }
+    mean /= 16.0f;
+
+    // Covariance, then a few rounds of power iteration from the box diagonal
+    float xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+    for (const glm::vec3& color : colors) {
+        glm::vec3 d = color - mean;
+        xx += d.x * d.x; xy += d.x * d.y; xz += d.x * d.z;
+        yy += d.y * d.y; yz += d.y * d.z; zz += d.z * d.z;
+    }
+    glm::vec3 axis = high - low;
+    for (int iteration = 0; iteration < 4; ++iteration) {
+        glm::vec3 next(xx * axis.x + xy * axis.y + xz * axis.z,
+                       xy * axis.x + yy * axis.y + yz * axis.z,
+                       xz * axis.x + yz * axis.y + zz * axis.z);
+        float length = glm::length(next);
+        if (length < 1e-6f) break;
+        axis = next / length;
+    }
+    if (glm::length(axis) < 1e-6f) axis = glm::vec3(1.0f);
+    axis = glm::normalize(axis);
+
+    float minT = 0.0f, maxT = 0.0f;
+    for (const glm::vec3& color : colors) {
+        float t = glm::dot(color - mean, axis);
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    glm::vec3 start = mean + axis * maxT;
+    glm::vec3 end = mean + axis * minT;
+    glm::vec3 inset = (start - end) / 16.0f;
+    uint16_t color0 = packRgb565(start - inset);
+    uint16_t color1 = packRgb565(end + inset);
+
+    // color0 > color1 selects the four-colour mode
+    if (color0 < color1) std::swap(color0, color1);
+    writeU16(out, color0);
+    writeU16(out + 2, color1);
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        glm::vec3 palette[4];
+        palette[0] = unpackRgb565(color0);
+        palette[1] = unpackRgb565(color1);
+        palette[2] = (2.0f * palette[0] + palette[1]) / 3.0f;
+        palette[3] = (palette[0] + 2.0f * palette[1]) / 3.0f;
+        for (int i = 0; i < 16; ++i) {
+            int best = 0;
+            float bestDistance = FLT_MAX;
+            for (int p = 0; p < 4; ++p) {
+                glm::vec3 d = colors[i] - palette[p];
+                float distance = glm::dot(d, d);
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= static_cast<uint32_t>(best) << (2 * i);
+        }
+    }
+    for (int i = 0; i < 4; ++i) out[4 + i] = static_cast<uint8_t>(indices >> (8 * i));
+}
+
+// BC4 block for one channel: the block's max and min as endpoints with six values between
+void encodeChannelBlock(const uint8_t pixels[16][4], int channel, uint8_t* out) {
+    int high = 0, low = 255;
+    for (int i = 0; i < 16; ++i) {
+        high = std::max(high, int(pixels[i][channel]));
+        low = std::min(low, int(pixels[i][channel]));
+    }
+    out[0] = static_cast<uint8_t>(high);
+    out[1] = static_cast<uint8_t>(low);
+
+    uint64_t indices = 0;
+    if (high != low) {
+        for (int i = 0; i < 16; ++i) {
+            // Step along low..high in sevenths; step 7 is endpoint 0, step 0 endpoint 1,
+            // and step k in between is palette entry 8 - k
+            int step = (14 * (pixels[i][channel] - low) + (high - low)) / (2 * (high - low));
+            int index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+            indices |= static_cast<uint64_t>(index) << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; ++i) out[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+}
+
+} // namespace
+
+void encodeBlockRows(BlockFormat format, const uint8_t* rgba, int width, int height,
+                     int blockRowBegin, int blockRowEnd, uint8_t* out) {
+    int blocksWide = (width + 3) / 4;
+    int stride = blockBytes(format);
+    uint8_t pixels[16][4];
+    for (int by = blockRowBegin; by < blockRowEnd; ++by) {
+        for (int bx = 0; bx < blocksWide; ++bx) {
+            for (int y = 0; y < 4; ++y) {
+                int row = std::min(by * 4 + y, height - 1);
+                for (int x = 0; x < 4; ++x) {
+                    int column = std::min(bx * 4 + x, width - 1);
+                    const uint8_t* source = rgba + (static_cast<size_t>(row) * width + column) * 4;
+                    for (int c = 0; c < 4; ++c) pixels[y * 4 + x][c] = source[c];
+                }
+            }
+
+            uint8_t* block = out + (static_cast<size_t>(by) * blocksWide + bx) * stride;
+            switch (format) {
+            case BlockFormat::BC1:
+                encodeColorBlock(pixels, block);
+                break;
+            case BlockFormat::BC3:
+                encodeChannelBlock(pixels, 3, block);
+                encodeColorBlock(pixels, block + 8);
+                break;
+            case BlockFormat::BC5:
+                encodeChannelBlock(pixels, 0, block);
+                encodeChannelBlock(pixels, 1, block + 8);
+                break;
+            }
+        }
+    }
+}
+
+void encodeBlocks(BlockFormat format, const uint8_t* rgba, int width, int height, uint8_t* out) {
+    int blockRows = (height + 3) / 4;
+    jobSystem().parallelFor(0, blockRows, 16, [&](int begin, int end) {
+        encodeBlockRows(format, rgba, width, height, begin, end, out);
+    });
+}
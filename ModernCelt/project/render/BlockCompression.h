@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Software encoders for the S3TC/RGTC block formats. Every 4x4 pixel block becomes
+//   BC1  8 bytes: two RGB565 endpoints and 2-bit indices (RGB, 4 bits per pixel)
+//   BC3 16 bytes: a BC4 alpha block followed by a BC1 colour block
+//   BC5 16 bytes: BC4 blocks for red and green (two-channel normal maps)
+// Colour endpoints come from the block's principal axis (range fit), which is fast
+// and good enough for textures that are encoded once and cached.
+//
+// Input is tightly packed RGBA8. Edges of images whose size is not a multiple of
+// four are padded by repeating the last row and column.
+enum class BlockFormat { BC1, BC3, BC5 };
+
+// Bytes per 4x4 block
+inline int blockBytes(BlockFormat format) { return format == BlockFormat::BC1 ? 8 : 16; }
+
+// Size of an encoded width x height image
+inline size_t blockEncodedSize(BlockFormat format, int width, int height) {
+    return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+// Encode block rows [blockRowBegin, blockRowEnd) of a width x height RGBA8 image
+// into out, which holds blockEncodedSize() bytes for the whole image
+void encodeBlockRows(BlockFormat format, const uint8_t* rgba, int width, int height,
+                     int blockRowBegin, int blockRowEnd, uint8_t* out);
+
+// Encode the whole image, spreading block rows over the job system
+void encodeBlocks(BlockFormat format, const uint8_t* rgba, int width, int height, uint8_t* out);
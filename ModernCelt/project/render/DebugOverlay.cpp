@@ -0,0 +1,214 @@
+#include "DebugOverlay.h"
+#include "render/GLState.h"
+#include "render/shader.h"
+#include <cstdio>
+#include <iostream>
+
+// 5x7 font for ASCII 32-95, one byte per column, bit 0 is the top row.
+// Lowercase letters reuse the uppercase glyphs.
+static const unsigned char FONT_5X7[64][5] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00}, {0x14, 0x7F, 0x14, 0x7F, 0x14}, // space ! " #
+    {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62}, {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00}, // $ % & '
+    {0x00, 0x1C, 0x22, 0x41, 0x00}, {0x00, 0x41, 0x22, 0x1C, 0x00}, {0x14, 0x08, 0x3E, 0x08, 0x14}, {0x08, 0x08, 0x3E, 0x08, 0x08}, // ( ) * +
+    {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x60, 0x60, 0x00, 0x00}, {0x20, 0x10, 0x08, 0x04, 0x02}, // , - . /
+    {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00}, {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31}, // 0 1 2 3
+    {0x18, 0x14, 0x12, 0x7F, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03}, // 4 5 6 7
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x36, 0x36, 0x00, 0x00}, {0x00, 0x56, 0x36, 0x00, 0x00}, // 8 9 : ;
+    {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14}, {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06}, // < = > ?
+    {0x32, 0x49, 0x79, 0x41, 0x3E}, {0x7E, 0x11, 0x11, 0x11, 0x7E}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22}, // @ A B C
+    {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x09, 0x01}, {0x3E, 0x41, 0x49, 0x49, 0x7A}, // D E F G
+    {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00}, {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41}, // H I J K
+    {0x7F, 0x40, 0x40, 0x40, 0x40}, {0x7F, 0x02, 0x0C, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E}, // L M N O
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46}, {0x46, 0x49, 0x49, 0x49, 0x31}, // P Q R S
+    {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F}, {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x3F, 0x40, 0x38, 0x40, 0x3F}, // T U V W
+    {0x63, 0x14, 0x08, 0x14, 0x63}, {0x07, 0x08, 0x70, 0x08, 0x07}, {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00}, // X Y Z [
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00}, {0x04, 0x02, 0x01, 0x02, 0x04}, {0x40, 0x40, 0x40, 0x40, 0x40}, // \ ] ^ _
+};
+
+// Atlas of 16x6 cells covering ASCII 32-127; cell 127 is a solid block used for panels
+static const int ATLAS_COLUMNS = 16;
+static const int ATLAS_ROWS = 6;
+static const int ATLAS_WIDTH = ATLAS_COLUMNS * DebugOverlay::GLYPH_WIDTH;
+static const int ATLAS_HEIGHT = ATLAS_ROWS * DebugOverlay::GLYPH_HEIGHT;
+static const float LINE_MARGIN = 8.0f;
+
+DebugOverlay& debugOverlay() {
+    static DebugOverlay overlay;
+    return overlay;
+}
+
+static void glyphCell(int c, glm::vec2& uv0, glm::vec2& uv1) {
+    if (c < 32 || c > 127) c = '?';
+    int index = c - 32;
+    float u = float((index % ATLAS_COLUMNS) * DebugOverlay::GLYPH_WIDTH) / ATLAS_WIDTH;
+    float v = float((index / ATLAS_COLUMNS) * DebugOverlay::GLYPH_HEIGHT) / ATLAS_HEIGHT;
+    uv0 = glm::vec2(u, v);
+    uv1 = glm::vec2(u + float(DebugOverlay::GLYPH_WIDTH) / ATLAS_WIDTH, v + float(DebugOverlay::GLYPH_HEIGHT) / ATLAS_HEIGHT);
+}
+
+void DebugOverlay::initialize() {
+    // Rasterize the font into an 8-bit coverage atlas
+    unsigned char atlas[ATLAS_WIDTH * ATLAS_HEIGHT] = {};
+    for (int c = 32; c < 128; ++c) {
+        int index = c - 32;
+        int cellX = (index % ATLAS_COLUMNS) * GLYPH_WIDTH;
+        int cellY = (index / ATLAS_COLUMNS) * GLYPH_HEIGHT;
+        for (int column = 0; column < GLYPH_WIDTH; ++column) {
+            for (int row = 0; row < GLYPH_HEIGHT; ++row) {
+                bool lit;
+                if (c == 127) {
+                    lit = true;
+                } else if (column < 5 && row < 7) {
+                    int glyph = (c >= 'a' && c <= 'z') ? c - 32 : c;
+                    lit = glyph < 96 && (FONT_5X7[glyph - 32][column] >> row) & 1;
+                } else {
+                    lit = false;
+                }
+                atlas[(cellY + row) * ATLAS_WIDTH + cellX + column] = lit ? 255 : 0;
+            }
+        }
+    }
+
+    glGenTextures(1, &fontTexture);
+    glState().bindTexture(0, GL_TEXTURE_2D, fontTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, ATLAS_WIDTH, ATLAS_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, atlas);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Static quad indices; vertices are streamed every frame
+    std::vector<GLuint> indices(MAX_QUADS * 6);
+    for (GLuint quad = 0; quad < MAX_QUADS; ++quad) {
+        GLuint base = quad * 4;
+        GLuint pattern[6] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+        for (int i = 0; i < 6; ++i) indices[quad * 6 + i] = pattern[i];
+    }
+    mesh.initialize(nullptr, MAX_QUADS * 4, indices.data(), indices.size(), GL_DYNAMIC_DRAW);
+    vertices.reserve(MAX_QUADS * 4);
+
+    programID = LoadShadersFromFile("../project/overlay.vert", "../project/overlay.frag");
+    if (programID == 0) {
+        std::cerr << "Failed to load shaders." << std::endl;
+    }
+    screenSizeID = glGetUniformLocation(programID, "screenSize");
+    fontSamplerID = glGetUniformLocation(programID, "fontTexture");
+    glState().useProgram(programID);
+    glUniform1i(fontSamplerID, 0);
+}
+
+void DebugOverlay::cleanup() {
+    mesh.cleanup();
+    if (fontTexture) {
+        glState().forgetTexture(fontTexture);
+        glDeleteTextures(1, &fontTexture);
+    }
+    if (programID) glDeleteProgram(programID);
+    fontTexture = programID = 0;
+}
+
+void DebugOverlay::addQuad(float x0, float y0, float x1, float y1, const glm::vec2& uv0, const glm::vec2& uv1, const glm::vec4& color) {
+    if (vertices.size() + 4 > static_cast<size_t>(MAX_QUADS) * 4) return;
+    vertices.push_back(OverlayVertex{ glm::vec2(x0, y0), glm::vec2(uv0.x, uv0.y), color });
+    vertices.push_back(OverlayVertex{ glm::vec2(x1, y0), glm::vec2(uv1.x, uv0.y), color });
+    vertices.push_back(OverlayVertex{ glm::vec2(x1, y1), glm::vec2(uv1.x, uv1.y), color });
+    vertices.push_back(OverlayVertex{ glm::vec2(x0, y1), glm::vec2(uv0.x, uv1.y), color });
+}
+
+void DebugOverlay::addRect(float x, float y, float w, float h, const glm::vec4& color) {
+    // Sample the middle of the solid block glyph
+    glm::vec2 uv0, uv1;
+    glyphCell(127, uv0, uv1);
+    glm::vec2 center = 0.5f * (uv0 + uv1);
+    addQuad(x, y, x + w, y + h, center, center, color);
+}
+
+void DebugOverlay::addText(float x, float y, const char* text, const glm::vec4& color) {
+    float advance = GLYPH_WIDTH * scale;
+    float startX = x;
+    for (const char* c = text; *c; ++c) {
+        if (*c == '\n') {
+            x = startX;
+            y += GLYPH_HEIGHT * scale;
+            continue;
+        }
+        if (*c != ' ') {
+            glm::vec2 uv0, uv1;
+            glyphCell(static_cast<unsigned char>(*c), uv0, uv1);
+            addQuad(x, y, x + advance, y + GLYPH_HEIGHT * scale, uv0, uv1, color);
+        }
+        x += advance;
+    }
+}
+
+void DebugOverlay::printLineV(const glm::vec4& color, const char* format, va_list args) {
+    char line[256];
+    int length = vsnprintf(line, sizeof(line), format, args);
+    if (length < 0) return;
+    if (length >= static_cast<int>(sizeof(line))) length = sizeof(line) - 1;
+
+    // Reserve a quad for the background panel so it is drawn under the text
+    if (panelQuad < 0) {
+        panelQuad = static_cast<int>(vertices.size() / 4);
+        addRect(0.0f, 0.0f, 0.0f, 0.0f, glm::vec4(0.0f));
+    }
+
+    addText(LINE_MARGIN, LINE_MARGIN + cursorY, line, color);
+    cursorY += GLYPH_HEIGHT * scale;
+    float width = length * GLYPH_WIDTH * scale;
+    if (width > panelWidth) panelWidth = width;
+}
+
+void DebugOverlay::printLine(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    printLineV(glm::vec4(1.0f), format, args);
+    va_end(args);
+}
+
+void DebugOverlay::printLine(const glm::vec4& color, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    printLineV(color, format, args);
+    va_end(args);
+}
+
+void DebugOverlay::render(int screenWidth, int screenHeight) {
+    if (visible && !vertices.empty()) {
+        // Size the reserved panel quad to the printed lines
+        if (panelQuad >= 0) {
+            float x1 = panelWidth + 2.0f * LINE_MARGIN;
+            float y1 = cursorY + 2.0f * LINE_MARGIN;
+            OverlayVertex* panel = &vertices[panelQuad * 4];
+            panel[0].position = glm::vec2(0.0f, 0.0f);
+            panel[1].position = glm::vec2(x1, 0.0f);
+            panel[2].position = glm::vec2(x1, y1);
+            panel[3].position = glm::vec2(0.0f, y1);
+            for (int i = 0; i < 4; ++i) panel[i].color = glm::vec4(0.0f, 0.0f, 0.0f, 0.6f);
+        }
+
+        mesh.updateVertices(vertices.data(), vertices.size());
+
+        glState().useProgram(programID);
+        glUniform2f(screenSizeID, float(screenWidth), float(screenHeight));
+        glState().bindTexture(0, GL_TEXTURE_2D, fontTexture);
+        glState().disable(GL_DEPTH_TEST);
+        glState().disable(GL_CULL_FACE);
+        glState().enable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        mesh.bind();
+        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(vertices.size() / 4 * 6), GL_UNSIGNED_INT, 0);
+
+        glState().disable(GL_BLEND);
+        glState().enable(GL_CULL_FACE);
+        glState().enable(GL_DEPTH_TEST);
+    }
+
+    vertices.clear();
+    panelQuad = -1;
+    cursorY = 0.0f;
+    panelWidth = 0.0f;
+}
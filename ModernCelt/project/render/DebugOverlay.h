@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <cstdarg>
+#include <vector>
+#include "render/VertexFormat.h"
+
+// Screen-space vertex for overlay text and panels
+struct OverlayVertex {
+    glm::vec2 position;   // Pixels, origin at the top-left corner
+    glm::vec2 uv;
+    glm::vec4 color;
+};
+
+template <> struct VertexLayout<OverlayVertex> {
+    static constexpr std::array<VertexAttribute, 3> attributes = {{
+        VERTEX_ATTRIBUTE(OverlayVertex, position, 0),
+        VERTEX_ATTRIBUTE(OverlayVertex, uv, 1),
+        VERTEX_ATTRIBUTE(OverlayVertex, color, 2),
+    }};
+};
+
+// Immediate-mode text overlay using a built-in 5x7 bitmap font.
+// Lines are queued during the frame and drawn in one call by render().
+class DebugOverlay {
+public:
+    static const int MAX_QUADS = 4096;
+    static const int GLYPH_WIDTH = 6;    // 5 pixel glyph + 1 pixel spacing
+    static const int GLYPH_HEIGHT = 8;   // 7 pixel glyph + 1 pixel spacing
+
+    bool visible = true;
+    float scale = 2.0f;   // Pixels per font texel
+
+    void initialize();
+    void cleanup();
+
+    // Queue one printf-formatted line below the previous one
+    void printLine(const char* format, ...);
+    void printLine(const glm::vec4& color, const char* format, ...);
+
+    // Queue text or a filled rectangle at an explicit pixel position
+    void addText(float x, float y, const char* text, const glm::vec4& color);
+    void addRect(float x, float y, float w, float h, const glm::vec4& color);
+
+    // Draw everything queued this frame into the current framebuffer, then clear the queue
+    void render(int screenWidth, int screenHeight);
+
+private:
+    InterleavedMesh<OverlayVertex> mesh;
+    std::vector<OverlayVertex> vertices;
+    GLuint fontTexture = 0;
+    GLuint programID = 0;
+    GLuint screenSizeID = 0;
+    GLuint fontSamplerID = 0;
+    float cursorY = 0.0f;
+    float panelWidth = 0.0f;
+    int panelQuad = -1;   // Quad reserved for the line panel, -1 until the first printLine
+
+    void addQuad(float x0, float y0, float x1, float y1, const glm::vec2& uv0, const glm::vec2& uv1, const glm::vec4& color);
+    void printLineV(const glm::vec4& color, const char* format, va_list args);
+};
+
+DebugOverlay& debugOverlay();
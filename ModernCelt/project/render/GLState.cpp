@@ -0,0 +1,169 @@
+#include "GLState.h"
+
+GLState& glState() {
+    static GLState state;
+    return state;
+}
+
+GLState::GLState() : issuedTotal(0), elidedTotal(0) {
+    invalidate();
+}
+
+void GLState::invalidate() {
+    program = UNKNOWN;
+    vertexArray = UNKNOWN;
+    arrayBuffer = UNKNOWN;
+    elementBuffer = UNKNOWN;
+    pixelPackBuffer = UNKNOWN;
+    pixelUnpackBuffer = UNKNOWN;
+    readFramebuffer = UNKNOWN;
+    drawFramebuffer = UNKNOWN;
+    activeUnit = UNKNOWN;
+    for (GLuint unit = 0; unit < MAX_TEXTURE_UNITS; ++unit) {
+        for (int target = 0; target < TEXTURE_TARGETS; ++target) {
+            textures[unit][target] = UNKNOWN;
+        }
+        samplers[unit] = UNKNOWN;
+    }
+    depthTest = cullFace = blend = depthClamp = depthWrite = -1;
+}
+
+void GLState::useProgram(GLuint id) {
+    if (program == id) { elide(); return; }
+    glUseProgram(id);
+    program = id;
+    issue();
+}
+
+void GLState::bindVertexArray(GLuint vao) {
+    if (vertexArray == vao) { elide(); return; }
+    glBindVertexArray(vao);
+    vertexArray = vao;
+    elementBuffer = UNKNOWN; // Each VAO carries its own element buffer binding
+    issue();
+}
+
+GLuint* GLState::bufferSlot(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER: return &arrayBuffer;
+        case GL_ELEMENT_ARRAY_BUFFER: return &elementBuffer;
+        case GL_PIXEL_PACK_BUFFER: return &pixelPackBuffer;
+        case GL_PIXEL_UNPACK_BUFFER: return &pixelUnpackBuffer;
+        default: return nullptr;
+    }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer) {
+    GLuint* slot = bufferSlot(target);
+    if (slot && *slot == buffer) { elide(); return; }
+    glBindBuffer(target, buffer);
+    if (slot) *slot = buffer;
+    issue();
+}
+
+void GLState::bindFramebuffer(GLenum target, GLuint fbo) {
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    if ((!read || readFramebuffer == fbo) && (!draw || drawFramebuffer == fbo)) { elide(); return; }
+    glBindFramebuffer(target, fbo);
+    if (read) readFramebuffer = fbo;
+    if (draw) drawFramebuffer = fbo;
+    issue();
+}
+
+int GLState::textureTargetIndex(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_2D_ARRAY: return 1;
+        case GL_TEXTURE_CUBE_MAP: return 2;
+        default: return -1;
+    }
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    int targetIndex = textureTargetIndex(target);
+    bool cached = unit < MAX_TEXTURE_UNITS && targetIndex >= 0;
+
+    // Callers go on to edit the texture on this unit (glTexImage2D, glTexParameteri),
+    // so the unit becomes active even when the bind itself is redundant
+    if (activeUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+        issue();
+    }
+    if (cached && textures[unit][targetIndex] == texture) { elide(); return; }
+
+    glBindTexture(target, texture);
+    if (cached) textures[unit][targetIndex] = texture;
+    issue();
+}
+
+void GLState::bindSampler(GLuint unit, GLuint sampler) {
+    if (unit < MAX_TEXTURE_UNITS && samplers[unit] == sampler) { elide(); return; }
+    glBindSampler(unit, sampler);
+    if (unit < MAX_TEXTURE_UNITS) samplers[unit] = sampler;
+    issue();
+}
+
+int* GLState::capSlot(GLenum cap) {
+    switch (cap) {
+        case GL_DEPTH_TEST: return &depthTest;
+        case GL_CULL_FACE: return &cullFace;
+        case GL_BLEND: return &blend;
+        case GL_DEPTH_CLAMP: return &depthClamp;
+        default: return nullptr;
+    }
+}
+
+void GLState::enable(GLenum cap) {
+    int* slot = capSlot(cap);
+    if (slot && *slot == 1) { elide(); return; }
+    glEnable(cap);
+    if (slot) *slot = 1;
+    issue();
+}
+
+void GLState::disable(GLenum cap) {
+    int* slot = capSlot(cap);
+    if (slot && *slot == 0) { elide(); return; }
+    glDisable(cap);
+    if (slot) *slot = 0;
+    issue();
+}
+
+void GLState::depthMask(GLboolean flag) {
+    int value = flag ? 1 : 0;
+    if (depthWrite == value) { elide(); return; }
+    glDepthMask(flag);
+    depthWrite = value;
+    issue();
+}
+
+void GLState::forgetTexture(GLuint texture) {
+    for (GLuint unit = 0; unit < MAX_TEXTURE_UNITS; ++unit) {
+        for (int target = 0; target < TEXTURE_TARGETS; ++target) {
+            if (textures[unit][target] == texture) textures[unit][target] = UNKNOWN;
+        }
+    }
+}
+
+void GLState::forgetBuffer(GLuint buffer) {
+    if (arrayBuffer == buffer) arrayBuffer = UNKNOWN;
+    if (elementBuffer == buffer) elementBuffer = UNKNOWN;
+    if (pixelPackBuffer == buffer) pixelPackBuffer = UNKNOWN;
+    if (pixelUnpackBuffer == buffer) pixelUnpackBuffer = UNKNOWN;
+}
+
+void GLState::forgetVertexArray(GLuint vao) {
+    if (vertexArray == vao) {
+        vertexArray = UNKNOWN;
+        elementBuffer = UNKNOWN;
+    }
+}
+
+void GLState::beginFrame() {
+    issuedTotal += current.issued;
+    elidedTotal += current.elided;
+    previous = current;
+    current = Stats();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <cstdint>
+
+// Thin cache in front of the GL binding/enable state. Every call compares against
+// the last value it set and skips the driver call when nothing would change.
+// Code that binds through raw GL calls must call invalidate() afterwards.
+class GLState {
+public:
+    static const GLuint MAX_TEXTURE_UNITS = 16;
+
+    // Calls made through the cache during one frame
+    struct Stats {
+        uint32_t issued = 0;   // GL calls actually sent to the driver
+        uint32_t elided = 0;   // Calls skipped because the state already matched
+    };
+
+    GLState();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    void bindBuffer(GLenum target, GLuint buffer);
+    void bindFramebuffer(GLenum target, GLuint fbo);
+    // Always leaves unit active, so texture edits after it apply to this unit
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    void bindSampler(GLuint unit, GLuint sampler);
+    void enable(GLenum cap);
+    void disable(GLenum cap);
+    void depthMask(GLboolean flag);
+
+    // Forget all cached values so the next call of each kind is always issued
+    void invalidate();
+
+    // Drop references to deleted objects so a recycled name is rebound
+    void forgetTexture(GLuint texture);
+    void forgetBuffer(GLuint buffer);
+    void forgetVertexArray(GLuint vao);
+
+    // Close the current frame's counters and start new ones
+    void beginFrame();
+    const Stats& lastFrame() const { return previous; }
+    uint64_t totalIssued() const { return issuedTotal; }
+    uint64_t totalElided() const { return elidedTotal; }
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+    static const int TEXTURE_TARGETS = 3; // 2D, 2D array, cube map
+
+    GLuint program;
+    GLuint vertexArray;
+    GLuint arrayBuffer;
+    GLuint elementBuffer;   // Part of VAO state; reset whenever the VAO changes
+    GLuint pixelPackBuffer;
+    GLuint pixelUnpackBuffer;
+    GLuint readFramebuffer;
+    GLuint drawFramebuffer;
+    GLuint activeUnit;
+    GLuint textures[MAX_TEXTURE_UNITS][TEXTURE_TARGETS];
+    GLuint samplers[MAX_TEXTURE_UNITS];
+    int depthTest;          // -1 unknown, 0 disabled, 1 enabled
+    int cullFace;
+    int blend;
+    int depthClamp;
+    int depthWrite;
+
+    Stats current;
+    Stats previous;
+    uint64_t issuedTotal;
+    uint64_t elidedTotal;
+
+    GLuint* bufferSlot(GLenum target);
+    int* capSlot(GLenum cap);
+    static int textureTargetIndex(GLenum target);
+    void issue(uint32_t calls = 1) { current.issued += calls; }
+    void elide() { current.elided++; }
+};
+
+// Cache for the context owned by the render thread
+GLState& glState();
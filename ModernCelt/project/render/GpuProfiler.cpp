@@ -0,0 +1,192 @@
+#include "GpuProfiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// Appends text at length, cut short so the terminator still fits; returns the new length
+size_t appendTruncated(char* buffer, size_t capacity, size_t length, const char* text) {
+    size_t count = std::min(strlen(text), capacity - 1 - length);
+    memcpy(buffer + length, text, count);
+    buffer[length + count] = '\0';
+    return length + count;
+}
+
+} // namespace
+
+GpuProfiler& gpuProfiler() {
+    static GpuProfiler profiler;
+    return profiler;
+}
+
+void GpuProfiler::initialize() {
+    // Timer queries are core since GL 3.3
+    enabled = true;
+    frameNumber = 0;
+    resolvedCount = 0;
+    stackSize = 0;
+
+    // Frames vary in how many segments they record (the static shadow layer is
+    // only redrawn now and then); room up front keeps later frames off the heap
+    scopes.reserve(64);
+    for (FrameSlot& slot : slots) {
+        slot.queries.reserve(256);
+        slot.segments.reserve(256);
+    }
+}
+
+void GpuProfiler::cleanup() {
+    for (FrameSlot& slot : slots) {
+        if (!slot.queries.empty()) {
+            glDeleteQueries(static_cast<GLsizei>(slot.queries.size()), slot.queries.data());
+        }
+        slot.queries.clear();
+        slot.segments.clear();
+        slot.frame = -1;
+    }
+    enabled = false;
+}
+
+int GpuProfiler::findOrAddScope(int parent, const char* name) {
+    for (int i = 0; i < static_cast<int>(scopes.size()); ++i) {
+        if (scopes[i].parent == parent && (scopes[i].name == name || strcmp(scopes[i].name, name) == 0)) {
+            return i;
+        }
+    }
+
+    ScopeInfo info;
+    info.name = name;
+    info.parent = parent;
+    info.depth = parent >= 0 ? scopes[parent].depth + 1 : 0;
+    info.exclusiveMs = 0.0;
+    // Deeply nested or long names are cut to the buffer rather than overflowing it
+    size_t length = 0;
+    if (parent >= 0) {
+        length = appendTruncated(info.path, sizeof(info.path), length, scopes[parent].path);
+        length = appendTruncated(info.path, sizeof(info.path), length, "/");
+    }
+    appendTruncated(info.path, sizeof(info.path), length, name);
+    memset(info.history, 0, sizeof(info.history));
+    scopes.push_back(info);
+    return static_cast<int>(scopes.size()) - 1;
+}
+
+void GpuProfiler::beginSegment(int scope) {
+    FrameSlot& slot = slots[frameNumber % FRAMES_IN_FLIGHT];
+    size_t index = slot.segments.size();
+    if (index == slot.queries.size()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        slot.queries.push_back(query);
+    }
+    GLuint query = slot.queries[index];
+    slot.segments.push_back(Segment{ scope, query });
+    glBeginQuery(GL_TIME_ELAPSED, query);
+}
+
+void GpuProfiler::endSegment() {
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+void GpuProfiler::push(const char* name) {
+    if (!enabled || !inFrame || stackSize >= MAX_DEPTH) {
+        ignored++;
+        return;
+    }
+    int parent = stackSize > 0 ? stack[stackSize - 1] : -1;
+    int scope = findOrAddScope(parent, name);
+
+    // Close the parent's running segment; it resumes when this scope is popped
+    if (stackSize > 0) endSegment();
+    stack[stackSize++] = scope;
+    beginSegment(scope);
+}
+
+void GpuProfiler::pop() {
+    if (ignored > 0) {
+        ignored--;
+        return;
+    }
+    if (stackSize == 0) return;
+    endSegment();
+    stackSize--;
+    if (stackSize > 0) beginSegment(stack[stackSize - 1]);
+}
+
+void GpuProfiler::beginFrame() {
+    if (!enabled) return;
+    FrameSlot& slot = slots[frameNumber % FRAMES_IN_FLIGHT];
+    if (slot.frame >= 0 && !slot.segments.empty()) {
+        resolve(slot);
+    }
+    slot.segments.clear();
+    slot.frame = frameNumber;
+    inFrame = true;
+}
+
+void GpuProfiler::endFrame() {
+    if (!enabled) return;
+    while (stackSize > 0) pop();
+    ignored = 0;
+    inFrame = false;
+    frameNumber++;
+}
+
+void GpuProfiler::resolve(FrameSlot& slot) {
+    // Results complete in order, so the last query tells us about all of them.
+    // Never wait: a frame the GPU has not finished yet is simply dropped.
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(slot.segments.back().query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return;
+
+    for (ScopeInfo& scope : scopes) scope.exclusiveMs = 0.0;
+    for (const Segment& segment : slot.segments) {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(segment.query, GL_QUERY_RESULT, &nanoseconds);
+        scopes[segment.scope].exclusiveMs += nanoseconds * 1e-6;
+    }
+
+    // Children are registered after their parents, so a reverse walk folds
+    // each scope's total into its parent before the parent is stored
+    int historyIndex = resolvedCount % HISTORY;
+    for (int i = static_cast<int>(scopes.size()) - 1; i >= 0; --i) {
+        scopes[i].history[historyIndex] = static_cast<float>(scopes[i].exclusiveMs);
+        if (scopes[i].parent >= 0) scopes[scopes[i].parent].exclusiveMs += scopes[i].exclusiveMs;
+    }
+    resolvedFrameNumbers[historyIndex] = slot.frame;
+    resolvedCount++;
+}
+
+double GpuProfiler::averageMs(int scope) const {
+    int count = resolvedCount < AVERAGE_WINDOW ? resolvedCount : AVERAGE_WINDOW;
+    if (count == 0) return 0.0;
+    double sum = 0.0;
+    for (int i = 1; i <= count; ++i) {
+        sum += scopes[scope].history[(resolvedCount - i) % HISTORY];
+    }
+    return sum / count;
+}
+
+bool GpuProfiler::writeCsv(const char* path) const {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return false;
+    }
+
+    fprintf(file, "frame");
+    for (const ScopeInfo& scope : scopes) fprintf(file, ",%s", scope.path);
+    fprintf(file, "\n");
+
+    int count = resolvedCount < HISTORY ? resolvedCount : HISTORY;
+    for (int i = count; i >= 1; --i) {
+        int historyIndex = (resolvedCount - i) % HISTORY;
+        fprintf(file, "%lld", resolvedFrameNumbers[historyIndex]);
+        for (const ScopeInfo& scope : scopes) fprintf(file, ",%.4f", scope.history[historyIndex]);
+        fprintf(file, "\n");
+    }
+
+    fclose(file);
+    return true;
+}
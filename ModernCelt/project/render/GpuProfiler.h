@@ -0,0 +1,94 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <vector>
+
+// Scoped GPU timing built on GL_TIME_ELAPSED queries.
+// Queries are triple-buffered: the results for frame N are read back at the start
+// of frame N + FRAMES_IN_FLIGHT, by which point the GPU has long finished them, so
+// reading never stalls the pipeline. If a result is still pending it is skipped.
+//
+// GL_TIME_ELAPSED queries cannot nest, so a scope opened inside another one ends
+// the parent's query and restarts it when the child closes. Each scope therefore
+// collects "self" segments, and inclusive times are summed up from the children.
+class GpuProfiler {
+public:
+    static const int FRAMES_IN_FLIGHT = 3;
+    static const int HISTORY = 600;        // Frames kept for the CSV dump
+    static const int AVERAGE_WINDOW = 60;  // Frames in the rolling average
+    static const int MAX_DEPTH = 8;
+
+    // RAII helper; see GPU_SCOPE below
+    struct Scope {
+        Scope(GpuProfiler& profiler, const char* name) : profiler(profiler) { profiler.push(name); }
+        ~Scope() { profiler.pop(); }
+        GpuProfiler& profiler;
+    };
+
+    void initialize();
+    void cleanup();
+
+    // Call once at the start and end of every frame
+    void beginFrame();
+    void endFrame();
+
+    void push(const char* name);
+    void pop();
+
+    // Results, in registration order (parents always precede their children)
+    int scopeCount() const { return static_cast<int>(scopes.size()); }
+    const char* scopeName(int scope) const { return scopes[scope].name; }
+    const char* scopePath(int scope) const { return scopes[scope].path; }
+    int scopeDepth(int scope) const { return scopes[scope].depth; }
+    double averageMs(int scope) const;
+    int resolvedFrames() const { return resolvedCount; }
+
+    // Write every kept frame as one CSV row with one column per scope (milliseconds)
+    bool writeCsv(const char* path) const;
+
+    bool isEnabled() const { return enabled; }
+
+private:
+    struct ScopeInfo {
+        const char* name;
+        char path[96];
+        int parent;
+        int depth;
+        double exclusiveMs;         // Scratch while resolving a frame
+        float history[HISTORY];     // Inclusive milliseconds per resolved frame
+    };
+
+    struct Segment {
+        int scope;
+        GLuint query;
+    };
+
+    struct FrameSlot {
+        std::vector<GLuint> queries;     // Pool, grown on demand and reused
+        std::vector<Segment> segments;   // Segments recorded this frame
+        long long frame = -1;
+    };
+
+    std::vector<ScopeInfo> scopes;
+    FrameSlot slots[FRAMES_IN_FLIGHT];
+    long long resolvedFrameNumbers[HISTORY];
+    int stack[MAX_DEPTH];
+    int stackSize = 0;
+    int ignored = 0;   // Pushes dropped while disabled/too deep, to keep pops balanced
+    long long frameNumber = 0;
+    int resolvedCount = 0;
+    bool enabled = false;
+    bool inFrame = false;
+
+    int findOrAddScope(int parent, const char* name);
+    void beginSegment(int scope);
+    void endSegment();
+    void resolve(FrameSlot& slot);
+};
+
+GpuProfiler& gpuProfiler();
+
+#define GPU_PROFILER_CONCAT_INNER(a, b) a##b
+#define GPU_PROFILER_CONCAT(a, b) GPU_PROFILER_CONCAT_INNER(a, b)
+// Time the enclosing block on the GPU under the given (string literal) name
+#define GPU_SCOPE(name) GpuProfiler::Scope GPU_PROFILER_CONCAT(gpuScope, __LINE__)(gpuProfiler(), name)
@@ -0,0 +1,222 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+
+namespace {
+
+const uint32_t UNASSIGNED = ~0u;
+
+// FIFO post-transform cache. A vertex is cached if it went in within the last size
+// misses; hits do not move it, as in a FIFO.
+struct FifoCache {
+    std::vector<uint32_t> stamp;
+    uint32_t time;
+    uint32_t size;
+
+    FifoCache(size_t vertexCount, int cacheSize)
+        : stamp(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+    void clear() { time += size + 1; }
+
+    // Returns whether v missed, making it the newest entry if so
+    bool access(uint32_t v) {
+        if (time - stamp[v] <= size) return false;
+        stamp[v] = time++;
+        return true;
+    }
+};
+
+} // namespace
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, int cacheSize) {
+    VertexCacheStats stats;
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return stats;
+
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> referenced(vertexCount, false);
+    size_t transformed = 0, unique = 0;
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        uint32_t v = indices[i];
+        if (cache.access(v)) ++transformed;
+        if (!referenced[v]) {
+            referenced[v] = true;
+            ++unique;
+        }
+    }
+    stats.acmr = float(transformed) / float(triangleCount);
+    stats.atvr = float(transformed) / float(unique);
+    return stats;
+}
+
+// Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality
+// and Reduced Overdraw", 2007): fan out every remaining triangle around one vertex,
+// then move on to the neighbour that stays in the cache long enough to finish its own
+// fan, falling back to recently used vertices and finally to the next unfinished one
+// in index order. Linear in the triangle count.
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, int cacheSize) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertexCount == 0) return;
+
+    // Triangles around each vertex, as ranges of one flat array
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i) offsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; ++v) offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        for (int k = 0; k < 3; ++k) adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+    }
+
+    // Triangles not yet emitted around each vertex
+    std::vector<uint32_t> live(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) live[v] = offsets[v + 1] - offsets[v];
+
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnds, candidates, output;
+    deadEnds.reserve(triangleCount * 3);
+    output.reserve(triangleCount * 3);
+    size_t cursor = 0;
+
+    uint32_t fan = indices[0];
+    while (fan != UNASSIGNED) {
+        candidates.clear();
+        for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; ++a) {
+            uint32_t t = adjacency[a];
+            if (emitted[t]) continue;
+            emitted[t] = true;
+            for (int k = 0; k < 3; ++k) {
+                uint32_t v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                cache.access(v);
+            }
+        }
+
+        // The oldest neighbour that will still be cached when its fan is done
+        fan = UNASSIGNED;
+        int best = -1;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) continue;
+            int age = static_cast<int>(cache.time - cache.stamp[v]);
+            int priority = age + 2 * static_cast<int>(live[v]) <= cacheSize ? age : 0;
+            if (priority > best) {
+                best = priority;
+                fan = v;
+            }
+        }
+        while (fan == UNASSIGNED && !deadEnds.empty()) {
+            uint32_t v = deadEnds.back();
+            deadEnds.pop_back();
+            if (live[v]) fan = v;
+        }
+        while (fan == UNASSIGNED && cursor < vertexCount) {
+            if (live[cursor]) fan = static_cast<uint32_t>(cursor);
+            else ++cursor;
+        }
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const glm::vec3* positions, size_t vertexCount,
+                      int cacheSize) {
+    // Splitting a cluster may cost at most this much of its ACMR
+    const float ACMR_THRESHOLD = 1.05f;
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return;
+
+    // Hard boundaries: triangles whose vertices all miss, where the cache starts over
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<size_t> hard;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        int misses = 0;
+        for (int k = 0; k < 3; ++k) misses += cache.access(indices[t * 3 + k]);
+        if (t == 0 || misses == 3) hard.push_back(t);
+    }
+    hard.push_back(triangleCount);
+
+    // Soft boundaries inside each: wherever the part so far is as cache-efficient as
+    // the whole, starting afresh there costs little
+    std::vector<size_t> clusters;
+    for (size_t h = 0; h + 1 < hard.size(); ++h) {
+        size_t begin = hard[h], end = hard[h + 1];
+        cache.clear();
+        int misses = 0;
+        for (size_t t = begin; t < end; ++t) {
+            for (int k = 0; k < 3; ++k) misses += cache.access(indices[t * 3 + k]);
+        }
+        float limit = float(misses) / float(end - begin) * ACMR_THRESHOLD;
+
+        cache.clear();
+        clusters.push_back(begin);
+        size_t start = begin;
+        misses = 0;
+        for (size_t t = begin; t < end; ++t) {
+            for (int k = 0; k < 3; ++k) misses += cache.access(indices[t * 3 + k]);
+            if (t + 1 < end && float(misses) / float(t + 1 - start) <= limit) {
+                clusters.push_back(t + 1);
+                start = t + 1;
+                misses = 0;
+                cache.clear();
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // Area-weighted centre and facing of each cluster and of the whole mesh
+    size_t clusterCount = clusters.size() - 1;
+    std::vector<glm::vec3> centres(clusterCount), normals(clusterCount);
+    glm::vec3 meshCentre(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; ++c) {
+        glm::vec3 centre(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+            const glm::vec3& a = positions[indices[t * 3 + 0]];
+            const glm::vec3& b = positions[indices[t * 3 + 1]];
+            const glm::vec3& d = positions[indices[t * 3 + 2]];
+            glm::vec3 cross = glm::cross(b - a, d - a);
+            float weight = glm::length(cross);
+            centre += (a + b + d) * (weight / 3.0f);
+            normal += cross;
+            area += weight;
+        }
+        meshCentre += centre;
+        meshArea += area;
+        centres[c] = area > 0.0f ? centre / area : centre;
+        normals[c] = normal;
+    }
+    if (meshArea > 0.0f) meshCentre /= meshArea;
+
+    // Outward-facing clusters on the outside of the mesh first
+    std::vector<float> keys(clusterCount);
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        float length = glm::length(normals[c]);
+        keys[c] = length > 0.0f ? glm::dot(centres[c] - meshCentre, normals[c] / length) : 0.0f;
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+    for (size_t c : order) {
+        output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeVertexFetch(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>& remap) {
+    remap.assign(vertexCount, UNASSIGNED);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        uint32_t& target = remap[indices[i]];
+        if (target == UNASSIGNED) target = next++;
+        indices[i] = target;
+    }
+    for (uint32_t& target : remap) {
+        if (target == UNASSIGNED) target = next++;
+    }
+}
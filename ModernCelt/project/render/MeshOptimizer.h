@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Load-time reordering of indexed triangle lists for the GPU's vertex pipeline:
+//   optimizeVertexCache  triangle order for the post-transform cache (Tipsify)
+//   optimizeOverdraw     cache-friendly clusters of triangles, outward-facing first,
+//                        so the body occludes itself front to back more often
+//   optimizeVertexFetch  vertices in order of first use, so fetches walk memory
+// Run them in that order; each keeps what the ones before it achieved. Triangles keep
+// their winding and the meshes render identically up to depth ties.
+//
+// The post-transform cache is modelled as a FIFO of VERTEX_CACHE_SIZE entries, which
+// is how ACMR and ATVR are usually quoted. Real GPUs differ but reward the same order.
+const int VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats {
+    float acmr = 0.0f;   // Vertices transformed per triangle: 3 worst, about 0.5 best
+    float atvr = 0.0f;   // Vertices transformed per vertex referenced: 1 best
+};
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                    int cacheSize = VERTEX_CACHE_SIZE);
+
+// indices refer to vertices [0, vertexCount)
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount,
+                         int cacheSize = VERTEX_CACHE_SIZE);
+
+// Splits cache-optimized triangles into clusters where the cache would start over
+// anyway, then sorts the clusters by how far they face out from the mesh centre
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const glm::vec3* positions, size_t vertexCount,
+                      int cacheSize = VERTEX_CACHE_SIZE);
+
+// Renumbers vertices by first use and rewrites indices; remap receives the new index
+// of every old vertex, unreferenced ones last. Apply it with remapVertices().
+void optimizeVertexFetch(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>& remap);
+
+template <typename T>
+void remapVertices(std::vector<T>& vertices, const std::vector<uint32_t>& remap) {
+    std::vector<T> reordered(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) reordered[remap[i]] = vertices[i];
+    vertices.swap(reordered);
+}
@@ -0,0 +1,155 @@
+#include "OcclusionQueries.h"
+#include "render/GLState.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+
+namespace {
+
+// Box faces closer than this to the camera may be clipped by the near plane,
+// which would make a box the camera stands in look hidden
+const float NEAR_MARGIN = 0.5f;
+
+} // namespace
+
+void OcclusionQueries::initialize(const Config& requested, GLuint depthProgram) {
+    config = requested;
+    config.revalidateInterval = std::max(1, config.revalidateInterval);
+    programID = depthProgram;
+    viewProjectionID = glGetUniformLocation(programID, "lightSpaceMatrix");
+    modelID = glGetUniformLocation(programID, "model");
+
+    const QueryBoxVertex corners[8] = {
+        {{ -1.0f, -1.0f, -1.0f }}, {{ 1.0f, -1.0f, -1.0f }}, {{ 1.0f, 1.0f, -1.0f }}, {{ -1.0f, 1.0f, -1.0f }},
+        {{ -1.0f, -1.0f,  1.0f }}, {{ 1.0f, -1.0f,  1.0f }}, {{ 1.0f, 1.0f,  1.0f }}, {{ -1.0f, 1.0f,  1.0f }},
+    };
+    const GLuint indices[36] = {
+        0, 2, 1, 0, 3, 2,   // -z
+        4, 5, 6, 4, 6, 7,   // +z
+        0, 1, 5, 0, 5, 4,   // -y
+        3, 6, 2, 3, 7, 6,   // +y
+        0, 4, 7, 0, 7, 3,   // -x
+        1, 2, 6, 1, 6, 5,   // +x
+    };
+    box.initialize(corners, 8, indices, 36);
+
+    objects.clear();
+    frameNumber = 0;
+    frameStats = Stats();
+}
+
+void OcclusionQueries::cleanup() {
+    for (Object& entry : objects) {
+        if (entry.queries[0]) glDeleteQueries(QUERIES_PER_OBJECT, entry.queries);
+    }
+    objects.clear();
+    box.cleanup();
+}
+
+OcclusionQueries::Object& OcclusionQueries::object(uint32_t id) {
+    if (id >= objects.size()) {
+        size_t first = objects.size();
+        objects.resize(id + 1);
+        // Spread the revalidation of visible objects over the interval
+        for (size_t i = first; i < objects.size(); ++i) {
+            objects[i].lastIssued = frameNumber - static_cast<long long>(i % config.revalidateInterval);
+        }
+    }
+    Object& entry = objects[id];
+    if (!entry.queries[0]) glGenQueries(QUERIES_PER_OBJECT, entry.queries);
+    return entry;
+}
+
+// Results finish in order, so stop at the first one that is not ready
+void OcclusionQueries::poll(Object& entry) {
+    while (entry.inFlight > 0) {
+        GLuint query = entry.queries[entry.oldest];
+        GLuint available = 0;
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+        GLuint passed = 0;
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT, &passed);
+        entry.visible = passed != 0;
+        entry.oldest = (entry.oldest + 1) % QUERIES_PER_OBJECT;
+        entry.inFlight--;
+    }
+}
+
+void OcclusionQueries::beginFrame(const glm::mat4& matrix, const glm::vec3& position) {
+    frameNumber++;
+    viewProjection = matrix;
+    cameraPosition = position;
+    frameStats = Stats();
+    for (Object& entry : objects) {
+        poll(entry);
+        frameStats.pending += entry.inFlight;
+    }
+}
+
+bool OcclusionQueries::wasVisible(uint32_t id) {
+    return object(id).visible;
+}
+
+GLuint OcclusionQueries::startQuery(Object& entry) {
+    GLuint query = entry.queries[(entry.oldest + entry.inFlight) % QUERIES_PER_OBJECT];
+    entry.inFlight++;
+    entry.lastIssued = frameNumber;
+    frameStats.issued++;
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, query);
+    queryActive = true;
+    return query;
+}
+
+void OcclusionQueries::beginVisible(uint32_t id) {
+    Object& entry = object(id);
+    frameStats.visible++;
+    if (frameNumber - entry.lastIssued >= config.revalidateInterval && entry.inFlight < QUERIES_PER_OBJECT) {
+        startQuery(entry);
+    }
+}
+
+void OcclusionQueries::endVisible() {
+    if (!queryActive) return;
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+    queryActive = false;
+}
+
+void OcclusionQueries::beginHidden(uint32_t id, const AABB& bounds) {
+    Object& entry = object(id);
+    frameStats.hidden++;
+
+    // Draw unconditionally when there is no query left to test with, or the box cannot be trusted
+    glm::vec3 margin(NEAR_MARGIN);
+    bool cameraInside = glm::all(glm::greaterThanEqual(cameraPosition, bounds.min - margin)) &&
+                        glm::all(glm::lessThanEqual(cameraPosition, bounds.max + margin));
+    if (cameraInside) entry.visible = true;
+    if (cameraInside || entry.inFlight == QUERIES_PER_OBJECT) return;
+
+    // Depth-tested box with no writes; back faces too, in case the front ones are clipped
+    glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), bounds.center()), bounds.extents());
+    glState().useProgram(programID);
+    glUniformMatrix4fv(viewProjectionID, 1, GL_FALSE, &viewProjection[0][0]);
+    glUniformMatrix4fv(modelID, 1, GL_FALSE, &model[0][0]);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glState().depthMask(GL_FALSE);
+    glState().disable(GL_CULL_FACE);
+    box.bind();
+
+    GLuint query = startQuery(entry);
+    glDrawElements(GL_TRIANGLES, box.indexCount, GL_UNSIGNED_INT, 0);
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+    queryActive = false;
+
+    glState().enable(GL_CULL_FACE);
+    glState().depthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    // The GPU waits for the box result; the CPU never does
+    glBeginConditionalRender(query, GL_QUERY_WAIT);
+    conditionActive = true;
+}
+
+void OcclusionQueries::endHidden() {
+    if (!conditionActive) return;
+    glEndConditionalRender();
+    conditionActive = false;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include "render/VertexFormat.h"
+#include "scene/Bounds.h"
+#include <cstdint>
+#include <vector>
+
+// Corner of the unit cube drawn for bounding box queries
+struct QueryBoxVertex {
+    glm::vec3 position;
+};
+
+template <> struct VertexLayout<QueryBoxVertex> {
+    static constexpr std::array<VertexAttribute, 1> attributes = {{
+        VERTEX_ATTRIBUTE(QueryBoxVertex, position, 0),
+    }};
+};
+
+// Hardware occlusion culling with GL_ANY_SAMPLES_PASSED queries, after CHC++.
+// Every object remembers what its latest finished query said. Objects that were
+// visible are drawn first, as usual, and every few frames their draw doubles as
+// the query that notices when they become hidden. Objects that were hidden are
+// drawn after them: their bounding box is rasterized inside a query with colour
+// and depth writes off, and the object itself is drawn under conditional
+// rendering on that query, so the GPU drops it unless a box sample passed.
+//
+// Results are only polled, never waited on by the CPU; an object keeps its last
+// state until a result arrives. Each object has a few queries in flight so a slow
+// result does not stop it from being tested again.
+class OcclusionQueries {
+public:
+    static const int QUERIES_PER_OBJECT = 3;
+
+    struct Config {
+        int revalidateInterval = 4;   // Frames between queries on a visible object
+    };
+
+    // Work done since the last beginFrame()
+    struct Stats {
+        int visible = 0;    // Drawn directly because the last result passed
+        int hidden = 0;     // Drawn conditionally because the last result failed
+        int issued = 0;     // Queries started
+        int pending = 0;    // Queries from earlier frames still in flight
+    };
+
+    // Boxes are drawn with depthProgram; it needs "lightSpaceMatrix" and "model" uniforms like depth.vert
+    void initialize(const Config& config, GLuint depthProgram);
+    void cleanup();
+
+    // Collect finished results. Box queries are drawn with viewProjection; the camera
+    // position lets objects the camera is inside skip the box test.
+    void beginFrame(const glm::mat4& viewProjection, const glm::vec3& cameraPosition);
+
+    // Whether the latest result for object id had samples pass; new objects count as visible
+    bool wasVisible(uint32_t id);
+
+    // Wrap the draw of a visible object; it is only queried when revalidation is due
+    void beginVisible(uint32_t id);
+    void endVisible();
+
+    // Test the world bounds of a hidden object and start conditional rendering on the
+    // result; draw the object, then call endHidden()
+    void beginHidden(uint32_t id, const AABB& bounds);
+    void endHidden();
+
+    const Stats& stats() const { return frameStats; }
+
+private:
+    struct Object {
+        GLuint queries[QUERIES_PER_OBJECT] = {};
+        int oldest = 0;              // Ring index of the oldest query in flight
+        int inFlight = 0;
+        bool visible = true;
+        long long lastIssued = 0;    // Frame of the newest query
+    };
+
+    Config config;
+    std::vector<Object> objects;     // Indexed by id, grown on demand
+    InterleavedMesh<QueryBoxVertex> box;
+    GLuint programID = 0;
+    GLuint viewProjectionID = 0;
+    GLuint modelID = 0;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    long long frameNumber = 0;
+    bool queryActive = false;
+    bool conditionActive = false;
+    Stats frameStats;
+
+    Object& object(uint32_t id);
+    GLuint startQuery(Object& object);
+    void poll(Object& object);
+};
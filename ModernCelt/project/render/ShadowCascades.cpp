@@ -0,0 +1,225 @@
+#include "ShadowCascades.h"
+#include "GLState.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Depth texture array with one framebuffer per layer, so switching cascades is a single bind
+GLuint ShadowCascades::createDepthArray(GLuint framebufferNames[]) {
+    GLuint depthArray;
+    glGenTextures(1, &depthArray);
+    glState().bindTexture(1, GL_TEXTURE_2D_ARRAY, depthArray);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, config.resolution, config.resolution,
+                 config.cascadeCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+    glGenFramebuffers(config.cascadeCount, framebufferNames);
+    for (int i = 0; i < config.cascadeCount; ++i) {
+        glState().bindFramebuffer(GL_FRAMEBUFFER, framebufferNames[i]);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthArray, 0, i);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Shadow cascade framebuffer " << i << " is not complete!" << std::endl;
+            depthArray = 0;
+        }
+    }
+    glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    return depthArray;
+}
+
+bool ShadowCascades::initialize(const Config& requested) {
+    config = requested;
+    config.cascadeCount = std::max(1, std::min(config.cascadeCount, MAX_CASCADES));
+    config.cacheSnap = std::max(0.0f, std::min(config.cacheSnap, 0.5f));
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    config.resolution = std::max(256, std::min(config.resolution, static_cast<int>(maxSize)));
+
+    // The sampled layers, plus the cached static layers they are rebuilt from
+    texture = createDepthArray(framebuffers);
+    bool complete = texture != 0;
+    if (config.cacheStatic) {
+        staticTexture = createDepthArray(staticFramebuffers);
+        complete = complete && staticTexture != 0;
+    }
+
+    glGenBuffers(1, &uniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(UniformBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BINDING, uniformBuffer);
+
+    for (Cascade& cascade : cascades) {
+        cascade = Cascade{ glm::mat4(1.0f), 0.0f,
+                           false, false, false, glm::mat4(1.0f), 0 };
+    }
+    reusedFrames = 0;
+    passCount = 0;
+    return complete;
+}
+
+void ShadowCascades::cleanup() {
+    if (framebuffers[0]) glDeleteFramebuffers(config.cascadeCount, framebuffers);
+    if (staticFramebuffers[0]) glDeleteFramebuffers(config.cascadeCount, staticFramebuffers);
+    for (int i = 0; i < MAX_CASCADES; ++i) framebuffers[i] = staticFramebuffers[i] = 0;
+    GLuint textures[2] = { texture, staticTexture };
+    for (GLuint depthArray : textures) {
+        if (!depthArray) continue;
+        glState().forgetTexture(depthArray);
+        glDeleteTextures(1, &depthArray);
+    }
+    if (uniformBuffer) glDeleteBuffers(1, &uniformBuffer);
+    texture = staticTexture = 0;
+    uniformBuffer = 0;
+}
+
+void ShadowCascades::attachProgram(GLuint program) const {
+    GLuint blockIndex = glGetUniformBlockIndex(program, "ShadowCascades");
+    if (blockIndex == GL_INVALID_INDEX) {
+        std::cerr << "Program " << program << " has no ShadowCascades block" << std::endl;
+        return;
+    }
+    glUniformBlockBinding(program, blockIndex, UNIFORM_BINDING);
+}
+
+void ShadowCascades::update(const glm::mat4& view, float fovY, float aspect, float nearPlane, const glm::vec3& lightDirection) {
+    casterStats = Stats();
+
+    glm::vec3 lightUp = std::abs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), lightDirection, lightUp);
+
+    glm::mat4 inverseView = glm::inverse(view);
+    float tanHalfFov = std::tan(0.5f * fovY);
+    float farPlane = config.maxDistance;
+    int count = config.cascadeCount;
+
+    // Cascades move in steps of snapTexels. The box grows by half a step on each
+    // side so the slice stays inside it wherever the camera is within the step:
+    // halfExtent = radius + snapTexels * texel / 2, with texel = 2 * halfExtent / resolution
+    int snapTexels = config.cacheStatic ? std::max(1, static_cast<int>(config.cacheSnap * config.resolution)) : 1;
+    float growth = 1.0f / (1.0f - static_cast<float>(snapTexels) / config.resolution);
+
+    UniformBlock block;
+    block.splits = glm::vec4(0.0f);
+    block.texelSizes = glm::vec4(0.0f);
+    block.cameraView = view;
+    block.cascadeCount = glm::ivec4(count, 0, 0, 0);
+
+    float splitNear = nearPlane;
+    for (int i = 0; i < count; ++i) {
+        // Practical split: blend of logarithmic and uniform distributions
+        float p = static_cast<float>(i + 1) / count;
+        float logSplit = nearPlane * std::pow(farPlane / nearPlane, p);
+        float uniformSplit = nearPlane + (farPlane - nearPlane) * p;
+        float splitFar = config.splitLambda * logSplit + (1.0f - config.splitLambda) * uniformSplit;
+
+        // Bounding sphere of the slice. The centre sits on the view axis, so the
+        // radius depends only on the split depths and not on the camera rotation.
+        float nearHalfHeight = splitNear * tanHalfFov;
+        float farHalfHeight = splitFar * tanHalfFov;
+        glm::vec3 farCorner(farHalfHeight * aspect, farHalfHeight, -splitFar);
+        glm::vec3 nearCorner(nearHalfHeight * aspect, nearHalfHeight, -splitNear);
+        float farSq = glm::dot(glm::vec2(farCorner), glm::vec2(farCorner));
+        float nearSq = glm::dot(glm::vec2(nearCorner), glm::vec2(nearCorner));
+        // Depth on the axis equidistant from the near and far corner rings, clamped into the slice
+        float centerDepth = 0.5f * (splitNear + splitFar) + (farSq - nearSq) / (2.0f * (splitFar - splitNear));
+        centerDepth = std::min(centerDepth, splitFar);
+        glm::vec3 centerView(0.0f, 0.0f, -centerDepth);
+        float radius = std::max(glm::length(farCorner - centerView), glm::length(nearCorner - centerView));
+        radius = std::ceil(radius * 16.0f) / 16.0f * growth;
+
+        // Snap the centre to the middle of a grid cell in light space
+        glm::vec3 centerWorld = glm::vec3(inverseView * glm::vec4(centerView, 1.0f));
+        glm::vec3 centerLight = glm::vec3(lightView * glm::vec4(centerWorld, 1.0f));
+        float texelSize = 2.0f * radius / config.resolution;
+        float step = snapTexels * texelSize;
+        centerLight = (glm::floor(centerLight / step) + 0.5f) * step;
+
+        // Casters in front of the near plane are kept by depth clamping during the shadow pass
+        float nearDepth = -centerLight.z - radius;
+        float farDepth = -centerLight.z + radius;
+        glm::mat4 projection = glm::ortho(centerLight.x - radius, centerLight.x + radius,
+                                          centerLight.y - radius, centerLight.y + radius,
+                                          nearDepth, farDepth);
+
+        Cascade& cascade = cascades[i];
+        cascade.lightSpaceMatrix = projection * lightView;
+        cascade.splitFar = splitFar;
+        cascade.staticRendered = false;
+
+        block.lightSpaceMatrices[i] = cascade.lightSpaceMatrix;
+        block.splits[i] = splitFar;
+        block.texelSizes[i] = texelSize;
+        splitNear = splitFar;
+    }
+    for (int i = count; i < MAX_CASCADES; ++i) block.lightSpaceMatrices[i] = glm::mat4(1.0f);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(UniformBlock), &block);
+}
+
+bool ShadowCascades::beginStatic(int index) {
+    Cascade& cascade = cascades[index];
+    if (!config.cacheStatic) {
+        glState().bindFramebuffer(GL_FRAMEBUFFER, framebuffers[index]);
+        glViewport(0, 0, config.resolution, config.resolution);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        cascade.staticRendered = true;
+        casterStats.staticRendered++;
+        return true;
+    }
+
+    // The matrix covers both the light direction and the cascade's placement
+    if (cascade.staticValid && cascade.staticRevision == staticRevision &&
+        cascade.staticMatrix == cascade.lightSpaceMatrix) {
+        casterStats.staticReused++;
+        return false;
+    }
+
+    glState().bindFramebuffer(GL_FRAMEBUFFER, staticFramebuffers[index]);
+    glViewport(0, 0, config.resolution, config.resolution);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    cascade.staticValid = true;
+    cascade.staticRendered = true;
+    cascade.staticMatrix = cascade.lightSpaceMatrix;
+    cascade.staticRevision = staticRevision;
+    casterStats.staticRendered++;
+    return true;
+}
+
+bool ShadowCascades::beginDynamic(int index, bool hasDynamicCasters) {
+    Cascade& cascade = cascades[index];
+    if (!config.cacheStatic) {
+        // Static casters were drawn straight into the sampled layer
+        glState().bindFramebuffer(GL_FRAMEBUFFER, framebuffers[index]);
+        return hasDynamicCasters;
+    }
+
+    // The sampled layer already equals the static one unless either changed since last frame
+    if (cascade.staticRendered || cascade.liveHasDynamic || hasDynamicCasters) {
+        glState().bindFramebuffer(GL_READ_FRAMEBUFFER, staticFramebuffers[index]);
+        glState().bindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[index]);
+        glBlitFramebuffer(0, 0, config.resolution, config.resolution, 0, 0, config.resolution, config.resolution,
+                          GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        casterStats.composited++;
+    }
+    glState().bindFramebuffer(GL_FRAMEBUFFER, framebuffers[index]);
+    glViewport(0, 0, config.resolution, config.resolution);
+    cascade.liveHasDynamic = hasDynamicCasters;
+    return hasDynamicCasters;
+}
+
+void ShadowCascades::endPass() {
+    passCount++;
+    if (casterStats.staticRendered == 0) reusedFrames++;
+}
+
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include "scene/Frustum.h"
+#include <cstdint>
+
+// Cascaded shadow maps for a directional light.
+// The camera frustum up to maxDistance is cut into slices with the practical split
+// scheme, and each slice renders into its own layer of a depth texture array.
+// A cascade's ortho box is fitted to the bounding sphere of its slice, so its size
+// does not change as the camera turns, and its origin is snapped to whole shadow
+// texels so edges do not shimmer while the camera moves.
+//
+// Static casters are cached: each cascade keeps a static depth layer that is only
+// re-rendered when the cascade's light-space box, the light, or a static caster's
+// revision changes. To make that rare, the cache snaps cascades to a coarse grid
+// (cacheSnap of the cascade width) and widens them so the slice still fits. Every
+// frame the static layer is copied into the sampled layer and dynamic casters are
+// drawn on top; the copy is skipped while no dynamic caster touches the cascade.
+//
+// Shaders read the cascades through the std140 "ShadowCascades" uniform block
+// (see terrain.frag); call attachProgram() once for every program that uses it.
+class ShadowCascades {
+public:
+    static constexpr int MAX_CASCADES = 4;
+    static constexpr GLuint UNIFORM_BINDING = 0;
+
+    struct Config {
+        int cascadeCount = 3;
+        int resolution = 2048;        // Width and height of each cascade layer
+        float maxDistance = 250.0f;   // Shadows fade out this far from the camera
+        float splitLambda = 0.75f;    // 0 = uniform splits, 1 = logarithmic splits
+        bool cacheStatic = true;      // Keep static casters in a separate cached layer
+        float cacheSnap = 0.125f;     // Cached cascades move in steps of this fraction of their width
+    };
+
+    // Work done since the last update()
+    struct Stats {
+        int staticRendered = 0;   // Cascades whose static layer was re-rendered
+        int staticReused = 0;     // Cascades that reused their cached static layer
+        int composited = 0;       // Static layers copied into the sampled layer
+    };
+
+    bool initialize(const Config& config);
+    void cleanup();
+
+    // Fit every cascade to the camera; lightDirection points away from the light
+    void update(const glm::mat4& view, float fovY, float aspect, float nearPlane, const glm::vec3& lightDirection);
+
+    // Sum of the static casters' revisions; any change invalidates every cascade
+    void setStaticRevision(uint64_t revision) { staticRevision = revision; }
+
+    // Returns true when the static casters must be drawn for this cascade, with
+    // the target bound and cleared. Returns false when the cached layer is reused.
+    bool beginStatic(int cascade);
+
+    // Prepare the sampled layer for dynamic casters and return whether to draw them
+    bool beginDynamic(int cascade, bool hasDynamicCasters);
+
+    // Call after the last cascade; counts frames that reused every static layer
+    void endPass();
+
+    // Volume holding every caster that can shadow the cascade. It has no near plane:
+    // casters between the light and the box are clamped onto it instead of clipped.
+    Frustum casterFrustum(int cascade) const { return Frustum::fromMatrix(cascades[cascade].lightSpaceMatrix, false); }
+
+    // Route the program's ShadowCascades block to our uniform buffer
+    void attachProgram(GLuint program) const;
+
+    int count() const { return config.cascadeCount; }
+    int resolution() const { return config.resolution; }
+    GLuint depthTexture() const { return texture; }
+    GLuint framebuffer(int cascade) const { return framebuffers[cascade]; }
+    const glm::mat4& lightSpaceMatrix(int cascade) const { return cascades[cascade].lightSpaceMatrix; }
+    float splitDistance(int cascade) const { return cascades[cascade].splitFar; }
+    const Stats& stats() const { return casterStats; }
+    uint64_t cachedFrames() const { return reusedFrames; }
+    uint64_t totalFrames() const { return passCount; }
+
+private:
+    struct Cascade {
+        glm::mat4 lightSpaceMatrix;
+        float splitFar;       // Camera view depth where the cascade ends
+
+        // Static cache
+        bool staticValid;
+        bool staticRendered;  // Static layer was re-rendered this frame
+        bool liveHasDynamic;  // Sampled layer holds dynamic casters on top of the static copy
+        glm::mat4 staticMatrix;
+        uint64_t staticRevision;
+    };
+
+    // Mirror of the std140 ShadowCascades block
+    struct UniformBlock {
+        glm::mat4 lightSpaceMatrices[MAX_CASCADES];
+        glm::vec4 splits;        // Camera view depth where each cascade ends
+        glm::vec4 texelSizes;    // World size of one shadow texel per cascade
+        glm::mat4 cameraView;
+        glm::ivec4 cascadeCount; // x only
+    };
+
+    Config config;
+    Cascade cascades[MAX_CASCADES];
+    GLuint texture = 0;
+    GLuint framebuffers[MAX_CASCADES] = {};
+    GLuint staticTexture = 0;
+    GLuint staticFramebuffers[MAX_CASCADES] = {};
+    GLuint uniformBuffer = 0;
+    Stats casterStats;
+    uint64_t staticRevision = 0;
+    uint64_t reusedFrames = 0;
+    uint64_t passCount = 0;
+
+    GLuint createDepthArray(GLuint framebufferNames[]);
+};
@@ -0,0 +1,203 @@
+#include "TextureCache.h"
+#include "render/BlockCompression.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+namespace {
+
+const char FILE_MAGIC[4] = { 'M', 'C', 'T', 'X' };
+const uint32_t FILE_VERSION = 1;
+const size_t LEVEL_ALIGNMENT = 16;
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t format;
+    uint32_t levelCount;
+    uint64_t stamp;
+};
+
+struct FileLevel {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;   // From the start of the file
+    uint64_t size;
+};
+
+size_t alignUp(size_t value) {
+    return (value + LEVEL_ALIGNMENT - 1) & ~(LEVEL_ALIGNMENT - 1);
+}
+
+size_t levelSize(TextureFormat format, int width, int height) {
+    switch (format) {
+    case TextureFormat::RGB8: return static_cast<size_t>(width) * height * 3;
+    case TextureFormat::RGBA8: return static_cast<size_t>(width) * height * 4;
+    case TextureFormat::BC1: return blockEncodedSize(BlockFormat::BC1, width, height);
+    case TextureFormat::BC3: return blockEncodedSize(BlockFormat::BC3, width, height);
+    case TextureFormat::BC5: return blockEncodedSize(BlockFormat::BC5, width, height);
+    }
+    return 0;
+}
+
+// Average each 2x2 footprint; the last row or column of an odd-sized level is reused
+void downsample(const uint8_t* source, int width, int height, uint8_t* target) {
+    int targetWidth = std::max(1, width / 2);
+    int targetHeight = std::max(1, height / 2);
+    for (int y = 0; y < targetHeight; ++y) {
+        int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for (int x = 0; x < targetWidth; ++x) {
+            int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            for (int c = 0; c < 4; ++c) {
+                int sum = source[(y0 * width + x0) * 4 + c] + source[(y0 * width + x1) * 4 + c] +
+                          source[(y1 * width + x0) * 4 + c] + source[(y1 * width + x1) * 4 + c];
+                target[(y * targetWidth + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+void storeLevel(TextureFormat format, const uint8_t* rgba, int width, int height, uint8_t* out) {
+    size_t pixels = static_cast<size_t>(width) * height;
+    switch (format) {
+    case TextureFormat::RGB8:
+        for (size_t i = 0; i < pixels; ++i) memcpy(out + i * 3, rgba + i * 4, 3);
+        break;
+    case TextureFormat::RGBA8:
+        memcpy(out, rgba, pixels * 4);
+        break;
+    case TextureFormat::BC1:
+        encodeBlocks(BlockFormat::BC1, rgba, width, height, out);
+        break;
+    case TextureFormat::BC3:
+        encodeBlocks(BlockFormat::BC3, rgba, width, height, out);
+        break;
+    case TextureFormat::BC5:
+        encodeBlocks(BlockFormat::BC5, rgba, width, height, out);
+        break;
+    }
+}
+
+} // namespace
+
+size_t TextureImage::byteSize() const {
+    size_t total = 0;
+    for (const Level& level : levels) total += level.size;
+    return total;
+}
+
+void buildTextureImage(const uint8_t* rgba, int width, int height, TextureFormat format, TextureImage& image) {
+    image.format = format;
+    image.levels.clear();
+    image.mapping.close();
+
+    // Lay the levels out first so storage is allocated once
+    std::vector<size_t> offsets;
+    size_t total = 0;
+    for (int w = width, h = height;; w = std::max(1, w / 2), h = std::max(1, h / 2)) {
+        offsets.push_back(total);
+        total = alignUp(total + levelSize(format, w, h));
+        image.levels.push_back(TextureImage::Level{ w, h, nullptr, levelSize(format, w, h) });
+        if (w == 1 && h == 1) break;
+    }
+    image.storage.assign(total, 0);
+
+    std::vector<uint8_t> current(rgba, rgba + static_cast<size_t>(width) * height * 4);
+    std::vector<uint8_t> next;
+    for (size_t i = 0; i < image.levels.size(); ++i) {
+        TextureImage::Level& level = image.levels[i];
+        level.data = image.storage.data() + offsets[i];
+        storeLevel(format, current.data(), level.width, level.height, image.storage.data() + offsets[i]);
+        if (i + 1 < image.levels.size()) {
+            next.resize(static_cast<size_t>(image.levels[i + 1].width) * image.levels[i + 1].height * 4);
+            downsample(current.data(), level.width, level.height, next.data());
+            current.swap(next);
+        }
+    }
+}
+
+bool readTextureCache(const std::string& path, uint64_t stamp, TextureImage& image) {
+    if (!image.mapping.open(path)) return false;
+    const uint8_t* bytes = image.mapping.data();
+    size_t size = image.mapping.size();
+
+    FileHeader header;
+    if (size < sizeof(header)) return false;
+    memcpy(&header, bytes, sizeof(header));
+    if (memcmp(header.magic, FILE_MAGIC, 4) != 0 || header.version != FILE_VERSION || header.stamp != stamp ||
+        header.format > static_cast<uint32_t>(TextureFormat::BC5) || header.levelCount == 0 || header.levelCount > 32 ||
+        size < sizeof(header) + header.levelCount * sizeof(FileLevel)) {
+        image.mapping.close();
+        return false;
+    }
+
+    image.format = static_cast<TextureFormat>(header.format);
+    image.levels.clear();
+    image.storage.clear();
+    for (uint32_t i = 0; i < header.levelCount; ++i) {
+        FileLevel level;
+        memcpy(&level, bytes + sizeof(header) + i * sizeof(FileLevel), sizeof(level));
+        bool valid = level.width > 0 && level.height > 0 && level.offset <= size && level.size <= size - level.offset &&
+                     level.size == levelSize(image.format, int(level.width), int(level.height));
+        if (!valid) {
+            std::cerr << "Texture cache " << path << " is damaged" << std::endl;
+            image.levels.clear();
+            image.mapping.close();
+            return false;
+        }
+        image.levels.push_back(TextureImage::Level{ int(level.width), int(level.height), bytes + level.offset, size_t(level.size) });
+    }
+    return true;
+}
+
+bool writeTextureCache(const std::string& path, uint64_t stamp, const TextureImage& image) {
+    // Written under a temporary name and renamed, so readers never see half a file
+    std::string temporary = path + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file) return false;
+
+    FileHeader header;
+    memcpy(header.magic, FILE_MAGIC, 4);
+    header.version = FILE_VERSION;
+    header.format = static_cast<uint32_t>(image.format);
+    header.levelCount = static_cast<uint32_t>(image.levels.size());
+    header.stamp = stamp;
+
+    std::vector<FileLevel> table;
+    size_t offset = alignUp(sizeof(header) + image.levels.size() * sizeof(FileLevel));
+    for (const TextureImage::Level& level : image.levels) {
+        table.push_back(FileLevel{ uint32_t(level.width), uint32_t(level.height), offset, level.size });
+        offset = alignUp(offset + level.size);
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(table.data(), sizeof(FileLevel), table.size(), file) == table.size();
+    static const uint8_t padding[LEVEL_ALIGNMENT] = {};
+    size_t written = sizeof(header) + table.size() * sizeof(FileLevel);
+    for (size_t i = 0; ok && i < image.levels.size(); ++i) {
+        size_t pad = table[i].offset - written;
+        ok = fwrite(padding, 1, pad, file) == pad && fwrite(image.levels[i].data, 1, image.levels[i].size, file) == image.levels[i].size;
+        written = table[i].offset + image.levels[i].size;
+    }
+    ok = fclose(file) == 0 && ok;
+
+    std::error_code error;
+    if (ok) std::filesystem::rename(temporary, path, error);
+    if (!ok || error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "core/MappedFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Storage formats of a cached texture; BC1/BC3 need GL_EXT_texture_compression_s3tc,
+// BC5 (RGTC2) is core since GL 3.0
+enum class TextureFormat : uint32_t { RGB8, RGBA8, BC1, BC3, BC5 };
+
+// A texture ready for upload: its format and the complete mip chain, largest first.
+// Level data points either into a mapped cache file or into storage.
+struct TextureImage {
+    struct Level {
+        int width;
+        int height;
+        const uint8_t* data;
+        size_t size;
+    };
+
+    TextureFormat format = TextureFormat::RGBA8;
+    std::vector<Level> levels;
+    MappedFile mapping;
+    std::vector<uint8_t> storage;
+
+    size_t byteSize() const;
+};
+
+// Box-filter the full mip chain of an RGBA8 image and store every level in format
+void buildTextureImage(const uint8_t* rgba, int width, int height, TextureFormat format, TextureImage& image);
+
+// Cache files hold a header, a level table and then the level data, each level
+// 16-byte aligned. The stamp identifies the source and the settings it was built
+// with; reading a file with a different stamp fails, so stale files get rebuilt.
+// Reading maps the file and points the levels straight into the mapping.
+bool readTextureCache(const std::string& path, uint64_t stamp, TextureImage& image);
+bool writeTextureCache(const std::string& path, uint64_t stamp, const TextureImage& image);
+
+// FNV-1a, for cache stamps and file names
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
@@ -0,0 +1,407 @@
+#include "TextureLoader.h"
+#include "render/GLState.h"
+#include "core/AllocationTracker.h"
+#include "core/CpuProfiler.h"
+#include "core/JobSystem.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace {
+
+// Lane this thread publishes into, claimed on its first decode
+thread_local int laneIndex = -1;
+
+// Decode jobs still queued or running
+JobCounter decodeJobs;
+
+} // namespace
+
+TextureLoader& textureLoader() {
+    static TextureLoader loader;
+    return loader;
+}
+
+void TextureLoader::initialize(const Config& requested) {
+    config = requested;
+
+    s3tc = false;
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; ++i) {
+        const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (name && strcmp(name, "GL_EXT_texture_compression_s3tc") == 0) s3tc = true;
+    }
+    std::cout << "Texture cache: " << (config.cacheDirectory.empty() ? "off" : config.cacheDirectory)
+              << ", compression " << (!config.compress ? "off" : s3tc ? "BC1/BC3/BC5" : "BC5 only (no S3TC)") << std::endl;
+
+    // A lane per worker, one for the render thread and one for the simulation
+    // thread (both run jobs while they wait), then the shared lane
+    int laneCount = jobSystem().workerCount() + 3;
+    lanes.clear();
+    for (int i = 0; i < laneCount; ++i) lanes.emplace_back(new Lane());
+    nextLane = 0;
+    decodedCount = 0;
+    requests.clear();
+    frameStats = Stats();
+}
+
+void TextureLoader::cleanup() {
+    // Anything still in flight was decoded for nothing
+    jobSystem().wait(decodeJobs);
+    for (std::unique_ptr<Lane>& lane : lanes) {
+        Decoded decoded;
+        while (lane->queue.pop(decoded)) delete decoded.image;
+    }
+    lanes.clear();
+    for (Request& entry : requests) {
+        glState().forgetTexture(entry.texture);
+        glDeleteTextures(1, &entry.texture);
+    }
+    requests.clear();
+}
+
+GLuint TextureLoader::request(const std::string& key, const Params& params, bool& created) {
+    for (const Request& entry : requests) {
+        if (entry.key == key) {
+            created = false;
+            return entry.texture;
+        }
+    }
+
+    Request entry;
+    entry.key = key;
+    entry.params = params;
+    glGenTextures(1, &entry.texture);
+    glState().bindTexture(0, GL_TEXTURE_2D, entry.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &params.placeholder[0]);
+
+    requests.push_back(std::move(entry));
+    frameStats.requested++;
+    created = true;
+    return requests.back().texture;
+}
+
+GLuint TextureLoader::load(const std::string& path, const Params& params) {
+    bool created;
+    GLuint texture = request(path, params, created);
+    if (created) {
+        int index = static_cast<int>(requests.size()) - 1;
+        jobSystem().run([this, index, path, params] { decode(index, path, nullptr, params); }, &decodeJobs);
+    }
+    return texture;
+}
+
+GLuint TextureLoader::loadEncoded(const std::string& key, const unsigned char* bytes, size_t size, const Params& params) {
+    bool created;
+    GLuint texture = request(key, params, created);
+    if (created) {
+        int index = static_cast<int>(requests.size()) - 1;
+        auto encoded = std::make_shared<std::vector<unsigned char>>(bytes, bytes + size);
+        jobSystem().run([this, index, key, encoded, params] { decode(index, key, encoded.get(), params); }, &decodeJobs);
+    }
+    return texture;
+}
+
+std::string TextureLoader::cachePath(const std::string& key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.mctex", (unsigned long long)hashBytes(key.data(), key.size()));
+    return config.cacheDirectory + "/" + name;
+}
+
+TextureFormat TextureLoader::chooseFormat(const Params& params, const unsigned char* rgba, int width, int height) const {
+    TextureFormat uncompressed = params.channels == 4 ? TextureFormat::RGBA8 : TextureFormat::RGB8;
+    if (!config.compress) return uncompressed;
+    if (params.normalMap) return TextureFormat::BC5;
+    if (!s3tc) return uncompressed;
+    if (params.channels == 4) {
+        size_t pixels = static_cast<size_t>(width) * height;
+        for (size_t i = 0; i < pixels; ++i) {
+            if (rgba[i * 4 + 3] != 255) return TextureFormat::BC3;
+        }
+    }
+    return TextureFormat::BC1;
+}
+
+// Worker side: map the cached texture, or decode and build it and fill the cache,
+// then hand it to the render thread. encoded is null when key is a file path.
+void TextureLoader::decode(int request, const std::string& key, const std::vector<unsigned char>* encoded, const Params& params) {
+    CPU_SCOPE("Decode texture");
+    AllowAllocations allow;
+
+    // The stamp covers the source and everything that decides the stored format
+    uint64_t stamp = hashBytes(key.data(), key.size());
+    int settings[4] = { params.channels, params.normalMap ? 1 : 0, config.compress ? 1 : 0, s3tc ? 1 : 0 };
+    stamp = hashBytes(settings, sizeof(settings), stamp);
+    if (encoded) {
+        stamp = hashBytes(encoded->data(), encoded->size(), stamp);
+    } else {
+        std::error_code error;
+        long long source[2] = { static_cast<long long>(std::filesystem::file_size(key, error)),
+                                static_cast<long long>(std::filesystem::last_write_time(key, error).time_since_epoch().count()) };
+        stamp = hashBytes(source, sizeof(source), stamp);
+    }
+
+    Decoded decoded;
+    decoded.request = request;
+    TextureImage* image = new TextureImage();
+    std::string file = config.cacheDirectory.empty() ? std::string() : cachePath(key);
+    if (!file.empty() && readTextureCache(file, stamp, *image)) {
+        decoded.image = image;
+        decoded.cached = true;
+    } else {
+        int width = 0, height = 0, fileChannels = 0;
+        unsigned char* pixels = encoded ? stbi_load_from_memory(encoded->data(), static_cast<int>(encoded->size()), &width, &height, &fileChannels, 4)
+                                        : stbi_load(key.c_str(), &width, &height, &fileChannels, 4);
+        if (pixels) {
+            buildTextureImage(pixels, width, height, chooseFormat(params, pixels, width, height), *image);
+            stbi_image_free(pixels);
+            decoded.image = image;
+            if (!file.empty()) {
+                std::error_code error;
+                std::filesystem::create_directories(config.cacheDirectory, error);
+                if (!writeTextureCache(file, stamp, *image)) std::cerr << "Could not write texture cache " << file << std::endl;
+
+                // The image stays around for streaming; keep it as a mapping rather than in memory
+                TextureImage* mapped = new TextureImage();
+                if (readTextureCache(file, stamp, *mapped)) {
+                    delete image;
+                    image = mapped;
+                    decoded.image = image;
+                } else {
+                    delete mapped;
+                }
+            }
+        } else {
+            std::cerr << "Failed to load texture " << (encoded ? "from memory" : key) << ": " << stbi_failure_reason() << std::endl;
+            delete image;
+        }
+    }
+    decodedCount++;
+    publish(decoded);
+}
+
+void TextureLoader::publish(const Decoded& decoded) {
+    int shared = static_cast<int>(lanes.size()) - 1;
+    if (laneIndex < 0) laneIndex = nextLane++;
+    if (laneIndex < shared) {
+        while (!lanes[laneIndex]->queue.push(decoded)) std::this_thread::yield();
+        return;
+    }
+    std::lock_guard<std::mutex> lock(lanes[shared]->sharedPush);
+    while (!lanes[shared]->queue.push(decoded)) std::this_thread::yield();
+}
+
+// Every level comes from the image; the GPU never generates mipmaps. With streaming
+// only the tail goes up now and the finer levels follow as draws ask for them.
+void TextureLoader::upload(const Decoded& decoded) {
+    if (!decoded.image) {
+        frameStats.failed++;
+        return;
+    }
+    Request& entry = requests[decoded.request];
+    entry.image.reset(decoded.image);
+    const std::vector<TextureImage::Level>& levels = entry.image->levels;
+    int levelCount = static_cast<int>(levels.size());
+
+    entry.tailLevel = 0;
+    if (config.streaming) {
+        while (entry.tailLevel < levelCount - 1 &&
+               std::max(levels[entry.tailLevel].width, levels[entry.tailLevel].height) > config.tailSize) {
+            entry.tailLevel++;
+        }
+    }
+    entry.baseLevel = levelCount;
+    entry.wantedLevel = entry.targetLevel = entry.tailLevel;
+    entry.residentBytes = 0;
+    glState().bindTexture(0, GL_TEXTURE_2D, entry.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    for (int level = levelCount - 1; level >= entry.tailLevel; --level) uploadLevel(entry, level);
+
+    frameStats.uploaded++;
+    if (decoded.cached) frameStats.cacheHits++;
+}
+
+// Upload the level just finer than the resident ones and let sampling use it
+void TextureLoader::uploadLevel(Request& entry, int level) {
+    const TextureImage::Level& data = entry.image->levels[level];
+    GLsizei size = static_cast<GLsizei>(data.size);
+    glState().bindTexture(0, GL_TEXTURE_2D, entry.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    switch (entry.image->format) {
+    case TextureFormat::RGB8:
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGB8, data.width, data.height, 0, GL_RGB, GL_UNSIGNED_BYTE, data.data);
+        break;
+    case TextureFormat::RGBA8:
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, data.width, data.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.data);
+        break;
+    case TextureFormat::BC1:
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, data.width, data.height, 0, size, data.data);
+        break;
+    case TextureFormat::BC3:
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, data.width, data.height, 0, size, data.data);
+        break;
+    case TextureFormat::BC5:
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, GL_COMPRESSED_RG_RGTC2, data.width, data.height, 0, size, data.data);
+        break;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+
+    entry.baseLevel = level;
+    entry.residentBytes += data.size;
+    frameStats.residentBytes += data.size;
+}
+
+// Clamp sampling past the finest level, then redefine it empty so the driver can free it
+void TextureLoader::evictLevel(Request& entry) {
+    int level = entry.baseLevel;
+    glState().bindTexture(0, GL_TEXTURE_2D, entry.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+    glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    size_t size = entry.image->levels[level].size;
+    entry.baseLevel = level + 1;
+    entry.residentBytes -= size;
+    frameStats.residentBytes -= size;
+    frameStats.evictedLastFrame++;
+}
+
+// Evict until bytes more fit in the budget. Victims are the textures holding the most
+// levels beyond what they were last asked for, the longest unused first; a texture
+// never loses its tail or the levels it still needs. False when that is not enough.
+bool TextureLoader::makeRoom(size_t bytes, const Request* keep) {
+    while (frameStats.residentBytes + bytes > config.residentBudget) {
+        Request* victim = nullptr;
+        int victimSurplus = 0;
+        for (Request& entry : requests) {
+            if (&entry == keep || !entry.image) continue;
+            int surplus = entry.targetLevel - entry.baseLevel;
+            if (surplus <= 0) continue;
+            if (!victim || surplus > victimSurplus || (surplus == victimSurplus && entry.lastWanted < victim->lastWanted)) {
+                victim = &entry;
+                victimSurplus = surplus;
+            }
+        }
+        if (!victim) return false;
+        evictLevel(*victim);
+    }
+    return true;
+}
+
+void TextureLoader::stream() {
+    // Last frame's requests become the targets; this frame starts asking again
+    for (Request& entry : requests) {
+        if (!entry.image) continue;
+        entry.targetLevel = entry.wantedLevel;
+        entry.wantedLevel = entry.tailLevel;
+    }
+    makeRoom(0, nullptr);
+
+    // One level at a time to the texture furthest from its target
+    for (int streamed = 0; streamed < config.streamLevelsPerFrame; ++streamed) {
+        Request* neediest = nullptr;
+        int neediestMissing = 0;
+        for (Request& entry : requests) {
+            if (!entry.image) continue;
+            int missing = entry.baseLevel - entry.targetLevel;
+            if (missing > neediestMissing) {
+                neediest = &entry;
+                neediestMissing = missing;
+            }
+        }
+        if (!neediest) break;
+        int level = neediest->baseLevel - 1;
+        if (!makeRoom(neediest->image->levels[level].size, neediest)) break;
+        uploadLevel(*neediest, level);
+        frameStats.streamedLastFrame++;
+    }
+}
+
+void TextureLoader::requestDetail(GLuint texture, float screenPixels) {
+    for (Request& entry : requests) {
+        if (entry.texture != texture) continue;
+        if (!entry.image) return;
+        // Level whose size matches the footprint: one texel per pixel or a little more
+        const TextureImage::Level& top = entry.image->levels[0];
+        float ratio = std::max(top.width, top.height) / std::max(screenPixels, 1.0f);
+        int level = ratio > 1.0f ? static_cast<int>(std::floor(std::log2(ratio))) : 0;
+        level = std::min(level, entry.tailLevel);
+        entry.wantedLevel = std::min(entry.wantedLevel, level);
+        entry.lastWanted = frameIndex;
+        return;
+    }
+}
+
+void TextureLoader::residency(std::vector<Residency>& out) const {
+    out.clear();
+    for (const Request& entry : requests) {
+        Residency info;
+        info.key = entry.key;
+        if (entry.image) {
+            info.width = entry.image->levels[0].width;
+            info.height = entry.image->levels[0].height;
+            info.levelCount = static_cast<int>(entry.image->levels.size());
+            info.baseLevel = entry.baseLevel;
+            info.wantedLevel = entry.targetLevel;
+            info.residentBytes = entry.residentBytes;
+            info.fullBytes = entry.image->byteSize();
+        }
+        out.push_back(info);
+    }
+}
+
+int TextureLoader::update() {
+    frameIndex++;
+    frameStats.decoded = decodedCount.load();
+    frameStats.uploadedLastFrame = 0;
+    frameStats.streamedLastFrame = 0;
+    frameStats.evictedLastFrame = 0;
+    frameStats.uploadMs = 0.0;
+
+    CPU_SCOPE("Texture upload");
+    auto start = std::chrono::steady_clock::now();
+    int count = 0;
+    bool progress = !idle();
+    // Round robin over the lanes so no thread's images wait behind another's
+    while (progress && (count == 0 || frameStats.uploadMs < config.uploadBudgetMs)) {
+        progress = false;
+        for (std::unique_ptr<Lane>& lane : lanes) {
+            Decoded decoded;
+            if (!lane->queue.pop(decoded)) continue;
+            upload(decoded);
+            count++;
+            progress = true;
+            frameStats.uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (frameStats.uploadMs >= config.uploadBudgetMs) break;
+        }
+    }
+    if (config.streaming) stream();
+    frameStats.uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    frameStats.uploadedLastFrame = count;
+    return count;
+}
+
+void TextureLoader::finish() {
+    jobSystem().wait(decodeJobs);
+    double budget = config.uploadBudgetMs;
+    config.uploadBudgetMs = 1e9;
+    update();
+    config.uploadBudgetMs = budget;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include "core/SpscQueue.h"
+#include "render/TextureCache.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Asynchronous texture loading.
+// load() hands out the final texture name straight away, holding a 1x1 placeholder,
+// and decodes the image on the job system, so every image in a scene decodes in
+// parallel. Decoded images travel back through single-producer/single-consumer
+// rings, one per decoding thread, and the GL thread uploads them in update()
+// within a per-frame time budget. The upload replaces the placeholder in place,
+// so users never have to look the texture up again.
+//
+// Workers do not hand over raw pixels but finished textures: the whole mip chain,
+// block compressed when enabled (BC1 for colour, BC3 with alpha, BC5 for normal
+// maps). That work is saved in a cache file per texture, so later runs only map
+// the file and upload its levels; nothing is decoded and no mipmaps are generated.
+//
+// Residency: a texture starts with only its coarse tail of mips. Draws report how
+// large the texture appears on screen (requestDetail), and update() streams in the
+// finer levels that footprint calls for, a few levels per frame, straight from the
+// mapped cache file. Under the GPU memory budget the finest levels of textures that
+// need them least are evicted again. GL_TEXTURE_BASE_LEVEL clamps sampling to the
+// levels actually resident.
+//
+// Requests are keyed by path (or any caller key for images in memory); repeated
+// requests share one texture. The loader owns every texture it created.
+class TextureLoader {
+public:
+    struct Config {
+        double uploadBudgetMs = 2.0;                   // update() stops after this, having uploaded at least one image
+        std::string cacheDirectory = "texture_cache";  // Empty disables the cache files
+        bool compress = true;                          // Block compress when the formats are supported
+        bool streaming = true;                         // Off uploads every level with the image
+        int tailSize = 64;                             // Levels up to this size upload with the image
+        int streamLevelsPerFrame = 2;                  // Finer levels uploaded per update()
+        size_t residentBudget = size_t(64) << 20;      // GPU bytes for all textures before finer levels are evicted
+    };
+
+    struct Params {
+        int channels = 3;                              // 3 keeps RGB, 4 keeps RGBA
+        bool normalMap = false;                        // Only x and y matter; compressed as BC5
+        glm::u8vec4 placeholder = glm::u8vec4(128, 128, 128, 255);
+    };
+
+    struct Stats {
+        int requested = 0;     // Distinct textures asked for
+        int decoded = 0;       // Images finished by the workers
+        int uploaded = 0;      // Textures holding their real image
+        int failed = 0;        // Images that could not be decoded; keep the placeholder
+        int cacheHits = 0;     // Images mapped from the cache instead of decoded
+        size_t residentBytes = 0;  // Texture memory of the levels currently on the GPU
+        int streamedLastFrame = 0; // Finer levels uploaded by the last update()
+        int evictedLastFrame = 0;  // Levels dropped by the last update()
+        int uploadedLastFrame = 0;
+        double uploadMs = 0.0; // Time spent in the last update()
+    };
+
+    // One texture's residency, for reports
+    struct Residency {
+        std::string key;
+        int width = 0;             // Of level 0
+        int height = 0;
+        int levelCount = 0;
+        int baseLevel = 0;         // Finest resident level
+        int wantedLevel = 0;       // Finest level the last frame's draws asked for
+        size_t residentBytes = 0;
+        size_t fullBytes = 0;      // With every level resident
+    };
+
+    // GL thread
+    void initialize(const Config& config);
+    void cleanup();
+
+    // GL thread: texture for an image file, decoded on a worker
+    GLuint load(const std::string& path, const Params& params);
+    GLuint load(const std::string& path) { return load(path, Params()); }
+
+    // GL thread: texture for an encoded image already in memory (e.g. PNG bytes from a glTF file)
+    GLuint loadEncoded(const std::string& key, const unsigned char* bytes, size_t size, const Params& params);
+
+    // GL thread: upload decoded images until the budget is spent, then stream finer
+    // levels in and evict under the memory budget; returns how many images were uploaded
+    int update();
+
+    // GL thread: a draw this frame shows texture about screenPixels across (one
+    // repeat of it); the finest level kept is the one matching the largest report
+    void requestDetail(GLuint texture, float screenPixels);
+
+    // Residency of every texture, in request order
+    void residency(std::vector<Residency>& out) const;
+
+    // GL thread: upload everything requested so far, running jobs while waiting
+    void finish();
+
+    // Every requested texture is uploaded or failed
+    bool idle() const { return frameStats.uploaded + frameStats.failed == frameStats.requested; }
+    const Stats& stats() const { return frameStats; }
+
+private:
+    static const uint32_t LANE_CAPACITY = 64;
+
+    struct Decoded {
+        int request = -1;
+        TextureImage* image = nullptr;     // Null when decoding failed
+        bool cached = false;
+    };
+
+    // Ring fed by one thread; threads beyond the reserved lanes share the last one under a lock
+    struct Lane {
+        SpscQueue<Decoded, LANE_CAPACITY> queue;
+        std::mutex sharedPush;
+    };
+
+    struct Request {
+        std::string key;
+        GLuint texture = 0;
+        Params params;
+        std::unique_ptr<TextureImage> image;  // Kept after upload so finer levels can stream in
+        int baseLevel = 0;                    // Finest resident level
+        int tailLevel = 0;                    // Coarsest level streaming may evict down to
+        int wantedLevel = 0;                  // Finest level asked for this frame
+        int targetLevel = 0;                  // Finest level asked for last frame
+        int lastWanted = 0;                   // Frame the texture was last drawn
+        size_t residentBytes = 0;
+    };
+
+    std::vector<Request> requests;
+    std::vector<std::unique_ptr<Lane>> lanes;
+    std::atomic<int> nextLane{ 0 };
+    std::atomic<int> decodedCount{ 0 };
+    Config config;
+    bool s3tc = false;                     // GL_EXT_texture_compression_s3tc
+    Stats frameStats;
+    int frameIndex = 0;
+
+    GLuint request(const std::string& key, const Params& params, bool& created);
+    void decode(int request, const std::string& key, const std::vector<unsigned char>* encoded, const Params& params);
+    TextureFormat chooseFormat(const Params& params, const unsigned char* rgba, int width, int height) const;
+    std::string cachePath(const std::string& key) const;
+    void publish(const Decoded& image);
+    void upload(const Decoded& image);
+    void uploadLevel(Request& entry, int level);
+    void evictLevel(Request& entry);
+    bool makeRoom(size_t bytes, const Request* keep);
+    void stream();
+};
+
+TextureLoader& textureLoader();
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "render/GLState.h"
+
+// One attribute of an interleaved vertex struct
+struct VertexAttribute {
+    GLuint location;       // Shader attribute location
+    GLint components;      // Number of components (1-4)
+    GLenum type;           // GL component type
+    GLboolean normalized;  // Normalize fixed-point data
+    bool integer;          // Use glVertexAttribIPointer instead of glVertexAttribPointer
+    std::size_t offset;    // Byte offset inside the vertex
+};
+
+// Two half floats; GL has no scalar type for them
+struct Half2 {
+    uint16_t x, y;
+};
+
+// Maps a C++ member type to its GL component count and type
+template <typename T> struct VertexAttributeTraits;
+
+template <> struct VertexAttributeTraits<float> {
+    static constexpr GLint components = 1;
+    static constexpr GLenum type = GL_FLOAT;
+    static constexpr bool integer = false;
+};
+template <> struct VertexAttributeTraits<glm::vec2> {
+    static constexpr GLint components = 2;
+    static constexpr GLenum type = GL_FLOAT;
+    static constexpr bool integer = false;
+};
+template <> struct VertexAttributeTraits<glm::vec3> {
+    static constexpr GLint components = 3;
+    static constexpr GLenum type = GL_FLOAT;
+    static constexpr bool integer = false;
+};
+template <> struct VertexAttributeTraits<glm::vec4> {
+    static constexpr GLint components = 4;
+    static constexpr GLenum type = GL_FLOAT;
+    static constexpr bool integer = false;
+};
+template <> struct VertexAttributeTraits<glm::uvec4> {
+    static constexpr GLint components = 4;
+    static constexpr GLenum type = GL_UNSIGNED_INT;
+    static constexpr bool integer = true;
+};
+template <> struct VertexAttributeTraits<glm::u8vec4> {
+    static constexpr GLint components = 4;
+    static constexpr GLenum type = GL_UNSIGNED_BYTE;
+    static constexpr bool integer = true;
+};
+template <> struct VertexAttributeTraits<glm::i16vec2> {
+    static constexpr GLint components = 2;
+    static constexpr GLenum type = GL_SHORT;
+    static constexpr bool integer = true;
+};
+template <> struct VertexAttributeTraits<glm::u16vec4> {
+    static constexpr GLint components = 4;
+    static constexpr GLenum type = GL_UNSIGNED_SHORT;
+    static constexpr bool integer = true;
+};
+template <> struct VertexAttributeTraits<Half2> {
+    static constexpr GLint components = 2;
+    static constexpr GLenum type = GL_HALF_FLOAT;
+    static constexpr bool integer = false;
+};
+
+// Integer members read as integers unless normalized, when they read as fixed point
+template <typename Member>
+constexpr VertexAttribute makeVertexAttribute(GLuint location, std::size_t offset, bool normalized = false) {
+    return VertexAttribute{
+        location,
+        VertexAttributeTraits<Member>::components,
+        VertexAttributeTraits<Member>::type,
+        static_cast<GLboolean>(normalized ? GL_TRUE : GL_FALSE),
+        VertexAttributeTraits<Member>::integer && !normalized,
+        offset
+    };
+}
+
+// Describe a vertex member; component count, type and offset are all derived at compile time
+#define VERTEX_ATTRIBUTE(VertexType, member, location) \
+    makeVertexAttribute<decltype(VertexType::member)>(location, offsetof(VertexType, member))
+// An integer member the shader reads as a float in [0, 1], or [-1, 1] when signed
+#define VERTEX_ATTRIBUTE_NORMALIZED(VertexType, member, location) \
+    makeVertexAttribute<decltype(VertexType::member)>(location, offsetof(VertexType, member), true)
+
+// Specialize for each vertex struct with a static constexpr `attributes` array
+template <typename V> struct VertexLayout;
+
+// Enable and point every attribute of V at the currently bound GL_ARRAY_BUFFER
+template <typename V>
+void applyVertexLayout() {
+    for (const VertexAttribute& attribute : VertexLayout<V>::attributes) {
+        glEnableVertexAttribArray(attribute.location);
+        if (attribute.integer) {
+            glVertexAttribIPointer(attribute.location, attribute.components, attribute.type,
+                                   sizeof(V), reinterpret_cast<const void*>(attribute.offset));
+        } else {
+            glVertexAttribPointer(attribute.location, attribute.components, attribute.type,
+                                  attribute.normalized, sizeof(V), reinterpret_cast<const void*>(attribute.offset));
+        }
+    }
+}
+
+// Interleaved vertex buffer + index buffer with a VAO configured once at init.
+// Drawing only needs bind() followed by the draw call.
+template <typename V>
+struct InterleavedMesh {
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ebo = 0;
+    GLsizei vertexCount = 0;
+    GLsizei indexCount = 0;
+
+    void initialize(const V* vertices, std::size_t numVertices,
+                    const GLuint* indices, std::size_t numIndices,
+                    GLenum usage = GL_STATIC_DRAW) {
+        vertexCount = static_cast<GLsizei>(numVertices);
+        indexCount = static_cast<GLsizei>(numIndices);
+
+        glGenVertexArrays(1, &vao);
+        glState().bindVertexArray(vao);
+
+        glGenBuffers(1, &vbo);
+        glState().bindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(V), vertices, usage);
+        applyVertexLayout<V>();
+
+        // The element buffer binding is VAO state, so it is captured here as well
+        glGenBuffers(1, &ebo);
+        glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(GLuint), indices, GL_STATIC_DRAW);
+
+        // Leave no VAO bound so later buffer uploads cannot alter this one
+        glState().bindVertexArray(0);
+    }
+
+    // Overwrite a range of vertices (e.g. when terrain is regenerated)
+    void updateVertices(const V* vertices, std::size_t count, std::size_t first = 0) {
+        glState().bindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(V), count * sizeof(V), vertices);
+    }
+
+    void bind() const {
+        glState().bindVertexArray(vao);
+    }
+
+    void cleanup() {
+        glState().forgetVertexArray(vao);
+        glState().forgetBuffer(vbo);
+        glState().forgetBuffer(ebo);
+        if (vao) glDeleteVertexArrays(1, &vao);
+        if (vbo) glDeleteBuffers(1, &vbo);
+        if (ebo) glDeleteBuffers(1, &ebo);
+        vao = vbo = ebo = 0;
+        vertexCount = indexCount = 0;
+    }
+};
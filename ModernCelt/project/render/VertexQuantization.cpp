@@ -0,0 +1,75 @@
+#include "VertexQuantization.h"
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+uint16_t unorm16(float value) {
+    return static_cast<uint16_t>(std::lround(glm::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+int16_t snorm16(float value) {
+    return static_cast<int16_t>(std::lround(glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+float signNotZero(float value) {
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+} // namespace
+
+glm::u16vec4 quantizePosition(const glm::vec3& position, const glm::vec3& origin, const glm::vec3& extent) {
+    glm::u16vec4 result(0);
+    for (int axis = 0; axis < 3; ++axis) {
+        // A flat box has one position along that axis
+        result[axis] = extent[axis] > 0.0f ? unorm16((position[axis] - origin[axis]) / extent[axis]) : 0;
+    }
+    return result;
+}
+
+glm::vec3 dequantizePosition(const glm::u16vec4& quantized, const glm::vec3& origin, const glm::vec3& extent) {
+    return origin + extent * glm::vec3(quantized.x, quantized.y, quantized.z) / 65535.0f;
+}
+
+glm::i16vec2 encodeOctahedral(const glm::vec3& normal) {
+    float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (length == 0.0f) return glm::i16vec2(0, 0);
+    glm::vec3 n = normal / length;
+    glm::vec2 folded(n.x, n.y);
+    // The lower hemisphere folds over the diagonals onto the corners
+    if (n.z < 0.0f) {
+        folded = glm::vec2((1.0f - std::abs(n.y)) * signNotZero(n.x), (1.0f - std::abs(n.x)) * signNotZero(n.y));
+    }
+    return glm::i16vec2(snorm16(folded.x), snorm16(folded.y));
+}
+
+glm::vec3 decodeOctahedral(const glm::i16vec2& encoded) {
+    glm::vec2 folded = glm::max(glm::vec2(encoded) / 32767.0f, glm::vec2(-1.0f));
+    glm::vec3 n(folded, 1.0f - std::abs(folded.x) - std::abs(folded.y));
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+Half2 packHalf2(const glm::vec2& value) {
+    return Half2{ glm::packHalf1x16(value.x), glm::packHalf1x16(value.y) };
+}
+
+glm::u8vec4 quantizeWeights(const glm::vec4& weights) {
+    glm::vec4 clamped = glm::max(weights, glm::vec4(0.0f));
+    float sum = clamped.x + clamped.y + clamped.z + clamped.w;
+    if (sum <= 0.0f) return glm::u8vec4(255, 0, 0, 0);
+
+    int quantized[4];
+    int total = 0, largest = 0;
+    for (int i = 0; i < 4; ++i) {
+        quantized[i] = static_cast<int>(std::lround(clamped[i] / sum * 255.0f));
+        total += quantized[i];
+        if (clamped[i] > clamped[largest]) largest = i;
+    }
+    // Rounding error goes to the largest weight, where it matters least
+    quantized[largest] += 255 - total;
+    return glm::u8vec4(quantized[0], quantized[1], quantized[2], quantized[3]);
+}
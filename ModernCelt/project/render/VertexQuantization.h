@@ -0,0 +1,23 @@
+#pragma once
+
+#include "render/VertexFormat.h"
+
+// Fixed-point encodings for vertex attributes, each decoded by the GPU's normalized
+// attribute fetch plus at most a few shader instructions:
+//   positions  unorm16 within a box, scaled and offset back in the shader
+//   normals    octahedral, two snorm16
+//   UVs        half float
+//   weights    unorm8, rounded so every vertex's weights still sum to one
+
+// position as unorm16 within [origin, origin + extent]; w is zero
+glm::u16vec4 quantizePosition(const glm::vec3& position, const glm::vec3& origin, const glm::vec3& extent);
+glm::vec3 dequantizePosition(const glm::u16vec4& quantized, const glm::vec3& origin, const glm::vec3& extent);
+
+// Unit normal folded onto the octahedron and flattened to two snorm16
+glm::i16vec2 encodeOctahedral(const glm::vec3& normal);
+glm::vec3 decodeOctahedral(const glm::i16vec2& encoded);
+
+Half2 packHalf2(const glm::vec2& value);
+
+// Weights normalised to a sum of exactly 255; all zero becomes (255, 0, 0, 0)
+glm::u8vec4 quantizeWeights(const glm::vec4& weights);
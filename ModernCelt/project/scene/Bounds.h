@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cfloat>
+
+// Axis-aligned bounding box; default constructed boxes are empty
+struct AABB {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    AABB() = default;
+    AABB(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
+
+    bool isEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+    glm::vec3 center() const { return 0.5f * (min + max); }
+    glm::vec3 extents() const { return 0.5f * (max - min); }
+
+    void expand(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void expand(const AABB& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    bool overlaps(const AABB& other) const {
+        return min.x <= other.max.x && max.x >= other.min.x &&
+               min.y <= other.max.y && max.y >= other.min.y &&
+               min.z <= other.max.z && max.z >= other.min.z;
+    }
+
+    // Box enclosing this one after an affine transform
+    AABB transformed(const glm::mat4& matrix) const {
+        glm::vec3 newCenter = glm::vec3(matrix * glm::vec4(center(), 1.0f));
+        glm::vec3 e = extents();
+        glm::vec3 newExtents(
+            glm::abs(matrix[0][0]) * e.x + glm::abs(matrix[1][0]) * e.y + glm::abs(matrix[2][0]) * e.z,
+            glm::abs(matrix[0][1]) * e.x + glm::abs(matrix[1][1]) * e.y + glm::abs(matrix[2][1]) * e.z,
+            glm::abs(matrix[0][2]) * e.x + glm::abs(matrix[1][2]) * e.y + glm::abs(matrix[2][2]) * e.z);
+        return AABB(newCenter - newExtents, newCenter + newExtents);
+    }
+};
@@ -0,0 +1,202 @@
+#include "Bvh.h"
+#include <algorithm>
+
+namespace {
+
+AABB merged(const AABB& a, const AABB& b) {
+    AABB result = a;
+    result.expand(b);
+    return result;
+}
+
+float surfaceArea(const AABB& box) {
+    glm::vec3 size = box.max - box.min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+bool contains(const AABB& outer, const AABB& inner) {
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+           outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+}
+
+} // namespace
+
+int Bvh::insert(const AABB& bounds, uint32_t item) {
+    int leaf = allocateNode();
+    Node& node = nodes[leaf];
+    node.bounds = AABB(bounds.min - glm::vec3(margin), bounds.max + glm::vec3(margin));
+    node.item = item;
+    node.height = 0;
+    insertLeaf(leaf);
+    leaves++;
+    return leaf;
+}
+
+void Bvh::remove(int proxy) {
+    removeLeaf(proxy);
+    freeNode(proxy);
+    leaves--;
+}
+
+bool Bvh::move(int proxy, const AABB& bounds) {
+    if (contains(nodes[proxy].bounds, bounds)) return false;
+    removeLeaf(proxy);
+    nodes[proxy].bounds = AABB(bounds.min - glm::vec3(margin), bounds.max + glm::vec3(margin));
+    insertLeaf(proxy);
+    return true;
+}
+
+int Bvh::allocateNode() {
+    int index;
+    if (freeList != NULL_NODE) {
+        index = freeList;
+        freeList = nodes[index].parent;
+        freeCount--;
+        nodes[index] = Node();
+    } else {
+        index = static_cast<int>(nodes.size());
+        nodes.emplace_back();
+    }
+    return index;
+}
+
+void Bvh::freeNode(int node) {
+    nodes[node].parent = freeList;
+    nodes[node].height = -1;
+    freeList = node;
+    freeCount++;
+}
+
+void Bvh::insertLeaf(int leaf) {
+    if (root == NULL_NODE) {
+        root = leaf;
+        nodes[root].parent = NULL_NODE;
+        return;
+    }
+
+    // Walk down towards the cheapest sibling. Pairing with a node costs the area of
+    // the new parent; descending also enlarges every node passed on the way.
+    AABB leafBounds = nodes[leaf].bounds;
+    int index = root;
+    while (!nodes[index].isLeaf()) {
+        const Node& node = nodes[index];
+        float area = surfaceArea(node.bounds);
+        float combinedArea = surfaceArea(merged(node.bounds, leafBounds));
+        float siblingCost = 2.0f * combinedArea;
+        float inheritedCost = 2.0f * (combinedArea - area);
+
+        auto descendCost = [&](int child) {
+            const Node& c = nodes[child];
+            float grown = surfaceArea(merged(c.bounds, leafBounds));
+            return (c.isLeaf() ? grown : grown - surfaceArea(c.bounds)) + inheritedCost;
+        };
+        float leftCost = descendCost(node.left);
+        float rightCost = descendCost(node.right);
+
+        if (siblingCost < leftCost && siblingCost < rightCost) break;
+        index = leftCost < rightCost ? node.left : node.right;
+    }
+
+    int sibling = index;
+    int oldParent = nodes[sibling].parent;
+    int newParent = allocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].bounds = merged(leafBounds, nodes[sibling].bounds);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].left = sibling;
+    nodes[newParent].right = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent == NULL_NODE) {
+        root = newParent;
+    } else if (nodes[oldParent].left == sibling) {
+        nodes[oldParent].left = newParent;
+    } else {
+        nodes[oldParent].right = newParent;
+    }
+
+    refitUpwards(nodes[leaf].parent);
+}
+
+void Bvh::removeLeaf(int leaf) {
+    if (leaf == root) {
+        root = NULL_NODE;
+        return;
+    }
+
+    // The parent goes away and the sibling takes its place
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+    if (grandParent == NULL_NODE) {
+        root = sibling;
+        nodes[sibling].parent = NULL_NODE;
+        freeNode(parent);
+        return;
+    }
+
+    if (nodes[grandParent].left == parent) nodes[grandParent].left = sibling;
+    else nodes[grandParent].right = sibling;
+    nodes[sibling].parent = grandParent;
+    freeNode(parent);
+    refitUpwards(grandParent);
+}
+
+// Rebalance and refit every node from here up to the root
+void Bvh::refitUpwards(int index) {
+    while (index != NULL_NODE) {
+        index = balance(index);
+        Node& node = nodes[index];
+        const Node& left = nodes[node.left];
+        const Node& right = nodes[node.right];
+        node.height = 1 + std::max(left.height, right.height);
+        node.bounds = merged(left.bounds, right.bounds);
+        index = node.parent;
+    }
+}
+
+// If one child of a is more than one level taller than the other, rotate that
+// child up into a's place; returns the node now at a's position
+int Bvh::balance(int a) {
+    Node& nodeA = nodes[a];
+    if (nodeA.isLeaf() || nodeA.height < 2) return a;
+
+    int b = nodeA.left;
+    int c = nodeA.right;
+    int difference = nodes[c].height - nodes[b].height;
+    if (difference >= -1 && difference <= 1) return a;
+
+    // up is the taller child, which takes a's place; a keeps the shorter child
+    // and adopts the shorter of up's children, while up keeps the taller one
+    int up = difference > 1 ? c : b;
+    int kept = difference > 1 ? b : c;
+    Node& nodeUp = nodes[up];
+    int f = nodeUp.left;
+    int g = nodeUp.right;
+    int tall = nodes[f].height > nodes[g].height ? f : g;
+    int shortChild = tall == f ? g : f;
+
+    nodeUp.left = a;
+    nodeUp.parent = nodeA.parent;
+    nodeA.parent = up;
+    if (nodeUp.parent == NULL_NODE) {
+        root = up;
+    } else if (nodes[nodeUp.parent].left == a) {
+        nodes[nodeUp.parent].left = up;
+    } else {
+        nodes[nodeUp.parent].right = up;
+    }
+
+    nodeUp.right = tall;
+    nodeA.left = kept;
+    nodeA.right = shortChild;
+    nodes[shortChild].parent = a;
+
+    nodeA.bounds = merged(nodes[kept].bounds, nodes[shortChild].bounds);
+    nodeA.height = 1 + std::max(nodes[kept].height, nodes[shortChild].height);
+    nodeUp.bounds = merged(nodeA.bounds, nodes[tall].bounds);
+    nodeUp.height = 1 + std::max(nodeA.height, nodes[tall].height);
+    return up;
+}
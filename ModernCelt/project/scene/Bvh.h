@@ -0,0 +1,119 @@
+#pragma once
+
+#include "Bounds.h"
+#include "Frustum.h"
+#include <cstdint>
+#include <vector>
+
+// Dynamic bounding volume hierarchy over AABBs.
+// Leaves are inserted next to the sibling that grows the tree's surface area the
+// least, and every node on the way back to the root is rebalanced with AVL-style
+// rotations, so the tree stays shallow without ever being rebuilt. Leaves store a
+// box widened by margin; moving a leaf within that box costs nothing, and only a
+// leaf that leaves it is pulled out and reinserted, refitting its ancestors.
+class Bvh {
+public:
+    static constexpr int NULL_NODE = -1;
+
+    explicit Bvh(float margin = 0.0f) : margin(margin) {}
+
+    // Add a leaf and return its proxy; item is handed back by the queries
+    int insert(const AABB& bounds, uint32_t item);
+    void remove(int proxy);
+
+    // Update a leaf's box; returns true when the leaf had to be reinserted
+    bool move(int proxy, const AABB& bounds);
+
+    void setItem(int proxy, uint32_t item) { nodes[proxy].item = item; }
+    uint32_t item(int proxy) const { return nodes[proxy].item; }
+
+    // Call visit(item) for every leaf whose box is not outside the frustum.
+    // Subtrees fully inside are taken whole without testing their leaves. Pending
+    // nodes are classified four at a time, one plane per step across the batch.
+    template <typename Visit>
+    void cull(const Frustum& frustum, Visit visit) const;
+
+    int leafCount() const { return leaves; }
+    int nodeCount() const { return static_cast<int>(nodes.size()) - freeCount; }
+    int height() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+
+private:
+    struct Node {
+        AABB bounds;
+        int parent = NULL_NODE;     // Next free node while on the free list
+        int left = NULL_NODE;
+        int right = NULL_NODE;
+        int height = -1;            // 0 for leaves, -1 while free
+        uint32_t item = 0;
+
+        bool isLeaf() const { return left == NULL_NODE; }
+    };
+
+    // Depth-first traversal needs at most one pending node per level
+    static constexpr int STACK_SIZE = 128;
+    // Culling pops four nodes and pushes up to eight, leaving at most four per level
+    static constexpr int CULL_STACK_SIZE = 4 * STACK_SIZE;
+
+    std::vector<Node> nodes;
+    int root = NULL_NODE;
+    int freeList = NULL_NODE;
+    int freeCount = 0;
+    int leaves = 0;
+    float margin;
+
+    int allocateNode();
+    void freeNode(int node);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    void refitUpwards(int node);
+    int balance(int node);
+
+    template <typename Visit>
+    void visitSubtree(int node, Visit& visit) const;
+};
+
+template <typename Visit>
+void Bvh::cull(const Frustum& frustum, Visit visit) const {
+    if (root == NULL_NODE) return;
+    int stack[CULL_STACK_SIZE];
+    int top = 0;
+    stack[top++] = root;
+    while (top > 0) {
+        int batch[4];
+        const AABB* boxes[4];
+        int count = top < 4 ? top : 4;
+        for (int k = 0; k < 4; ++k) {
+            batch[k] = k < count ? stack[--top] : batch[0];
+            boxes[k] = &nodes[batch[k]].bounds;
+        }
+        Frustum::Result results[4];
+        frustum.classify(boxes, results);
+
+        for (int k = 0; k < count; ++k) {
+            const Node& node = nodes[batch[k]];
+            if (results[k] == Frustum::Result::Outside) continue;
+            if (results[k] == Frustum::Result::Inside || node.isLeaf()) {
+                visitSubtree(batch[k], visit);
+                continue;
+            }
+            stack[top++] = node.left;
+            stack[top++] = node.right;
+        }
+    }
+}
+
+template <typename Visit>
+void Bvh::visitSubtree(int subtree, Visit& visit) const {
+    int stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = subtree;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (node.isLeaf()) {
+            visit(node.item);
+            continue;
+        }
+        stack[top++] = node.left;
+        stack[top++] = node.right;
+    }
+}
@@ -0,0 +1,198 @@
+#include "EntityStore.h"
+#include "core/JobSystem.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+
+namespace {
+
+// Below this many dirty entities the job system costs more than it saves
+const int PARALLEL_UPDATE_THRESHOLD = 1024;
+
+} // namespace
+
+Entity EntityStore::create(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    Entity entity;
+    if (!freeSlots.empty()) {
+        entity.index = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        entity.index = static_cast<uint32_t>(generations.size());
+        generations.push_back(0);
+        slotToDense.push_back(Entity::INVALID_INDEX);
+        queued.push_back(0);
+    }
+    entity.generation = generations[entity.index];
+
+    uint32_t denseIndex = static_cast<uint32_t>(entities.size());
+    slotToDense[entity.index] = denseIndex;
+    entities.push_back(entity);
+    positions.push_back(position);
+    rotations.push_back(rotation);
+    scales.push_back(scale);
+    localBounds.push_back(AABB());
+    worldMatrices.push_back(glm::mat4(1.0f));
+    worldBounds.push_back(AABB());
+    renderables.push_back(Renderable());
+    animators.push_back(Animator());
+    proxies.push_back(Bvh::NULL_NODE);
+    proxyStatic.push_back(0);
+    markDirty(denseIndex);
+    return entity;
+}
+
+void EntityStore::destroy(Entity entity) {
+    if (!isAlive(entity)) return;
+    uint32_t hole = dense(entity);
+    uint32_t last = static_cast<uint32_t>(entities.size()) - 1;
+    if (renderables[hole].isStatic && renderables[hole].kind != RenderKind::None) staticRevisionCount++;
+    removeProxy(hole);
+
+    // Move the last entity into the hole to keep the arrays packed
+    if (hole != last) {
+        entities[hole] = entities[last];
+        positions[hole] = positions[last];
+        rotations[hole] = rotations[last];
+        scales[hole] = scales[last];
+        localBounds[hole] = localBounds[last];
+        worldMatrices[hole] = worldMatrices[last];
+        worldBounds[hole] = worldBounds[last];
+        renderables[hole] = renderables[last];
+        animators[hole] = animators[last];
+        proxies[hole] = proxies[last];
+        proxyStatic[hole] = proxyStatic[last];
+        if (proxies[hole] != Bvh::NULL_NODE) {
+            (proxyStatic[hole] ? staticBvh : dynamicBvh).setItem(proxies[hole], hole);
+        }
+        slotToDense[entities[hole].index] = hole;
+    }
+    entities.pop_back();
+    positions.pop_back();
+    rotations.pop_back();
+    scales.pop_back();
+    localBounds.pop_back();
+    worldMatrices.pop_back();
+    worldBounds.pop_back();
+    renderables.pop_back();
+    animators.pop_back();
+    proxies.pop_back();
+    proxyStatic.pop_back();
+
+    // A queued update for this slot is skipped, since the slot no longer maps anywhere.
+    // The slot stays queued, so reusing it before the next update queues it only once.
+    slotToDense[entity.index] = Entity::INVALID_INDEX;
+    generations[entity.index]++;
+    freeSlots.push_back(entity.index);
+}
+
+bool EntityStore::isAlive(Entity entity) const {
+    return entity.index < generations.size() && generations[entity.index] == entity.generation &&
+           slotToDense[entity.index] != Entity::INVALID_INDEX;
+}
+
+void EntityStore::markDirty(uint32_t denseIndex) {
+    uint32_t slot = entities[denseIndex].index;
+    if (queued[slot]) return;
+    queued[slot] = 1;
+    dirtySlots.push_back(slot);
+}
+
+void EntityStore::setPosition(Entity entity, const glm::vec3& position) {
+    positions[dense(entity)] = position;
+    markDirty(dense(entity));
+}
+
+void EntityStore::setRotation(Entity entity, const glm::quat& rotation) {
+    rotations[dense(entity)] = rotation;
+    markDirty(dense(entity));
+}
+
+void EntityStore::setScale(Entity entity, const glm::vec3& scale) {
+    scales[dense(entity)] = scale;
+    markDirty(dense(entity));
+}
+
+void EntityStore::setLocalBounds(Entity entity, const AABB& bounds) {
+    localBounds[dense(entity)] = bounds;
+    markDirty(dense(entity));
+}
+
+void EntityStore::setRenderable(Entity entity, const Renderable& renderable) {
+    renderables[dense(entity)] = renderable;
+    if (renderable.isStatic) staticRevisionCount++;
+    markDirty(dense(entity));   // May move between the trees
+}
+
+void EntityStore::setAnimator(Entity entity, const Animator& animator) {
+    animators[dense(entity)] = animator;
+}
+
+int EntityStore::updateTransforms() {
+    if (dirtySlots.empty()) return 0;
+
+    dirtyDense.clear();
+    for (uint32_t slot : dirtySlots) {
+        queued[slot] = 0;
+        uint32_t denseIndex = slotToDense[slot];
+        if (denseIndex == Entity::INVALID_INDEX) continue;
+        dirtyDense.push_back(denseIndex);
+        if (renderables[denseIndex].isStatic && renderables[denseIndex].kind != RenderKind::None) {
+            staticRevisionCount++;
+        }
+    }
+    dirtySlots.clear();
+
+    auto update = [this](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            uint32_t e = dirtyDense[i];
+            glm::mat4 world = glm::translate(glm::mat4(1.0f), positions[e]) * glm::mat4_cast(rotations[e]);
+            worldMatrices[e] = glm::scale(world, scales[e]);
+            worldBounds[e] = localBounds[e].isEmpty() ? AABB() : localBounds[e].transformed(worldMatrices[e]);
+        }
+    };
+    int count = static_cast<int>(dirtyDense.size());
+    if (count >= PARALLEL_UPDATE_THRESHOLD) jobSystem().parallelFor(0, count, 256, update);
+    else update(0, count);
+
+    // The trees are not thread safe; refit them once the boxes are in
+    for (uint32_t e : dirtyDense) updateProxy(e);
+    return count;
+}
+
+void EntityStore::removeProxy(uint32_t denseIndex) {
+    if (proxies[denseIndex] == Bvh::NULL_NODE) return;
+    (proxyStatic[denseIndex] ? staticBvh : dynamicBvh).remove(proxies[denseIndex]);
+    proxies[denseIndex] = Bvh::NULL_NODE;
+}
+
+void EntityStore::updateProxy(uint32_t denseIndex) {
+    const Renderable& renderable = renderables[denseIndex];
+    const AABB& bounds = worldBounds[denseIndex];
+    bool wanted = renderable.kind != RenderKind::None && !bounds.isEmpty();
+    uint8_t isStatic = renderable.isStatic ? 1 : 0;
+
+    if (proxies[denseIndex] != Bvh::NULL_NODE && (!wanted || proxyStatic[denseIndex] != isStatic)) {
+        removeProxy(denseIndex);
+    }
+    if (!wanted) return;
+
+    Bvh& tree = isStatic ? staticBvh : dynamicBvh;
+    if (proxies[denseIndex] == Bvh::NULL_NODE) {
+        proxies[denseIndex] = tree.insert(bounds, denseIndex);
+        proxyStatic[denseIndex] = isStatic;
+    } else {
+        tree.move(proxies[denseIndex], bounds);
+    }
+}
+
+int EntityStore::cull(const Frustum& frustum, int sets, std::vector<int>& visible) const {
+    size_t first = visible.size();
+    auto add = [&visible](uint32_t denseIndex) { visible.push_back(static_cast<int>(denseIndex)); };
+    if (sets & CULL_STATIC) staticBvh.cull(frustum, add);
+    if (sets & CULL_DYNAMIC) dynamicBvh.cull(frustum, add);
+    std::sort(visible.begin() + first, visible.end());
+    return static_cast<int>(visible.size() - first);
+}
+
+int EntityStore::cullableCount(int sets) const {
+    return ((sets & CULL_STATIC) ? staticBvh.leafCount() : 0) + ((sets & CULL_DYNAMIC) ? dynamicBvh.leafCount() : 0);
+}
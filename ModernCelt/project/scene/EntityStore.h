@@ -0,0 +1,139 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "Bounds.h"
+#include "Bvh.h"
+#include "Frustum.h"
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+// Handle to an entity. The generation changes whenever a slot is reused, so a
+// handle to a destroyed entity stays invalid even after its slot is recycled.
+struct Entity {
+    static constexpr uint32_t INVALID_INDEX = 0xffffffffu;
+
+    uint32_t index = INVALID_INDEX;
+    uint32_t generation = 0;
+
+    bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+// What draws an entity; resource indexes the owner's list for that kind
+enum class RenderKind : uint8_t {
+    None,
+    Terrain,
+    Building,
+    Pub,
+    Character,
+};
+
+struct Renderable {
+    RenderKind kind = RenderKind::None;
+    uint32_t resource = 0;
+    bool castsShadow = true;
+    bool isStatic = true;     // Static casters live in the cached shadow layers
+    bool occluder = false;    // Solid box [-1, 1]^3 under the world matrix, usable for occlusion culling
+};
+
+struct Animator {
+    int character = -1;       // Slot in FrameSnapshot::characters, -1 when not animated
+};
+
+// Entities with their components in structure-of-arrays form.
+// Live entities are packed at the front of every component array (removal moves
+// the last entity into the hole), so passes walk contiguous arrays and index i
+// addresses the same entity in all of them. A slot table maps handles to those
+// dense indices.
+//
+// Changing a transform or local bounds only queues the entity; updateTransforms()
+// then rebuilds world matrices and bounds for the queued entities in one batch.
+//
+// Renderables with bounds also live in a BVH, static and moving ones in separate
+// trees so the shadow cache can query them apart. The trees are refit as part of
+// updateTransforms(), touching only the queued entities.
+class EntityStore {
+public:
+    // Which trees cull() searches
+    enum CullSet { CULL_STATIC = 1, CULL_DYNAMIC = 2, CULL_ALL = 3 };
+
+    Entity create(const glm::vec3& position = glm::vec3(0.0f),
+                  const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                  const glm::vec3& scale = glm::vec3(1.0f));
+    void destroy(Entity entity);
+    bool isAlive(Entity entity) const;
+
+    void setPosition(Entity entity, const glm::vec3& position);
+    void setRotation(Entity entity, const glm::quat& rotation);
+    void setScale(Entity entity, const glm::vec3& scale);
+    void setLocalBounds(Entity entity, const AABB& bounds);
+    void setRenderable(Entity entity, const Renderable& renderable);
+    void setAnimator(Entity entity, const Animator& animator);
+
+    const glm::vec3& position(Entity entity) const { return positions[dense(entity)]; }
+    const glm::mat4& worldMatrix(Entity entity) const { return worldMatrices[dense(entity)]; }
+    const AABB& bounds(Entity entity) const { return worldBounds[dense(entity)]; }
+
+    // Rebuild world matrices and bounds of every queued entity; returns how many.
+    // Large batches are split across the job system.
+    int updateTransforms();
+
+    // Append the dense indices of renderables touching the frustum to visible, in
+    // ascending order (so draws keep registration order). Returns how many were added.
+    int cull(const Frustum& frustum, int sets, std::vector<int>& visible) const;
+
+    // Renderables that cull() considers for these sets
+    int cullableCount(int sets) const;
+
+    const Bvh& staticTree() const { return staticBvh; }
+    const Bvh& dynamicTree() const { return dynamicBvh; }
+
+    // Bumped whenever a static renderable moves, appears or disappears
+    uint64_t staticRevision() const { return staticRevisionCount; }
+
+    // Dense iteration over live entities, 0 <= i < count()
+    int count() const { return static_cast<int>(entities.size()); }
+    Entity entityAt(int i) const { return entities[i]; }
+    const Renderable& renderableAt(int i) const { return renderables[i]; }
+    const Animator& animatorAt(int i) const { return animators[i]; }
+    const glm::mat4& worldMatrixAt(int i) const { return worldMatrices[i]; }
+    const AABB& boundsAt(int i) const { return worldBounds[i]; }
+
+private:
+    // Slot table, indexed by Entity::index
+    std::vector<uint32_t> generations;
+    std::vector<uint32_t> slotToDense;
+    std::vector<uint32_t> freeSlots;
+    std::vector<uint8_t> queued;         // Slot already in dirtySlots; survives destroy and reuse
+
+    // Components, indexed densely
+    std::vector<Entity> entities;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<AABB> localBounds;
+    std::vector<glm::mat4> worldMatrices;
+    std::vector<AABB> worldBounds;
+    std::vector<Renderable> renderables;
+    std::vector<Animator> animators;
+    std::vector<int> proxies;            // Leaf in staticBvh or dynamicBvh, or Bvh::NULL_NODE
+    std::vector<uint8_t> proxyStatic;    // Which of the two trees holds the leaf
+
+    std::vector<uint32_t> dirtySlots;    // Slots, which stay put when entities are packed
+    std::vector<uint32_t> dirtyDense;    // Scratch for updateTransforms()
+    uint64_t staticRevisionCount = 0;
+
+    Bvh staticBvh{ 0.0f };
+    Bvh dynamicBvh{ 0.5f };              // Moving boxes get slack so small moves skip reinsertion
+
+    // A stale handle would address whichever entity now fills the row
+    uint32_t dense(Entity entity) const {
+        assert(isAlive(entity));
+        return slotToDense[entity.index];
+    }
+    void markDirty(uint32_t denseIndex);
+    void removeProxy(uint32_t denseIndex);
+    void updateProxy(uint32_t denseIndex);
+};
@@ -0,0 +1,90 @@
+#include "Frustum.h"
+
+Frustum::Frustum() {
+    for (int i = 0; i < MAX_PLANES; ++i) {
+        x[i] = y[i] = z[i] = 0.0f;
+        w[i] = 1.0f;
+    }
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4& m, bool nearPlane) {
+    // Gribb-Hartmann: each plane is the last row of the matrix plus or minus another row
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum frustum;
+    frustum.addPlane(row3 + row0);   // Left
+    frustum.addPlane(row3 - row0);   // Right
+    frustum.addPlane(row3 + row1);   // Bottom
+    frustum.addPlane(row3 - row1);   // Top
+    frustum.addPlane(row3 - row2);   // Far
+    if (nearPlane) frustum.addPlane(row3 + row2);
+    return frustum;
+}
+
+void Frustum::addPlane(const glm::vec4& plane) {
+    x[planeCount] = plane.x;
+    y[planeCount] = plane.y;
+    z[planeCount] = plane.z;
+    w[planeCount] = plane.w;
+    planeCount++;
+}
+
+// A box is outside once it lies fully behind any plane, and inside when it lies
+// fully in front of all of them. Per plane, the box's signed distance is measured
+// at its centre and the extents give the largest reach towards the plane.
+Frustum::Result Frustum::classify(const AABB& box) const {
+    glm::vec3 c = box.center();
+    glm::vec3 e = box.extents();
+    bool crossing = false;
+    for (int i = 0; i < planeCount; ++i) {
+        float distance = x[i] * c.x + y[i] * c.y + z[i] * c.z + w[i];
+        float reach = glm::abs(x[i]) * e.x + glm::abs(y[i]) * e.y + glm::abs(z[i]) * e.z;
+        if (distance + reach < 0.0f) return Result::Outside;
+        if (distance - reach < 0.0f) crossing = true;
+    }
+    return crossing ? Result::Intersects : Result::Inside;
+}
+
+void Frustum::classify(const AABB* const boxes[4], Result results[4]) const {
+#ifdef MODERNCELT_SSE
+    // Rows of min.xyz, max.x and of max.yz, transposed into one register per
+    // coordinate; the 8-byte load of max.yz stays inside the box
+    __m128 row0 = _mm_loadu_ps(&boxes[0]->min.x), row1 = _mm_loadu_ps(&boxes[1]->min.x);
+    __m128 row2 = _mm_loadu_ps(&boxes[2]->min.x), row3 = _mm_loadu_ps(&boxes[3]->min.x);
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+    __m128 tail01 = _mm_unpacklo_ps(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(&boxes[0]->max.y))),
+                                    _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(&boxes[1]->max.y))));
+    __m128 tail23 = _mm_unpacklo_ps(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(&boxes[2]->max.y))),
+                                    _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(&boxes[3]->max.y))));
+    __m128 maxY = _mm_movelh_ps(tail01, tail23), maxZ = _mm_movehl_ps(tail23, tail01);
+
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 cx = _mm_mul_ps(_mm_add_ps(row0, row3), half), ex = _mm_mul_ps(_mm_sub_ps(row3, row0), half);
+    __m128 cy = _mm_mul_ps(_mm_add_ps(row1, maxY), half), ey = _mm_mul_ps(_mm_sub_ps(maxY, row1), half);
+    __m128 cz = _mm_mul_ps(_mm_add_ps(row2, maxZ), half), ez = _mm_mul_ps(_mm_sub_ps(maxZ, row2), half);
+    __m128 zero = _mm_setzero_ps();
+
+    __m128 outside = zero, crossing = zero;
+    for (int i = 0; i < planeCount; ++i) {
+        __m128 px = _mm_set1_ps(x[i]), py = _mm_set1_ps(y[i]), pz = _mm_set1_ps(z[i]);
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)),
+                                     _mm_add_ps(_mm_mul_ps(pz, cz), _mm_set1_ps(w[i])));
+        __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(glm::abs(x[i])), ex),
+                                             _mm_mul_ps(_mm_set1_ps(glm::abs(y[i])), ey)),
+                                  _mm_mul_ps(_mm_set1_ps(glm::abs(z[i])), ez));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, reach), zero));
+        crossing = _mm_or_ps(crossing, _mm_cmplt_ps(_mm_sub_ps(distance, reach), zero));
+        if (_mm_movemask_ps(outside) == 0xF) break;
+    }
+    int outsideBits = _mm_movemask_ps(outside), crossingBits = _mm_movemask_ps(crossing);
+    for (int k = 0; k < 4; ++k) {
+        results[k] = (outsideBits >> k) & 1 ? Result::Outside
+                   : (crossingBits >> k) & 1 ? Result::Intersects : Result::Inside;
+    }
+#else
+    for (int k = 0; k < 4; ++k) results[k] = classify(*boxes[k]);
+#endif
+}
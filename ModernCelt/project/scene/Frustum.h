@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "Bounds.h"
+#include "core/Simd.h"
+
+// Convex volume bounded by the clip planes of a view-projection matrix.
+// A single box is tested plane by plane. Batches of four boxes are transposed into
+// SSE registers so one instruction tests all four against the same plane; a box
+// only has five or six planes to test, too few to fill the lanes on its own.
+class Frustum {
+public:
+    enum class Result { Outside, Intersects, Inside };
+
+    Frustum();
+
+    // Planes of an OpenGL clip volume. Skipping the near plane suits depth-clamped
+    // shadow passes, where casters in front of the light box still cast.
+    static Frustum fromMatrix(const glm::mat4& viewProjection, bool nearPlane = true);
+
+    Result classify(const AABB& box) const;
+    bool visible(const AABB& box) const { return classify(box) != Result::Outside; }
+
+    // Classifies four boxes at once; repeat a pointer to fill a short batch
+    void classify(const AABB* const boxes[4], Result results[4]) const;
+
+private:
+    static constexpr int MAX_PLANES = 8;
+
+    // Plane i is (x[i], y[i], z[i]) . p + w[i] >= 0 for points inside
+    float x[MAX_PLANES];
+    float y[MAX_PLANES];
+    float z[MAX_PLANES];
+    float w[MAX_PLANES];
+    int planeCount = 0;
+
+    void addPlane(const glm::vec4& plane);
+};
@@ -0,0 +1,31 @@
+#include "Heightfield.h"
+
+float Heightfield::height(int x, int z) const {
+    const double scale = 0.03;
+    const int octaves = 4;
+    const double persistence = 0.5;
+
+    double amplitude = 18.0;
+    double frequency = scale;
+    double height = 0.0;
+    double maxValue = 0.0;
+
+    for (int i = 0; i < octaves; i++) {
+        height += perlin.noise2D(x * frequency, z * frequency) * amplitude;
+        maxValue += amplitude;
+        amplitude *= persistence;
+        frequency *= 2.0;
+    }
+    return height * 12.0 / maxValue; // Scale height to match visual requirements
+}
+
+glm::vec3 Heightfield::normal(int x, int z) const {
+    glm::vec3 p0(x - 1, height(x - 1, z), z);
+    glm::vec3 p1(x + 1, height(x + 1, z), z);
+    glm::vec3 p2(x, height(x, z - 1), z - 1);
+    glm::vec3 p3(x, height(x, z + 1), z + 1);
+
+    glm::vec3 v1 = p1 - p0;
+    glm::vec3 v2 = p3 - p2;
+    return glm::normalize(glm::cross(v2, v1));
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include "../project/include/PerlinNoise.hpp"
+
+// Fractal Perlin height field the terrain is built from.
+// Sampling only reads the permutation table, so any thread may call it.
+class Heightfield {
+public:
+    explicit Heightfield(uint32_t seed = 1234) : perlin(seed) {}
+
+    float height(int x, int z) const;
+    glm::vec3 normal(int x, int z) const;
+
+private:
+    siv::PerlinNoise perlin;
+};
+
+// Fill rows [rowBegin, rowEnd) of a width x depth vertex grid centred on the
+// origin. Rows are independent, so ranges can be filled in parallel.
+template <typename VertexType>
+void fillGridRows(const Heightfield& field, int width, int depth, int rowBegin, int rowEnd, VertexType* vertices) {
+    for (int z = rowBegin; z < rowEnd; z++) {
+        for (int x = 0; x < width; x++) {
+            VertexType& vertex = vertices[z * width + x];
+            vertex.position = glm::vec3((float)x - width / 2.0f, field.height(x, z), (float)z - depth / 2.0f);
+            vertex.normal = field.normal(x, z);
+            vertex.texCoord = glm::vec2(x / (float)width * 20.0f, z / (float)depth * 20.0f);
+        }
+    }
+}
@@ -0,0 +1,266 @@
+#include "OcclusionCuller.h"
+#include "core/CpuProfiler.h"
+#include "core/JobSystem.h"
+#include "core/Simd.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// Corners of [-1, 1]^3 indexed by bits: x = bit 0, y = bit 1, z = bit 2
+glm::vec4 cubeCorner(int index) {
+    return glm::vec4((index & 1) ? 1.0f : -1.0f, (index & 2) ? 1.0f : -1.0f, (index & 4) ? 1.0f : -1.0f, 1.0f);
+}
+
+// Two triangles per cube face; winding does not matter, it is fixed up after projection
+const int cubeFaces[6][4] = {
+    { 0, 2, 6, 4 }, { 1, 5, 7, 3 },   // -x, +x
+    { 0, 4, 5, 1 }, { 2, 3, 7, 6 },   // -y, +y
+    { 0, 1, 3, 2 }, { 4, 6, 7, 5 },   // -z, +z
+};
+
+} // namespace
+
+void OcclusionCuller::initialize(const Config& config) {
+    this->config = config;
+    // Rows are processed four pixels at a time
+    this->config.width = std::max(4, (config.width + 3) & ~3);
+    this->config.height = std::max(1, config.height);
+
+    levels.clear();
+    levelSizes.clear();
+    int width = this->config.width;
+    int height = this->config.height;
+    for (;;) {
+        levels.emplace_back(static_cast<size_t>(width) * height, 1.0f);
+        levelSizes.emplace_back(width, height);
+        if (width == 1 && height == 1) break;
+        width = std::max(1, (width + 1) / 2);
+        height = std::max(1, (height + 1) / 2);
+    }
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4& viewProjection) {
+    this->viewProjection = viewProjection;
+    candidates.clear();
+    occluderIds.clear();
+    triangles.clear();
+    frameStats = Stats();
+}
+
+void OcclusionCuller::addOccluder(const glm::mat4& worldMatrix, const AABB& bounds, int id) {
+    // Screen size goes with the square of radius over distance
+    glm::vec4 center = viewProjection * glm::vec4(bounds.center(), 1.0f);
+    float radius = glm::length(bounds.extents());
+    float distance = std::max(center.w, 0.1f);
+    candidates.push_back(Candidate{ worldMatrix, radius * radius / (distance * distance), id });
+}
+
+bool OcclusionCuller::isOccluder(int id) const {
+    return std::find(occluderIds.begin(), occluderIds.end(), id) != occluderIds.end();
+}
+
+void OcclusionCuller::rasterize() {
+    CPU_SCOPE("Occlusion raster");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    int kept = std::min(static_cast<int>(candidates.size()), config.maxOccluders);
+    std::partial_sort(candidates.begin(), candidates.begin() + kept, candidates.end(),
+                      [](const Candidate& a, const Candidate& b) { return a.weight > b.weight; });
+    for (int i = 0; i < kept; ++i) {
+        occluderIds.push_back(candidates[i].id);
+        setupOccluder(candidates[i].worldMatrix);
+    }
+    frameStats.occluders = kept;
+
+    // Bands own disjoint rows, so workers never write the same pixel
+    int bands = (config.height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    jobSystem().parallelFor(0, bands, 1, [this](int begin, int end) {
+        for (int band = begin; band < end; ++band) {
+            rasterizeBand(band * BAND_HEIGHT, std::min(config.height, (band + 1) * BAND_HEIGHT));
+        }
+    });
+    buildPyramid();
+
+    frameStats.rasterMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void OcclusionCuller::setupOccluder(const glm::mat4& worldMatrix) {
+    glm::mat4 toClip = viewProjection * worldMatrix;
+    glm::vec4 corners[8];
+    for (int i = 0; i < 8; ++i) corners[i] = toClip * cubeCorner(i);
+    for (const int* face : cubeFaces) {
+        clipAndAddTriangle(corners[face[0]], corners[face[1]], corners[face[2]]);
+        clipAndAddTriangle(corners[face[0]], corners[face[2]], corners[face[3]]);
+    }
+}
+
+// Clip against the near plane (z >= -w), project, and queue the pieces with
+// counter-clockwise winding
+void OcclusionCuller::clipAndAddTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+    const glm::vec4 input[3] = { a, b, c };
+    glm::vec4 clipped[4];
+    int count = 0;
+    for (int i = 0; i < 3; ++i) {
+        const glm::vec4& current = input[i];
+        const glm::vec4& next = input[(i + 1) % 3];
+        float currentDistance = current.z + current.w;
+        float nextDistance = next.z + next.w;
+        if (currentDistance >= 0.0f) clipped[count++] = current;
+        if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f)) {
+            float t = currentDistance / (currentDistance - nextDistance);
+            clipped[count++] = current + (next - current) * t;
+        }
+    }
+    if (count < 3) return;
+
+    glm::vec3 screen[4];
+    for (int i = 0; i < count; ++i) {
+        glm::vec3 ndc = glm::vec3(clipped[i]) / clipped[i].w;
+        screen[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * config.width, (ndc.y * 0.5f + 0.5f) * config.height, ndc.z * 0.5f + 0.5f);
+    }
+    for (int i = 1; i + 1 < count; ++i) {
+        Triangle triangle = { { screen[0], screen[i], screen[i + 1] } };
+        float area = (triangle.v[1].x - triangle.v[0].x) * (triangle.v[2].y - triangle.v[0].y) -
+                     (triangle.v[1].y - triangle.v[0].y) * (triangle.v[2].x - triangle.v[0].x);
+        if (std::abs(area) < 1e-6f) continue;
+        if (area < 0.0f) std::swap(triangle.v[1], triangle.v[2]);
+        triangles.push_back(triangle);
+    }
+}
+
+void OcclusionCuller::rasterizeBand(int rowBegin, int rowEnd) {
+    std::vector<float>& depth = levels[0];
+    int width = config.width;
+    std::fill(depth.begin() + static_cast<size_t>(rowBegin) * width, depth.begin() + static_cast<size_t>(rowEnd) * width, 1.0f);
+
+    for (const Triangle& triangle : triangles) {
+        const glm::vec3& v0 = triangle.v[0];
+        const glm::vec3& v1 = triangle.v[1];
+        const glm::vec3& v2 = triangle.v[2];
+
+        // Pixel centres covered by the bounding box, clamped to this band
+        int minX = std::max(0, static_cast<int>(std::floor(std::min(v0.x, std::min(v1.x, v2.x)))));
+        int maxX = std::min(width - 1, static_cast<int>(std::ceil(std::max(v0.x, std::max(v1.x, v2.x)))));
+        int minY = std::max(rowBegin, static_cast<int>(std::floor(std::min(v0.y, std::min(v1.y, v2.y)))));
+        int maxY = std::min(rowEnd - 1, static_cast<int>(std::ceil(std::max(v0.y, std::max(v1.y, v2.y)))));
+        if (minX > maxX || minY > maxY) continue;
+        minX &= ~3;
+
+        // Edge i runs from v[i] to v[i + 1]; inside is where all three are non-negative
+        float edgeA[3], edgeB[3], edgeC[3];
+        for (int i = 0; i < 3; ++i) {
+            const glm::vec3& from = triangle.v[i];
+            const glm::vec3& to = triangle.v[(i + 1) % 3];
+            edgeA[i] = from.y - to.y;
+            edgeB[i] = to.x - from.x;
+            edgeC[i] = -(edgeA[i] * from.x + edgeB[i] * from.y);
+        }
+
+        // Depth is affine in screen space after the perspective divide
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        float depthDx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+        float depthDy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+        float depthC = v0.z - depthDx * v0.x - depthDy * v0.y;
+
+        for (int y = minY; y <= maxY; ++y) {
+            float* row = depth.data() + static_cast<size_t>(y) * width;
+            float py = y + 0.5f;
+#ifdef MODERNCELT_SSE
+            __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            __m128 zero = _mm_setzero_ps();
+            __m128 rowEdge[3], stepEdge[3];
+            for (int i = 0; i < 3; ++i) {
+                rowEdge[i] = _mm_set1_ps(edgeB[i] * py + edgeC[i]);
+                stepEdge[i] = _mm_set1_ps(edgeA[i]);
+            }
+            __m128 rowDepth = _mm_set1_ps(depthDy * py + depthC);
+            __m128 stepDepth = _mm_set1_ps(depthDx);
+            for (int x = minX; x <= maxX; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+                __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepEdge[0], px), rowEdge[0]), zero);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepEdge[1], px), rowEdge[1]), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepEdge[2], px), rowEdge[2]), zero));
+                if (!_mm_movemask_ps(inside)) continue;
+
+                __m128 z = _mm_add_ps(_mm_mul_ps(stepDepth, px), rowDepth);
+                __m128 stored = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_min_ps(stored, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, stored)));
+            }
+#else
+            for (int x = minX; x <= maxX; ++x) {
+                float px = x + 0.5f;
+                bool inside = true;
+                for (int i = 0; i < 3; ++i) inside = inside && edgeA[i] * px + edgeB[i] * py + edgeC[i] >= 0.0f;
+                if (!inside) continue;
+                row[x] = std::min(row[x], depthDx * px + depthDy * py + depthC);
+            }
+#endif
+        }
+    }
+}
+
+// Each texel keeps the farthest depth below it, so a box nearer than a texel is
+// nearer than every occluder pixel under that texel
+void OcclusionCuller::buildPyramid() {
+    for (size_t level = 1; level < levels.size(); ++level) {
+        const std::vector<float>& source = levels[level - 1];
+        std::vector<float>& target = levels[level];
+        glm::ivec2 sourceSize = levelSizes[level - 1];
+        glm::ivec2 size = levelSizes[level];
+        for (int y = 0; y < size.y; ++y) {
+            int y0 = std::min(2 * y, sourceSize.y - 1);
+            int y1 = std::min(2 * y + 1, sourceSize.y - 1);
+            for (int x = 0; x < size.x; ++x) {
+                int x0 = std::min(2 * x, sourceSize.x - 1);
+                int x1 = std::min(2 * x + 1, sourceSize.x - 1);
+                target[y * size.x + x] = std::max(std::max(source[y0 * sourceSize.x + x0], source[y0 * sourceSize.x + x1]),
+                                                  std::max(source[y1 * sourceSize.x + x0], source[y1 * sourceSize.x + x1]));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::isOccluded(const AABB& bounds) {
+    frameStats.tested++;
+    if (occluderIds.empty() || bounds.isEmpty()) return false;
+
+    // Screen rectangle and nearest depth of the box; boxes reaching past the near
+    // plane are too close to judge
+    glm::vec2 minScreen(FLT_MAX), maxScreen(-FLT_MAX);
+    float nearest = FLT_MAX;
+    for (int i = 0; i < 8; ++i) {
+        glm::vec3 corner((i & 1) ? bounds.max.x : bounds.min.x, (i & 2) ? bounds.max.y : bounds.min.y,
+                         (i & 4) ? bounds.max.z : bounds.min.z);
+        glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+        if (clip.z < -clip.w) return false;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        minScreen = glm::min(minScreen, glm::vec2(ndc));
+        maxScreen = glm::max(maxScreen, glm::vec2(ndc));
+        nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+    }
+
+    int x0 = std::max(0, static_cast<int>(std::floor((minScreen.x * 0.5f + 0.5f) * config.width)));
+    int x1 = std::min(config.width - 1, static_cast<int>(std::floor((maxScreen.x * 0.5f + 0.5f) * config.width)));
+    int y0 = std::max(0, static_cast<int>(std::floor((minScreen.y * 0.5f + 0.5f) * config.height)));
+    int y1 = std::min(config.height - 1, static_cast<int>(std::floor((maxScreen.y * 0.5f + 0.5f) * config.height)));
+    if (x0 > x1 || y0 > y1) return false;
+
+    // Finest level where the rectangle spans at most 4x4 texels
+    int level = 0;
+    while (level + 1 < static_cast<int>(levels.size()) &&
+           (((x1 >> level) - (x0 >> level)) >= 4 || ((y1 >> level) - (y0 >> level)) >= 4)) {
+        level++;
+    }
+
+    const std::vector<float>& depth = levels[level];
+    int levelWidth = levelSizes[level].x;
+    for (int y = y0 >> level; y <= (y1 >> level); ++y) {
+        for (int x = x0 >> level; x <= (x1 >> level); ++x) {
+            if (depth[y * levelWidth + x] >= nearest) return false;
+        }
+    }
+    frameStats.occluded++;
+    return true;
+}
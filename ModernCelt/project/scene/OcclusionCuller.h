@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "Bounds.h"
+#include <cstdint>
+#include <vector>
+
+// CPU occlusion culling against a few large box occluders.
+// Each frame the occluders that look biggest from the camera are rasterized into
+// a small depth buffer, four pixels per SSE instruction, in horizontal bands on
+// the job system. A max-depth pyramid (hierarchical Z) is built on top, and an
+// object is hidden when the nearest point of its bounds lies behind the farthest
+// occluder depth over the screen rectangle those bounds cover.
+class OcclusionCuller {
+public:
+    struct Config {
+        int width = 256;
+        int height = 128;
+        int maxOccluders = 8;
+    };
+
+    struct Stats {
+        int occluders = 0;        // Boxes rasterized this frame
+        int tested = 0;
+        int occluded = 0;
+        double rasterMs = 0.0;
+    };
+
+    void initialize(const Config& config);
+
+    // Start a frame seen through viewProjection; forgets last frame's occluders
+    void beginFrame(const glm::mat4& viewProjection);
+
+    // Offer the box [-1, 1]^3 under worldMatrix as an occluder; bounds are its world
+    // bounds. Only the maxOccluders largest on screen are kept. id is the caller's.
+    void addOccluder(const glm::mat4& worldMatrix, const AABB& bounds, int id);
+
+    // Rasterize the chosen occluders and build the pyramid
+    void rasterize();
+
+    // Whether id was one of the rasterized occluders; never test those against themselves
+    bool isOccluder(int id) const;
+
+    // Whether world bounds are hidden behind the occluders; counts the test in stats()
+    bool isOccluded(const AABB& bounds);
+
+    const Stats& stats() const { return frameStats; }
+
+private:
+    struct Candidate {
+        glm::mat4 worldMatrix;
+        float weight;             // Projected size estimate
+        int id;
+    };
+
+    struct Triangle {
+        glm::vec3 v[3];           // Screen x, y in pixels, depth in [0, 1]
+    };
+
+    static constexpr int BAND_HEIGHT = 16;   // Rows per rasterization job
+
+    Config config;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    std::vector<Candidate> candidates;
+    std::vector<int> occluderIds;
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<float>> levels;  // levels[0] is the depth buffer, then max-depth mips
+    std::vector<glm::ivec2> levelSizes;
+    Stats frameStats;
+
+    void setupOccluder(const glm::mat4& worldMatrix);
+    void clipAndAddTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+    void rasterizeBand(int rowBegin, int rowEnd);
+    void buildPyramid();
+};
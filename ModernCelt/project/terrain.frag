@@ -6,9 +6,40 @@ in vec3 worldPosition;
 uniform sampler2D terrainTexture;
 uniform vec3 lightIntensity;
 uniform vec3 lightPosition;
+uniform sampler2DArrayShadow shadowMap;
+
+layout(std140) uniform ShadowCascades {
+    mat4 lightSpaceMatrices[4];
+    vec4 cascadeSplits;      // View depth where each cascade ends
+    vec4 cascadeTexelSizes;  // World size of one shadow texel
+    mat4 cameraView;
+    ivec4 cascadeCount;
+};
 
 out vec4 FragColor;
 
+// Fraction of light reaching the point, 3x3 PCF in the cascade covering it
+float shadowFactor(vec3 position, vec3 normal) {
+    float viewDepth = -(cameraView * vec4(position, 1.0)).z;
+    int cascade = 0;
+    while (cascade < cascadeCount.x && viewDepth > cascadeSplits[cascade]) cascade++;
+    if (cascade >= cascadeCount.x) return 1.0;
+
+    // Offset along the normal by a texel or so to avoid shadow acne
+    vec3 biased = position + normal * (1.5 * cascadeTexelSizes[cascade]);
+    vec3 coords = (lightSpaceMatrices[cascade] * vec4(biased, 1.0)).xyz * 0.5 + 0.5;
+    float reference = min(coords.z - 0.0005, 1.0);
+    vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+
+    float lit = 0.0;
+    for (int x = -1; x <= 1; x++) {
+        for (int y = -1; y <= 1; y++) {
+            lit += texture(shadowMap, vec4(coords.xy + vec2(x, y) * texel, float(cascade), reference));
+        }
+    }
+    return lit / 9.0;
+}
+
 void main() {
     vec3 baseColor = texture(terrainTexture, TexCoord).rgb;
     vec3 N = normalize(worldNormal);
@@ -17,7 +48,7 @@ void main() {
 
     float attenuation = 1.0 / (1.0 + 0.01 * distance + 0.001 * distance * distance);
     float lambertian = max(dot(N, L), 0.0);
-    vec3 diffuse = lambertian * baseColor * lightIntensity * attenuation;
+    vec3 diffuse = lambertian * baseColor * lightIntensity * attenuation * shadowFactor(worldPosition, N);
     vec3 ambient = 0.2 * baseColor;
 
     vec3 combined = ambient + diffuse;